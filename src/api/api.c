@@ -1,5 +1,6 @@
 #include <curl/curl.h>
 #include "api/api.h"
+#include "api/internal.h"
 
 extern int api_init() {
     CURLcode res = curl_global_init(CURL_GLOBAL_ALL);
@@ -7,5 +8,6 @@ extern int api_init() {
 }
 
 extern void api_cleanup() {
+    api_share_cleanup();
     curl_global_cleanup();
 }
@@ -1,6 +1,8 @@
 #ifndef API_API_H_
 #define API_API_H_
 
+#include <stdint.h>
+
 /**
  * @brief Initialize the API module
  *
@@ -13,6 +15,24 @@ extern int api_init();
  */
 extern void api_cleanup();
 
+/**
+ * @brief Get how many API responses were served from the on-disk cache, either
+ * within their TTL or after a 304, and how many had to be downloaded.
+ *
+ * @param hits Output for the number of cache hits (can be NULL)
+ * @param misses Output for the number of cache misses (can be NULL)
+ */
+extern void api_cache_stats(int* hits, int* misses);
+
+/**
+ * @brief Get how many bytes every API transfer so far sent and received,
+ * headers included and bodies as they were on the wire before decoding.
+ *
+ * @param received Output for the number of bytes received (can be NULL)
+ * @param sent Output for the number of bytes sent (can be NULL)
+ */
+extern void api_wire_stats(uint64_t* received, uint64_t* sent);
+
 /**
  * @brief Sends a heartbeat signal to the endpoint specified in the config at
  * network.api_url, or defaults to "https://gittor.rent/api/" if not set.
@@ -0,0 +1,90 @@
+#include <glib.h>
+#include <stdalign.h>
+#include <stddef.h>
+#include <string.h>
+#include "api/internal.h"
+
+// Blocks double in size as the arena grows, starting from at least this
+#define ARENA_MIN_BLOCK 4096
+
+#define ARENA_ALIGN alignof(max_align_t)
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+} arena_block_t;
+
+struct api_arena {
+    arena_block_t* blocks;  // Newest first, the oldest is part of the arena
+};
+
+#define ARENA_HEADER ARENA_ROUND(sizeof(api_arena_t))
+#define BLOCK_HEADER ARENA_ROUND(sizeof(arena_block_t))
+
+static unsigned char* block_data(arena_block_t* block) {
+    return (unsigned char*)block + BLOCK_HEADER;
+}
+
+extern api_arena_t* api_arena_new(size_t size) {
+    size = MAX(ARENA_ROUND(size), ARENA_MIN_BLOCK);
+
+    // The arena and its first block are a single allocation, so an arena
+    // sized right costs one malloc however many objects it holds
+    api_arena_t* arena = g_malloc(ARENA_HEADER + BLOCK_HEADER + size);
+    arena_block_t* block = (arena_block_t*)((unsigned char*)arena +
+                                            ARENA_HEADER);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    arena->blocks = block;
+    return arena;
+}
+
+static void* take(api_arena_t* arena, size_t size, size_t align) {
+    arena_block_t* block = arena->blocks;
+    size_t offset = (block->used + align - 1) & ~(align - 1);
+    if (offset + size > block->size) {
+        size_t grown = MAX(ARENA_ROUND(size), block->size * 2);
+        arena_block_t* next = g_malloc(BLOCK_HEADER + grown);
+        next->next = block;
+        next->size = grown;
+        next->used = 0;
+        arena->blocks = block = next;
+        offset = 0;
+    }
+
+    block->used = offset + size;
+    return block_data(block) + offset;
+}
+
+extern void* api_arena_alloc(api_arena_t* arena, size_t size) {
+    void* ptr = take(arena, size, ARENA_ALIGN);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+extern char* api_arena_strdup(api_arena_t* arena, const char* str) {
+    if (!str)
+        return NULL;
+
+    // Strings need no alignment, so they pack tightly
+    size_t len = strlen(str) + 1;
+    char* copy = take(arena, len, 1);
+    memcpy(copy, str, len);  // NOLINT - safe since sized from str
+    return copy;
+}
+
+extern void api_arena_free(api_arena_t* arena) {
+    if (!arena)
+        return;
+
+    arena_block_t* block = arena->blocks;
+    while (block->next) {
+        arena_block_t* next = block->next;
+        g_free(block);
+        block = next;
+    }
+    g_free(arena);
+}
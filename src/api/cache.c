@@ -0,0 +1,359 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "api/api.h"
+#include "api/internal.h"
+#include "config/config.h"
+
+// Attempts at a download in a single request, each continuing the last
+#define DOWNLOAD_ATTEMPTS 3
+
+// Bytes of responses kept when network.cache_size isn't set
+#define DEFAULT_CACHE_SIZE (64 * 1024 * 1024)
+
+static gint hits = 0;
+static gint misses = 0;
+static GMutex evict_lock;
+
+/**
+ * @brief Validators of a response, sent back to revalidate it later
+ */
+typedef struct {
+    char* etag;
+    char* last_modified;
+} validators_t;
+
+static void validators_clear(validators_t* validators) {
+    g_free(validators->etag);
+    g_free(validators->last_modified);
+    validators->etag = NULL;
+    validators->last_modified = NULL;
+}
+
+static size_t header_cb(char* buffer, size_t size, size_t nitems, void* data) {
+    size_t total = size * nitems;
+    validators_t* validators = data;
+    gchar* line = g_strndup(buffer, total);
+    g_strstrip(line);
+
+    // Only keep the headers of the last response after redirects
+    if (g_str_has_prefix(line, "HTTP/")) {
+        validators_clear(validators);
+    } else if (g_ascii_strncasecmp(line, "ETag:", 5) == 0) {
+        g_free(validators->etag);
+        validators->etag = g_strstrip(g_strdup(line + 5));
+    } else if (g_ascii_strncasecmp(line, "Last-Modified:", 14) == 0) {
+        g_free(validators->last_modified);
+        validators->last_modified = g_strstrip(g_strdup(line + 14));
+    }
+
+    g_free(line);
+    return total;
+}
+
+// Responses are stored under the config dir, named after their URL
+static gchar* cache_path(const char* url, const char* suffix) {
+    gchar* key = g_compute_checksum_for_string(G_CHECKSUM_SHA1, url, -1);
+    gchar* name = g_strconcat(key, suffix, NULL);
+    gchar* path = g_build_filename(g_get_user_config_dir(), "gittor",
+                                   "cache", name, NULL);
+    g_free(name);
+    g_free(key);
+    return path;
+}
+
+static gint64 cache_ttl() {
+    return config_get_int(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "cache_ttl"}, 0);
+}
+
+static gint64 cache_size() {
+    return config_get_int(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "cache_size"},
+        DEFAULT_CACHE_SIZE);
+}
+
+/**
+ * @brief A cached response, by when it was last used
+ */
+typedef struct {
+    gchar* body_path;
+    gint64 size;
+    gint64 used_ns;
+} cache_entry_t;
+
+static void cache_entry_free(gpointer data) {
+    cache_entry_t* entry = data;
+    g_free(entry->body_path);
+    g_free(entry);
+}
+
+static gint compare_used(gconstpointer a, gconstpointer b) {
+    const cache_entry_t* x = *(cache_entry_t* const*)a;
+    const cache_entry_t* y = *(cache_entry_t* const*)b;
+    return (x->used_ns > y->used_ns) - (x->used_ns < y->used_ns);
+}
+
+// Remove the least recently used responses until the rest fit the cache
+// size, always keeping the newest. A body's modification time is when it was
+// last stored or served.
+static void evict(const char* dir) {
+    GDir* entries = g_dir_open(dir, 0, NULL);
+    if (!entries) {
+        return;
+    }
+
+    GPtrArray* bodies = g_ptr_array_new_with_free_func(cache_entry_free);
+    gint64 total = 0;
+    const char* name = NULL;
+    while ((name = g_dir_read_name(entries))) {
+        // Bodies are named after the hash of their URL alone, metadata and
+        // files still being written have a suffix
+        GStatBuf st;
+        gchar* path = g_build_filename(dir, name, NULL);
+        if (strchr(name, '.') || g_stat(path, &st) ||
+            !S_ISREG(st.st_mode)) {
+            g_free(path);
+            continue;
+        }
+        cache_entry_t* entry = g_new(cache_entry_t, 1);
+        entry->body_path = path;
+        entry->size = (gint64)st.st_size;
+        entry->used_ns =
+            (gint64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        g_ptr_array_add(bodies, entry);
+        total += entry->size;
+    }
+    g_dir_close(entries);
+
+    // The metadata goes first, so it never points at a missing body
+    gint64 limit = cache_size();
+    g_ptr_array_sort(bodies, compare_used);
+    for (guint i = 0; i + 1 < bodies->len && total > limit; i++) {
+        cache_entry_t* entry = g_ptr_array_index(bodies, i);
+        gchar* meta_path = g_strconcat(entry->body_path, ".meta", NULL);
+        g_remove(meta_path);
+        g_remove(entry->body_path);
+        total -= entry->size;
+        g_free(meta_path);
+    }
+    g_ptr_array_free(bodies, TRUE);
+}
+
+// Copy the cached body into the response buffer or the output file
+static int serve(const char* body_path,
+                 response_buf_t* response,
+                 const char* output_path) {
+    if (output_path) {
+        // Like a download, the file only appears under its name when whole
+        gchar* part_path = g_strconcat(output_path, ".part", NULL);
+        GFile* from = g_file_new_for_path(body_path);
+        GFile* to = g_file_new_for_path(part_path);
+        gboolean copied = g_file_copy(from, to, G_FILE_COPY_OVERWRITE, NULL,
+                                      NULL, NULL, NULL) &&
+                          !g_rename(part_path, output_path);
+        if (!copied) {
+            g_remove(part_path);
+        }
+        g_object_unref(to);
+        g_object_unref(from);
+        g_free(part_path);
+        if (!copied) {
+            return -1;
+        }
+    } else {
+        gchar* data = NULL;
+        gsize size = 0;
+        if (!g_file_get_contents(body_path, &data, &size, NULL)) {
+            return -1;
+        }
+        g_free(response->data);
+        response->data = data;
+        response->size = size;
+        response->capacity = size + 1;
+    }
+
+    // Recently used responses are the last to be evicted
+    g_utime(body_path, NULL);
+    return 0;
+}
+
+static void store(const char* url,
+                  const validators_t* validators,
+                  const response_buf_t* response,
+                  const char* output_path) {
+    gchar* body_path = cache_path(url, "");
+    gchar* meta_path = cache_path(url, ".meta");
+    gchar* dir = g_path_get_dirname(body_path);
+    g_mkdir_with_parents(dir, 0700);
+
+    // The body goes first, so metadata never points at a missing body
+    gboolean stored = FALSE;
+    if (output_path) {
+        GFile* from = g_file_new_for_path(output_path);
+        GFile* to = g_file_new_for_path(body_path);
+        stored = g_file_copy(from, to, G_FILE_COPY_OVERWRITE, NULL, NULL,
+                             NULL, NULL);
+        g_object_unref(to);
+        g_object_unref(from);
+    } else {
+        stored = g_file_set_contents(body_path, response->data,
+                                     (gssize)response->size, NULL);
+    }
+
+    if (stored) {
+        GKeyFile* meta = g_key_file_new();
+        if (validators->etag) {
+            g_key_file_set_string(meta, "cache", "etag", validators->etag);
+        }
+        if (validators->last_modified) {
+            g_key_file_set_string(meta, "cache", "last_modified",
+                                  validators->last_modified);
+        }
+        g_key_file_set_int64(meta, "cache", "fetched",
+                             g_get_real_time() / G_USEC_PER_SEC);
+        g_key_file_save_to_file(meta, meta_path, NULL);
+        g_key_file_free(meta);
+
+        // A copy may keep the time of the file it was copied from
+        g_utime(body_path, NULL);
+        g_mutex_lock(&evict_lock);
+        evict(dir);
+        g_mutex_unlock(&evict_lock);
+    }
+
+    g_free(dir);
+    g_free(meta_path);
+    g_free(body_path);
+}
+
+// Ask the server for the response, or only whether it changed since it was
+// cached when there is a cached copy
+static api_result_e revalidate(CURL* curl,
+                               struct curl_slist** headers,
+                               const char* url,
+                               response_buf_t* response,
+                               const char* output_path,
+                               GKeyFile* meta) {
+    if (meta) {
+        gchar* etag = g_key_file_get_string(meta, "cache", "etag", NULL);
+        gchar* modified =
+            g_key_file_get_string(meta, "cache", "last_modified", NULL);
+        if (etag) {
+            gchar* header = g_strdup_printf("If-None-Match: %s", etag);
+            *headers = curl_slist_append(*headers, header);
+            g_free(header);
+        }
+        if (modified) {
+            gchar* header = g_strdup_printf("If-Modified-Since: %s", modified);
+            *headers = curl_slist_append(*headers, header);
+            g_free(header);
+        }
+        g_free(modified);
+        g_free(etag);
+    }
+
+    api_download_t* download =
+        output_path ? api_download_new(output_path) : NULL;
+    if (output_path && !download) {
+        return API_CURL_ERR;
+    }
+
+    validators_t validators = {0};
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, *headers);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &validators);
+    if (!download) {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+    }
+
+    // A download that stops partway is continued rather than started over
+    CURLcode res = CURLE_OK;
+    for (int attempt = 0; attempt < DOWNLOAD_ATTEMPTS; attempt++) {
+        if (download) {
+            api_download_setup(download, curl, *headers);
+        }
+        res = curl_easy_perform(curl);
+        if (!download || !api_download_interrupted(download, res)) {
+            break;
+        }
+        api_count_transfer(curl);
+    }
+
+    api_result_e check = API_CURL_ERR;
+    long response_code = 0;  // NOLINT(runtime/int) - required by curl API
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+    if (res == CURLE_OK && response_code == 304 && meta) {
+        // Unchanged, only the time it was last known good moves
+        api_count_transfer(curl);
+        api_download_discard(download);
+        gchar* body_path = cache_path(url, "");
+        gchar* meta_path = cache_path(url, ".meta");
+        if (!serve(body_path, response, output_path)) {
+            g_key_file_set_int64(meta, "cache", "fetched",
+                                 g_get_real_time() / G_USEC_PER_SEC);
+            g_key_file_save_to_file(meta, meta_path, NULL);
+            g_atomic_int_inc(&hits);
+            check = API_OK;
+        }
+        g_free(meta_path);
+        g_free(body_path);
+    } else {
+        check = api_check_response(curl, res);
+        if (download) {
+            check = api_download_finish(download, res, check);
+        }
+        if (check == API_OK) {
+            store(url, &validators, response, output_path);
+            g_atomic_int_inc(&misses);
+        }
+    }
+
+    validators_clear(&validators);
+    return check;
+}
+
+extern api_result_e api_cached_get(CURL* curl,
+                                   struct curl_slist** headers,
+                                   const char* url,
+                                   response_buf_t* response,
+                                   const char* output_path) {
+    gchar* body_path = cache_path(url, "");
+    gchar* meta_path = cache_path(url, ".meta");
+    GKeyFile* meta = g_key_file_new();
+    gboolean cached =
+        g_key_file_load_from_file(meta, meta_path, G_KEY_FILE_NONE, NULL) &&
+        g_file_test(body_path, G_FILE_TEST_IS_REGULAR);
+    api_result_e check = API_CURL_ERR;
+
+    // Within the TTL the cached response is used without asking the server
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    gint64 fetched = g_key_file_get_int64(meta, "cache", "fetched", NULL);
+    if (cached && now - fetched < cache_ttl() &&
+        !serve(body_path, response, output_path)) {
+        g_atomic_int_inc(&hits);
+        check = API_OK;
+    } else {
+        check = revalidate(curl, headers, url, response, output_path,
+                           cached ? meta : NULL);
+    }
+
+    g_key_file_free(meta);
+    g_free(meta_path);
+    g_free(body_path);
+    return check;
+}
+
+extern void api_cache_stats(int* hit_count, int* miss_count) {
+    if (hit_count)
+        *hit_count = g_atomic_int_get(&hits);
+    if (miss_count)
+        *miss_count = g_atomic_int_get(&misses);
+}
@@ -0,0 +1,214 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <glib/gstdio.h>
+#include "api/internal.h"
+
+// Downloads are written through a large stdio buffer, and curl hands them
+// over in chunks of the same size
+#define DOWNLOAD_BUFFER_SIZE (256 * 1024)
+
+struct api_download {
+    char* output_path;
+    char* part_path;
+    char* etag_path;
+    FILE* fp;
+    char* buffer;
+    CURL* curl;
+    struct curl_slist* headers;
+    /// @brief Bytes of the file already in the .part file
+    curl_off_t offset;
+    /// @brief ETag of the file being downloaded, needed to resume it
+    char* etag;
+    /// @brief Whether the current transfer has written anything yet
+    bool started;
+    /// @brief Whether the current transfer is an error page, not the file
+    bool skip;
+};
+
+static void reopen(api_download_t* download, const char* mode) {
+    if (download->fp) {
+        fclose(download->fp);
+    }
+    download->fp = g_fopen(download->part_path, mode);
+    if (download->fp) {
+        setvbuf(download->fp, download->buffer, _IOFBF, DOWNLOAD_BUFFER_SIZE);
+    }
+}
+
+extern api_download_t* api_download_new(const char* output_path) {
+    api_download_t* download = g_new0(api_download_t, 1);
+    download->output_path = g_strdup(output_path);
+    download->part_path = g_strconcat(output_path, ".part", NULL);
+    download->etag_path = g_strconcat(output_path, ".part.etag", NULL);
+    download->buffer = g_malloc(DOWNLOAD_BUFFER_SIZE);
+
+    // Continue a download that was interrupted, if its version is known
+    GStatBuf st;
+    if (g_file_get_contents(download->etag_path, &download->etag, NULL,
+                            NULL) &&
+        !g_stat(download->part_path, &st) && st.st_size > 0) {
+        download->offset = (curl_off_t)st.st_size;
+        reopen(download, "ab");
+    } else {
+        g_clear_pointer(&download->etag, g_free);
+        reopen(download, "wb");
+    }
+
+    if (!download->fp) {
+        api_download_free(download);
+        return NULL;
+    }
+    return download;
+}
+
+static size_t write_download_cb(void* ptr,
+                                size_t size,
+                                size_t nmemb,
+                                void* data) {
+    api_download_t* download = data;
+
+    // Once the headers are in, find out whether the server continued where
+    // the .part file ends or sent the file from the start
+    if (!download->started) {
+        download->started = true;
+        long code = 0;  // NOLINT(runtime/int) - required by curl API
+        curl_easy_getinfo(download->curl, CURLINFO_RESPONSE_CODE, &code);
+        download->skip = code < 200 || code >= 300;
+        if (code != 206 && !download->skip && download->offset > 0) {
+            download->offset = 0;
+            reopen(download, "wb");
+        }
+
+        struct curl_header* header = NULL;
+        if (code == 206 || download->skip) {
+            // Still the same file, or not the file at all
+        } else if (curl_easy_header(download->curl, "ETag", 0, CURLH_HEADER,
+                                    -1, &header) == CURLHE_OK) {
+            g_free(download->etag);
+            download->etag = g_strdup(header->value);
+            g_file_set_contents(download->etag_path, download->etag, -1,
+                                NULL);
+        } else {
+            g_clear_pointer(&download->etag, g_free);
+            g_remove(download->etag_path);
+        }
+    }
+
+    if (download->skip) {
+        return size * nmemb;
+    }
+    if (!download->fp) {
+        return 0;
+    }
+    size_t written = fwrite(ptr, size, nmemb, download->fp);
+    download->offset += (curl_off_t)(written * size);
+    return written * size;
+}
+
+extern void api_download_setup(api_download_t* download,
+                               CURL* curl,
+                               const struct curl_slist* headers) {
+    download->curl = curl;
+    download->started = false;
+    download->skip = false;
+    if (download->fp) {
+        fflush(download->fp);
+    }
+
+    curl_slist_free_all(download->headers);
+    download->headers = NULL;
+    for (const struct curl_slist* it = headers; it; it = it->next) {
+        download->headers = curl_slist_append(download->headers, it->data);
+    }
+
+    // Ask for the rest of the file, but only if it is still the same file.
+    // The .part file holds it decoded, so the rest has to come as is for the
+    // range to line up, while a fresh request may still be compressed.
+    if (download->offset > 0 && download->etag) {
+        gchar* header = g_strdup_printf("If-Range: %s", download->etag);
+        download->headers = curl_slist_append(download->headers, header);
+        g_free(header);
+        gchar* range =
+            g_strdup_printf("%" CURL_FORMAT_CURL_OFF_T "-", download->offset);
+        curl_easy_setopt(curl, CURLOPT_RANGE, range);
+        g_free(range);
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, NULL);
+    } else {
+        download->offset = 0;
+        curl_easy_setopt(curl, CURLOPT_RANGE, NULL);
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    }
+
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, download->headers);
+    curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, (long)DOWNLOAD_BUFFER_SIZE);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_download_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, download);
+}
+
+extern bool api_download_interrupted(const api_download_t* download,
+                                     CURLcode res) {
+    // Only what a later request can continue counts, anything else fails
+    bool transient = res == CURLE_PARTIAL_FILE ||
+                     res == CURLE_OPERATION_TIMEDOUT ||
+                     res == CURLE_RECV_ERROR || res == CURLE_GOT_NOTHING ||
+                     res == CURLE_SEND_ERROR;
+    return transient && download->offset > 0 && download->etag;
+}
+
+extern api_result_e api_download_finish(api_download_t* download,
+                                        CURLcode res,
+                                        api_result_e check) {
+    if (download->fp && fclose(download->fp) && check == API_OK) {
+        check = API_CURL_ERR;
+    }
+    download->fp = NULL;
+
+    // The file only appears under its name once it is whole, and what was
+    // received is kept for the next attempt if the server could continue it
+    bool resumable = download->offset > 0 && download->etag &&
+                     (api_download_interrupted(download, res) ||
+                      check == API_SERVER_ERR);
+    if (check == API_OK) {
+        if (g_rename(download->part_path, download->output_path)) {
+            check = API_CURL_ERR;
+        }
+        g_remove(download->etag_path);
+    } else if (!resumable) {
+        api_download_discard(download);
+        return check;
+    }
+
+    api_download_free(download);
+    return check;
+}
+
+extern void api_download_discard(api_download_t* download) {
+    if (!download)
+        return;
+
+    if (download->fp) {
+        fclose(download->fp);
+        download->fp = NULL;
+    }
+    g_remove(download->part_path);
+    g_remove(download->etag_path);
+    api_download_free(download);
+}
+
+extern void api_download_free(api_download_t* download) {
+    if (!download)
+        return;
+
+    // Dropped downloads keep their .part file to be continued later
+    if (download->fp) {
+        fclose(download->fp);
+    }
+    curl_slist_free_all(download->headers);
+    g_free(download->etag);
+    g_free(download->buffer);
+    g_free(download->etag_path);
+    g_free(download->part_path);
+    g_free(download->output_path);
+    g_free(download);
+}
@@ -1,19 +1,67 @@
 #include <errno.h>  // IWYU pragma: keep
+#include <gio/gio.h>
 #include <glib.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include "api/api.h"
 #include "api/internal.h"
 #include "config/config.h"
 
 static const char DEFAULT_API_URL[] = "https://gittor.rent/api";
 static const char USER_AGENT[] = "GitTor-CLI/dev";  // Hardcoded for now
 
+// Most JSON responses fit the first allocation of a response buffer
+#define RESPONSE_BUF_MIN 16384
+
+// Every handle shares DNS, TLS sessions and connections, so only the first
+// API call of the process pays for the lookup and handshakes
+static GMutex share_mutex;
+static CURLSH* share = NULL;
+static GMutex share_locks[CURL_LOCK_DATA_LAST];
+
+// Bytes sent and received by every transfer, headers included and bodies as
+// they were on the wire, before decoding
+static guint64 wire_received = 0;
+static guint64 wire_sent = 0;
+static GMutex wire_mutex;
+
+static void share_lock(CURL* handle,
+                       curl_lock_data data,
+                       curl_lock_access access,
+                       void* userptr) {
+    (void)handle;
+    (void)access;
+    (void)userptr;
+    g_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    (void)userptr;
+    g_mutex_unlock(&share_locks[data]);
+}
+
+static CURLSH* api_share() {
+    g_mutex_lock(&share_mutex);
+    if (!share && (share = curl_share_init())) {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    }
+    CURLSH* result = share;
+    g_mutex_unlock(&share_mutex);
+    return result;
+}
+
 extern response_buf_t response_buf_init() {
     response_buf_t buf;
     buf.data = g_malloc(1);
     buf.data[0] = '\0';
     buf.size = 0;
+    buf.capacity = 1;
     return buf;
 }
 
@@ -21,13 +69,22 @@ extern size_t write_cb(void* ptr, size_t size, size_t nmemb, void* userdata) {
     size_t total = size * nmemb;
     response_buf_t* buf = (response_buf_t*)userdata;
 
-    // Reallocate buffer for new data + null terminator
-    char* tmp = g_realloc(buf->data, buf->size + total + 1);
-    if (!tmp)
-        return 0;
+    // Grow geometrically for new data + null terminator, so a response
+    // arriving in many chunks is reallocated a handful of times
+    if (buf->size + total + 1 > buf->capacity) {
+        size_t capacity = MAX(buf->capacity, RESPONSE_BUF_MIN);
+        while (capacity < buf->size + total + 1) {
+            capacity *= 2;
+        }
+        char* tmp = g_try_realloc(buf->data, capacity);
+        if (!tmp)
+            return 0;
+
+        buf->data = tmp;
+        buf->capacity = capacity;
+    }
 
     // Append new data
-    buf->data = tmp;
     memcpy(buf->data + buf->size, ptr, total);  // NOLINT - safe since realloc
     buf->size += total;
     buf->data[buf->size] = '\0';
@@ -35,13 +92,6 @@ extern size_t write_cb(void* ptr, size_t size, size_t nmemb, void* userdata) {
     return total;
 }
 
-extern size_t write_file_cb(void* ptr,
-                            size_t size,
-                            size_t nmemb,
-                            void* stream) {
-    return fwrite(ptr, size, nmemb, (FILE*)stream);
-}
-
 extern char* api_get_base_url() {
     // Get the API URL from config
     char* endpoint_url =
@@ -108,9 +158,28 @@ extern CURL* api_curl_handle_new() {
     curl_easy_setopt(curl, CURLOPT_USERAGENT, USER_AGENT);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
 
+    // Offer every encoding libcurl was built with, .torrent files and large
+    // JSON responses compress well
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+
+    // Keep connections alive between calls through the shared pool
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    CURLSH* shared = api_share();
+    if (shared) {
+        curl_easy_setopt(curl, CURLOPT_SHARE, shared);
+    }
+
     return curl;
 }
 
+extern void api_share_cleanup() {
+    g_mutex_lock(&share_mutex);
+    if (share && curl_share_cleanup(share) == CURLSHE_OK) {
+        share = NULL;
+    }
+    g_mutex_unlock(&share_mutex);
+}
+
 extern int api_build_url(char* out,
                          size_t out_size,
                          const char* path_fmt,
@@ -136,7 +205,94 @@ extern int api_build_url(char* out,
                : 0;
 }
 
+extern void api_count_transfer(CURL* curl) {
+    curl_off_t body_received = 0;
+    curl_off_t body_sent = 0;
+    long header_received = 0;  // NOLINT(runtime/int) - required by curl API
+    long header_sent = 0;      // NOLINT(runtime/int) - required by curl API
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &body_received);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &body_sent);
+    curl_easy_getinfo(curl, CURLINFO_HEADER_SIZE, &header_received);
+    curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &header_sent);
+
+    g_mutex_lock(&wire_mutex);
+    wire_received += (guint64)body_received + (guint64)header_received;
+    wire_sent += (guint64)body_sent + (guint64)header_sent;
+    g_mutex_unlock(&wire_mutex);
+}
+
+extern void api_wire_stats(uint64_t* received, uint64_t* sent) {
+    g_mutex_lock(&wire_mutex);
+    if (received)
+        *received = wire_received;
+    if (sent)
+        *sent = wire_sent;
+    g_mutex_unlock(&wire_mutex);
+}
+
+// Compress a file with gzip into memory, NULL if that doesn't make it smaller
+static GBytes* gzip_file(const char* file_path) {
+    gchar* data = NULL;
+    gsize size = 0;
+    if (!g_file_get_contents(file_path, &data, &size, NULL)) {
+        return NULL;
+    }
+
+    GZlibCompressor* gzip =
+        g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1);
+    GByteArray* out = g_byte_array_new();
+    guint8 buffer[64 * 1024];
+    gsize offset = 0;
+    GConverterResult result = G_CONVERTER_CONVERTED;
+    while (result == G_CONVERTER_CONVERTED) {
+        gsize read = 0;
+        gsize written = 0;
+        result = g_converter_convert(
+            G_CONVERTER(gzip), data + offset, size - offset, buffer,
+            sizeof(buffer), G_CONVERTER_INPUT_AT_END, &read, &written, NULL);
+        offset += read;
+        g_byte_array_append(out, buffer, (guint)written);
+    }
+
+    GBytes* compressed = NULL;
+    if (result == G_CONVERTER_FINISHED && out->len < size) {
+        compressed = g_byte_array_free_to_bytes(out);
+    } else {
+        g_byte_array_free(out, TRUE);
+    }
+    g_object_unref(gzip);
+    g_free(data);
+    return compressed;
+}
+
+extern void api_mime_file(curl_mimepart* part, const char* file_path) {
+    char* encoding = config_get(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "upload_encoding"}, NULL);
+    GBytes* compressed = encoding && g_ascii_strcasecmp(encoding, "gzip") == 0
+                             ? gzip_file(file_path)
+                             : NULL;
+
+    if (compressed) {
+        // curl copies the data, so it doesn't need to outlive the part
+        gsize size = 0;
+        const char* data = g_bytes_get_data(compressed, &size);
+        gchar* filename = g_path_get_basename(file_path);
+        curl_mime_data(part, data, size);
+        curl_mime_filename(part, filename);
+        curl_mime_headers(part,
+                          curl_slist_append(NULL, "Content-Encoding: gzip"),
+                          1);
+        g_free(filename);
+        g_bytes_unref(compressed);
+    } else {
+        curl_mime_filedata(part, file_path);
+    }
+    g_free(encoding);
+}
+
 extern api_result_e api_check_response(CURL* curl, CURLcode res) {
+    api_count_transfer(curl);
     if (res != CURLE_OK)
         return API_CURL_ERR;
 
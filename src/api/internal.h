@@ -1,6 +1,7 @@
 #ifndef API_INTERNAL_H_
 #define API_INTERNAL_H_
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <time.h>
 #include <curl/curl.h>
@@ -26,6 +27,9 @@ typedef enum __attribute__((packed)) {
 typedef struct {
     char* data;
     size_t size;
+    /// @brief Bytes allocated for data, which grows geometrically so a
+    /// response costs a logarithmic number of reallocations
+    size_t capacity;
 } response_buf_t;
 
 /**
@@ -42,10 +46,111 @@ extern response_buf_t response_buf_init();
 extern size_t write_cb(void* ptr, size_t size, size_t nmemb, void* userdata);
 
 /**
- * @brief libcurl write callback for binary file downloads.
- * Pass to CURLOPT_WRITEFUNCTION; pass a FILE* to CURLOPT_WRITEDATA.
+ * @brief Region allocator owning many small objects, freed all at once.
  */
-extern size_t write_file_cb(void* ptr, size_t size, size_t nmemb, void* stream);
+typedef struct api_arena api_arena_t;
+
+/**
+ * @brief Create an arena. Sized for everything it will hold, it is a single
+ * allocation, and it grows by doubling past that.
+ *
+ * @param size Expected number of bytes to allocate from it
+ * @return api_arena_t* The arena. Caller must free with api_arena_free().
+ */
+extern api_arena_t* api_arena_new(size_t size);
+
+/**
+ * @brief Allocate zeroed memory, suitably aligned for any type, from an arena.
+ *
+ * @param arena The arena
+ * @param size Number of bytes to allocate
+ * @return void* The memory, valid until the arena is freed
+ */
+extern void* api_arena_alloc(api_arena_t* arena, size_t size);
+
+/**
+ * @brief Copy a string into an arena.
+ *
+ * @param arena The arena
+ * @param str The string to copy (can be NULL)
+ * @return char* The copy valid until the arena is freed, or NULL if str is
+ */
+extern char* api_arena_strdup(api_arena_t* arena, const char* str);
+
+/**
+ * @brief Free an arena and everything allocated from it.
+ *
+ * @param arena The arena to free (can be NULL)
+ */
+extern void api_arena_free(api_arena_t* arena);
+
+/**
+ * @brief A file being downloaded. It is written to <output>.part through a
+ * large buffer and renamed into place once complete. An interrupted download
+ * keeps its .part file and the ETag it was sent with, and the next download
+ * to the same path continues it with a Range request.
+ */
+typedef struct api_download api_download_t;
+
+/**
+ * @brief Start or continue downloading a file.
+ *
+ * @param output_path Path the file is renamed to once complete
+ * @return api_download_t* The download, or NULL if the .part file can't be
+ * opened. Caller must end it with api_download_finish() or
+ * api_download_discard().
+ */
+extern api_download_t* api_download_new(const char* output_path);
+
+/**
+ * @brief Set up a CURL handle to write the response to a download, asking
+ * only for the part not downloaded yet. Call again before retrying.
+ *
+ * @param download The download
+ * @param curl The CURL handle to set up
+ * @param headers The request headers, copied with an If-Range header added
+ */
+extern void api_download_setup(api_download_t* download,
+                               CURL* curl,
+                               const struct curl_slist* headers);
+
+/**
+ * @brief Check whether a failed transfer can be continued where it stopped.
+ *
+ * @param download The download
+ * @param res The CURLcode result of the transfer
+ * @return bool true if retrying would continue the download
+ */
+extern bool api_download_interrupted(const api_download_t* download,
+                                     CURLcode res);
+
+/**
+ * @brief End a download, renaming it into place if it succeeded. Frees the
+ * download.
+ *
+ * @param download The download
+ * @param res The CURLcode result of the transfer
+ * @param check The result of the request
+ * @return api_result_e check, or API_CURL_ERR if the file couldn't be written
+ */
+extern api_result_e api_download_finish(api_download_t* download,
+                                        CURLcode res,
+                                        api_result_e check);
+
+/**
+ * @brief End a download that is no longer needed, removing its .part file.
+ * Frees the download.
+ *
+ * @param download The download (can be NULL)
+ */
+extern void api_download_discard(api_download_t* download);
+
+/**
+ * @brief Free a download, keeping its .part file to be continued later.
+ *
+ * @param download The download (can be NULL)
+ */
+extern void api_download_free(api_download_t* download);
 
 /**
  * @brief Get the base API URL from config or default. Caller must free the
@@ -68,12 +173,20 @@ extern api_result_e api_auth_headers(struct curl_slist** headers);
 
 /**
  * @brief Create a new CURL handle with standard project settings (timeouts,
- * user-agent, etc).
+ * user-agent, etc). Handles share one DNS cache, TLS session cache and
+ * connection pool, so connections outlive curl_easy_cleanup() and are reused
+ * by the next call to the same host.
  *
  * @return CURL* Configured CURL handle, or NULL on failure
  */
 extern CURL* api_curl_handle_new();
 
+/**
+ * @brief Release the DNS, TLS session and connection caches shared by the
+ * CURL handles. Every handle must have been cleaned up first.
+ */
+extern void api_share_cleanup();
+
 /**
  * @brief Build a full API URL from a path format string.
  *
@@ -84,6 +197,25 @@ extern CURL* api_curl_handle_new();
  */
 extern int api_build_url(char* out, size_t out_size, const char* path_fmt, ...);
 
+/**
+ * @brief Add the bytes a completed transfer sent and received to the totals
+ * reported by api_wire_stats(). Called by api_check_response().
+ *
+ * @param curl The CURL handle used for the transfer
+ */
+extern void api_count_transfer(CURL* curl);
+
+/**
+ * @brief Set the contents of a multipart file part. With
+ * network.upload_encoding set to gzip, the file is sent gzip compressed with a
+ * Content-Encoding header when that makes it smaller, for servers that accept
+ * compressed uploads.
+ *
+ * @param part The part to set the contents of
+ * @param file_path Path to the file to upload
+ */
+extern void api_mime_file(curl_mimepart* part, const char* file_path);
+
 /**
  * @brief Check a completed CURL request for errors.
  *
@@ -93,6 +225,28 @@ extern int api_build_url(char* out, size_t out_size, const char* path_fmt, ...);
  */
 extern api_result_e api_check_response(CURL* curl, CURLcode res);
 
+/**
+ * @brief Perform a GET request through the on-disk response cache. A cached
+ * response younger than network.cache_ttl seconds is used as is, an older one
+ * is revalidated with If-None-Match/If-Modified-Since and reused on a 304.
+ * Storing a response evicts the least recently used ones once the cache holds
+ * more than network.cache_size bytes. Give either a response buffer or an
+ * output path.
+ *
+ * @param curl The CURL handle to use for the request
+ * @param headers Pointer to the request headers, conditional headers are
+ * appended to it
+ * @param url The full URL to get
+ * @param response Response buffer for JSON/text responses, or NULL
+ * @param output_path File path to save the response to, or NULL
+ * @return api_result_e appropriate result code
+ */
+extern api_result_e api_cached_get(CURL* curl,
+                                   struct curl_slist** headers,
+                                   const char* url,
+                                   response_buf_t* response,
+                                   const char* output_path);
+
 /**
  * @brief Parse an expiry time string (expected to be in ISO 8601 format) into a
  * time_t epoch value.
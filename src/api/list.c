@@ -0,0 +1,353 @@
+#include <glib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include "api/internal.h"
+#include "api/torrents.h"
+
+// Torrents larger than this are malformed, and the listing stops there
+#define MAX_ITEM_SIZE (1024 * 1024)
+
+/**
+ * @brief Incremental reader of a page of torrents, fed the response as it
+ * arrives. Only the torrent being read is buffered, each one is parsed on its
+ * own as soon as its closing brace arrives.
+ */
+typedef struct {
+    int depth;
+    /// @brief Depth of the array holding the torrents, 0 until it is found
+    int items_depth;
+    bool root_is_object;
+    bool in_string;
+    bool escape;
+    bool expect_key;
+    bool in_key;
+    bool failed;
+    /// @brief The last member name of the page object
+    GString* key;
+    /// @brief The scalar value of the current member of the page object
+    GString* scalar;
+    /// @brief The torrent being read, or NULL between torrents
+    GString* item;
+    /// @brief Whether the page has a "last" member, bare arrays don't
+    bool has_last;
+    /// @brief Set once a page says it is the last one
+    bool last;
+    size_t items;
+    GQueue* ready;
+} page_reader_t;
+
+struct torrent_iter {
+    CURLM* curlm;
+    CURL* curl;
+    struct curl_slist* headers;
+    char* query;
+    size_t page_size;
+    int64_t page;
+    bool done;
+    api_result_e result;
+    page_reader_t reader;
+};
+
+static void reader_reset(page_reader_t* reader) {
+    reader->depth = 0;
+    reader->items_depth = 0;
+    reader->root_is_object = false;
+    reader->in_string = false;
+    reader->escape = false;
+    reader->expect_key = false;
+    reader->in_key = false;
+    reader->failed = false;
+    reader->has_last = false;
+    reader->last = false;
+    reader->items = 0;
+    g_string_truncate(reader->key, 0);
+    g_string_truncate(reader->scalar, 0);
+    if (reader->item) {
+        g_string_free(reader->item, TRUE);
+        reader->item = NULL;
+    }
+}
+
+static void reader_end_member(page_reader_t* reader) {
+    if (strcmp(reader->key->str, "last") == 0) {
+        reader->has_last = true;
+        reader->last = strcmp(reader->scalar->str, "true") == 0;
+    }
+    g_string_truncate(reader->scalar, 0);
+}
+
+static void reader_end_item(page_reader_t* reader) {
+    torrent_dto_t* dto = parse_torrent_json(reader->item->str);
+    g_string_free(reader->item, TRUE);
+    reader->item = NULL;
+    reader->items++;
+    if (dto) {
+        g_queue_push_tail(reader->ready, dto);
+    } else {
+        reader->failed = true;
+    }
+}
+
+// Follow the structure of the page one character at a time, buffering
+// nothing but member names, scalars of the page object and the current
+// torrent
+static void reader_feed(page_reader_t* reader, const char* data, size_t len) {
+    for (size_t i = 0; i < len && !reader->failed; i++) {
+        char c = data[i];
+        if (reader->item) {
+            g_string_append_c(reader->item, c);
+            if (reader->item->len > MAX_ITEM_SIZE) {
+                reader->failed = true;
+            }
+        }
+
+        if (reader->in_string) {
+            if (reader->escape) {
+                reader->escape = false;
+            } else if (c == '\\') {
+                reader->escape = true;
+            } else if (c == '"') {
+                reader->in_string = false;
+                reader->in_key = false;
+            }
+            if (reader->in_string && reader->in_key) {
+                g_string_append_c(reader->key, c);
+            }
+            continue;
+        }
+
+        bool top = reader->root_is_object && reader->depth == 1;
+        switch (c) {
+            case '"':
+                reader->in_string = true;
+                if (top && reader->expect_key) {
+                    reader->in_key = true;
+                    g_string_truncate(reader->key, 0);
+                }
+                break;
+
+            case ':':
+                if (top) {
+                    reader->expect_key = false;
+                }
+                break;
+
+            case ',':
+                if (top) {
+                    reader_end_member(reader);
+                    reader->expect_key = true;
+                }
+                break;
+
+            case '{':
+            case '[':
+                if (reader->depth == 0) {
+                    // Either a page object or a plain array of torrents
+                    reader->root_is_object = c == '{';
+                    reader->expect_key = c == '{';
+                    reader->items_depth = c == '[' ? 1 : 0;
+                } else if (top && c == '[' &&
+                           strcmp(reader->key->str, "content") == 0) {
+                    reader->items_depth = 2;
+                } else if (c == '{' && !reader->item &&
+                           reader->depth == reader->items_depth) {
+                    reader->item = g_string_new("{");
+                }
+                reader->depth++;
+                break;
+
+            case '}':
+            case ']':
+                reader->depth--;
+                if (reader->item && reader->depth == reader->items_depth) {
+                    reader_end_item(reader);
+                } else if (reader->depth < reader->items_depth) {
+                    reader->items_depth = 0;
+                }
+                if (reader->root_is_object && reader->depth == 0) {
+                    reader_end_member(reader);
+                }
+                break;
+
+            default:
+                if (top && !reader->expect_key && !g_ascii_isspace(c)) {
+                    g_string_append_c(reader->scalar, c);
+                }
+                break;
+        }
+    }
+}
+
+static size_t write_page_cb(void* ptr, size_t size, size_t nmemb, void* data) {
+    page_reader_t* reader = data;
+    reader_feed(reader, ptr, size * nmemb);
+    return reader->failed ? 0 : size * nmemb;
+}
+
+static torrent_iter_t* iter_new(const char* query,
+                                size_t page_size,
+                                api_result_e* result) {
+    struct curl_slist* headers =
+        curl_slist_append(NULL, "Accept: application/json");
+    api_result_e auth_result = api_auth_headers(&headers);
+    CURLM* curlm = auth_result == API_OK ? curl_multi_init() : NULL;
+    if (auth_result == API_OK && !curlm) {
+        auth_result = API_CURL_ERR;
+    }
+    if (result) {
+        *result = auth_result;
+    }
+    if (!curlm) {
+        curl_slist_free_all(headers);
+        return NULL;
+    }
+
+    torrent_iter_t* iter = g_new0(torrent_iter_t, 1);
+    iter->curlm = curlm;
+    iter->headers = headers;
+    iter->query = query ? g_uri_escape_string(query, NULL, FALSE) : NULL;
+    iter->page_size = page_size ? page_size : 50;
+    iter->result = API_OK;
+    iter->reader.key = g_string_new(NULL);
+    iter->reader.scalar = g_string_new(NULL);
+    iter->reader.ready = g_queue_new();
+    return iter;
+}
+
+extern torrent_iter_t* api_list_torrents(size_t page_size,
+                                         api_result_e* result) {
+    return iter_new(NULL, page_size, result);
+}
+
+extern torrent_iter_t* api_search_torrents(const char* query,
+                                           size_t page_size,
+                                           api_result_e* result) {
+    if (!query) {
+        if (result)
+            *result = API_BAD_REQUEST;
+
+        return NULL;
+    }
+    return iter_new(query, page_size, result);
+}
+
+static void end_page(torrent_iter_t* iter) {
+    if (iter->curl) {
+        curl_multi_remove_handle(iter->curlm, iter->curl);
+        curl_easy_cleanup(iter->curl);
+        iter->curl = NULL;
+    }
+}
+
+static void fail(torrent_iter_t* iter, api_result_e result) {
+    end_page(iter);
+    iter->result = result;
+    iter->done = true;
+}
+
+static void start_page(torrent_iter_t* iter) {
+    // Build the URL: /torrents?page={n}&size={n}, or /torrents/search?q=...
+    char url[1024];
+    int err = 0;
+    if (iter->query) {
+        err = api_build_url(url, sizeof(url),
+                            "/torrents/search?q=%s&page=%" PRId64 "&size=%zu",
+                            iter->query, iter->page, iter->page_size);
+    } else {
+        err = api_build_url(url, sizeof(url),
+                            "/torrents?page=%" PRId64 "&size=%zu", iter->page,
+                            iter->page_size);
+    }
+
+    iter->curl = err ? NULL : api_curl_handle_new();
+    if (!iter->curl) {
+        fail(iter, err ? API_SERVER_ERR : API_CURL_ERR);
+        return;
+    }
+
+    reader_reset(&iter->reader);
+    curl_easy_setopt(iter->curl, CURLOPT_URL, url);
+    curl_easy_setopt(iter->curl, CURLOPT_HTTPHEADER, iter->headers);
+    curl_easy_setopt(iter->curl, CURLOPT_WRITEFUNCTION, write_page_cb);
+    curl_easy_setopt(iter->curl, CURLOPT_WRITEDATA, &iter->reader);
+    if (curl_multi_add_handle(iter->curlm, iter->curl) != CURLM_OK) {
+        fail(iter, API_CURL_ERR);
+    }
+}
+
+// Move the page download along until it hands out a torrent or completes
+static void pump(torrent_iter_t* iter) {
+    int running = 0;
+    CURLMcode mc = curl_multi_perform(iter->curlm, &running);
+    if (mc == CURLM_OK && running) {
+        mc = curl_multi_poll(iter->curlm, NULL, 0, 1000, NULL);
+    }
+    if (mc != CURLM_OK) {
+        fail(iter, API_CURL_ERR);
+        return;
+    }
+
+    CURLMsg* msg = NULL;
+    int left = 0;
+    while ((msg = curl_multi_info_read(iter->curlm, &left))) {
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+        api_result_e check = api_check_response(msg->easy_handle,
+                                                msg->data.result);
+        if (check == API_OK && iter->reader.failed) {
+            check = API_SERVER_ERR;
+        }
+        if (check != API_OK) {
+            fail(iter, check);
+            return;
+        }
+
+        // A page object says whether it is the last, the server may cap its
+        // size below the one asked for. A bare array is the last when short.
+        end_page(iter);
+        bool last = iter->reader.has_last
+                        ? iter->reader.last
+                        : iter->reader.items < iter->page_size;
+        if (last || iter->reader.items == 0) {
+            iter->done = true;
+        } else {
+            iter->page++;
+        }
+    }
+}
+
+extern torrent_dto_t* torrent_iter_next(torrent_iter_t* iter,
+                                        api_result_e* result) {
+    if (!iter)
+        return NULL;
+
+    while (g_queue_is_empty(iter->reader.ready) && !iter->done) {
+        if (!iter->curl) {
+            start_page(iter);
+        } else {
+            pump(iter);
+        }
+    }
+
+    if (result)
+        *result = iter->result;
+
+    return g_queue_pop_head(iter->reader.ready);
+}
+
+extern void torrent_iter_free(torrent_iter_t* iter) {
+    if (!iter)
+        return;
+
+    end_page(iter);
+    reader_reset(&iter->reader);
+    g_queue_free_full(iter->reader.ready, (GDestroyNotify)torrent_dto_free);
+    g_string_free(iter->reader.scalar, TRUE);
+    g_string_free(iter->reader.key, TRUE);
+    curl_multi_cleanup(iter->curlm);
+    curl_slist_free_all(iter->headers);
+    g_free(iter->query);
+    g_free(iter);
+}
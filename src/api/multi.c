@@ -0,0 +1,235 @@
+#include <glib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include "api/internal.h"
+#include "api/multi.h"
+
+// A few connections per host, each carrying many requests as streams
+#define MAX_HOST_CONNECTIONS 4L
+#define MAX_CONCURRENT_STREAMS 100L
+
+typedef struct {
+    CURL* curl;
+    response_buf_t response;
+    api_download_t* download;
+    char* output_path;
+    api_multi_cb cb;
+    void* userdata;
+} api_request_t;
+
+struct api_multi {
+    CURLM* curlm;
+    struct curl_slist* json_headers;
+    struct curl_slist* file_headers;
+    GPtrArray* requests;
+};
+
+static void request_free(api_request_t* request) {
+    api_download_discard(request->download);
+    curl_easy_cleanup(request->curl);
+    g_free(request->response.data);
+    g_free(request->output_path);
+    g_free(request);
+}
+
+extern api_multi_t* api_multi_new(api_result_e* result) {
+    struct curl_slist* json_headers =
+        curl_slist_append(NULL, "Accept: application/json");
+    struct curl_slist* file_headers =
+        curl_slist_append(NULL, "Accept: application/x-bittorrent");
+    api_result_e auth_result = api_auth_headers(&json_headers);
+    if (auth_result == API_OK) {
+        auth_result = api_auth_headers(&file_headers);
+    }
+
+    CURLM* curlm = auth_result == API_OK ? curl_multi_init() : NULL;
+    if (auth_result == API_OK && !curlm) {
+        auth_result = API_CURL_ERR;
+    }
+    if (result) {
+        *result = auth_result;
+    }
+    if (!curlm) {
+        curl_slist_free_all(json_headers);
+        curl_slist_free_all(file_headers);
+        return NULL;
+    }
+
+    // Multiplex the requests as streams of the same connections, rather
+    // than opening a connection per request
+    curl_multi_setopt(curlm, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(curlm, CURLMOPT_MAX_HOST_CONNECTIONS,
+                      MAX_HOST_CONNECTIONS);
+    curl_multi_setopt(curlm, CURLMOPT_MAX_CONCURRENT_STREAMS,
+                      MAX_CONCURRENT_STREAMS);
+
+    api_multi_t* multi = g_new0(api_multi_t, 1);
+    multi->curlm = curlm;
+    multi->json_headers = json_headers;
+    multi->file_headers = file_headers;
+    multi->requests = g_ptr_array_new();
+    return multi;
+}
+
+static int queue(api_multi_t* multi,
+                 const char* output_path,
+                 api_multi_cb cb,
+                 void* userdata,
+                 const char* path_fmt,
+                 va_list args) {
+    char url[1024];
+    char* path = g_strdup_vprintf(path_fmt, args);
+    int err = api_build_url(url, sizeof(url), "%s", path);
+    g_free(path);
+    if (err) {
+        return err;
+    }
+
+    api_request_t* request = g_new0(api_request_t, 1);
+    request->curl = api_curl_handle_new();
+    request->cb = cb;
+    request->userdata = userdata;
+    if (output_path) {
+        request->output_path = g_strdup(output_path);
+        request->download = api_download_new(output_path);
+    } else {
+        request->response = response_buf_init();
+    }
+    if (!request->curl || (output_path && !request->download)) {
+        request_free(request);
+        return -1;
+    }
+
+    CURL* curl = request->curl;
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, request);
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+    if (output_path) {
+        api_download_setup(request->download, curl, multi->file_headers);
+    } else {
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, multi->json_headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &request->response);
+    }
+
+    if (curl_multi_add_handle(multi->curlm, curl) != CURLM_OK) {
+        request_free(request);
+        return -1;
+    }
+    g_ptr_array_add(multi->requests, request);
+    return 0;
+}
+
+extern int api_multi_get(api_multi_t* multi,
+                         api_multi_cb cb,
+                         void* userdata,
+                         const char* path_fmt,
+                         ...) {
+    va_list args;
+    va_start(args, path_fmt);
+    int err = queue(multi, NULL, cb, userdata, path_fmt, args);
+    va_end(args);
+    return err;
+}
+
+extern int api_multi_get_file(api_multi_t* multi,
+                              const char* output_path,
+                              api_multi_cb cb,
+                              void* userdata,
+                              const char* path_fmt,
+                              ...) {
+    if (!output_path) {
+        return -1;
+    }
+
+    va_list args;
+    va_start(args, path_fmt);
+    int err = queue(multi, output_path, cb, userdata, path_fmt, args);
+    va_end(args);
+    return err;
+}
+
+static void complete(api_multi_t* multi,
+                     api_request_t* request,
+                     CURLcode res,
+                     api_result_e check) {
+    curl_multi_remove_handle(multi->curlm, request->curl);
+    g_ptr_array_remove_fast(multi->requests, request);
+
+    // The file appears only once it is fully written
+    if (request->download) {
+        check = api_download_finish(request->download, res, check);
+        request->download = NULL;
+    }
+
+    if (request->cb) {
+        request->cb(check, request->output_path ? NULL : &request->response,
+                    request->userdata);
+    }
+    request_free(request);
+}
+
+extern void api_multi_wait(api_multi_t* multi) {
+    while (multi->requests->len > 0) {
+        int running = 0;
+        CURLMcode mc = curl_multi_perform(multi->curlm, &running);
+        if (mc == CURLM_OK && running) {
+            mc = curl_multi_poll(multi->curlm, NULL, 0, 1000, NULL);
+        }
+
+        // Completed requests may queue more, so collect them all first
+        GPtrArray* done = g_ptr_array_new();
+        GArray* results = g_array_new(FALSE, FALSE, sizeof(api_result_e));
+        GArray* codes = g_array_new(FALSE, FALSE, sizeof(CURLcode));
+        CURLMsg* msg = NULL;
+        int left = 0;
+        while ((msg = curl_multi_info_read(multi->curlm, &left))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            api_request_t* request = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &request);
+            api_result_e check =
+                api_check_response(msg->easy_handle, msg->data.result);
+            g_ptr_array_add(done, request);
+            g_array_append_val(results, check);
+            g_array_append_val(codes, msg->data.result);
+        }
+
+        // Fail whatever is left if the multi handle itself broke
+        if (mc != CURLM_OK && done->len == 0) {
+            for (guint i = 0; i < multi->requests->len; i++) {
+                api_result_e check = API_CURL_ERR;
+                CURLcode res = CURLE_FAILED_INIT;
+                g_ptr_array_add(done, multi->requests->pdata[i]);
+                g_array_append_val(results, check);
+                g_array_append_val(codes, res);
+            }
+        }
+
+        for (guint i = 0; i < done->len; i++) {
+            complete(multi, done->pdata[i], g_array_index(codes, CURLcode, i),
+                     g_array_index(results, api_result_e, i));
+        }
+        g_array_free(codes, TRUE);
+        g_array_free(results, TRUE);
+        g_ptr_array_free(done, TRUE);
+    }
+}
+
+extern void api_multi_free(api_multi_t* multi) {
+    if (!multi)
+        return;
+
+    for (guint i = 0; i < multi->requests->len; i++) {
+        api_request_t* request = multi->requests->pdata[i];
+        curl_multi_remove_handle(multi->curlm, request->curl);
+        request_free(request);
+    }
+    g_ptr_array_free(multi->requests, TRUE);
+    curl_multi_cleanup(multi->curlm);
+    curl_slist_free_all(multi->json_headers);
+    curl_slist_free_all(multi->file_headers);
+    g_free(multi);
+}
@@ -0,0 +1,84 @@
+#ifndef API_MULTI_H_
+#define API_MULTI_H_
+
+#include <stddef.h>
+#include "api/internal.h"
+
+/**
+ * @brief A batch of API requests performed concurrently, multiplexed over
+ * as few HTTP/2 connections as possible.
+ */
+typedef struct api_multi api_multi_t;
+
+/**
+ * @brief Completion callback of a request in a batch. Called from
+ * api_multi_wait() on the calling thread.
+ *
+ * @param result The API result code of the request
+ * @param response The response body, or NULL for file downloads. Only valid
+ * during the callback.
+ * @param userdata The user data given with the request
+ */
+typedef void (*api_multi_cb)(api_result_e result,
+                             const response_buf_t* response,
+                             void* userdata);
+
+/**
+ * @brief Create a new batch of authenticated API requests.
+ *
+ * @param result Pointer to store the API result code
+ * @return api_multi_t* The batch, or NULL if not authenticated. Caller must
+ * free with api_multi_free().
+ */
+extern api_multi_t* api_multi_new(api_result_e* result);
+
+/**
+ * @brief Queue a GET request for a JSON API path.
+ *
+ * @param multi The batch
+ * @param cb Called with the response once the request completes
+ * @param userdata User data passed to the callback
+ * @param path_fmt Format string for the API path (e.g. "/torrents/%ld")
+ * @return int 0 if queued, non-zero on error (the callback isn't called)
+ */
+extern int api_multi_get(api_multi_t* multi,
+                         api_multi_cb cb,
+                         void* userdata,
+                         const char* path_fmt,
+                         ...);
+
+/**
+ * @brief Queue a GET request downloading an API path to a file. The file is
+ * only created once the request succeeds, and an interrupted download is
+ * continued by the next one to the same path.
+ *
+ * @param multi The batch
+ * @param output_path The file path to save the download to
+ * @param cb Called once the request completes
+ * @param userdata User data passed to the callback
+ * @param path_fmt Format string for the API path (e.g. "/torrents/%ld/file")
+ * @return int 0 if queued, non-zero on error (the callback isn't called)
+ */
+extern int api_multi_get_file(api_multi_t* multi,
+                              const char* output_path,
+                              api_multi_cb cb,
+                              void* userdata,
+                              const char* path_fmt,
+                              ...);
+
+/**
+ * @brief Perform the queued requests until all of them completed, calling
+ * their callbacks as they do. Callbacks may queue more requests.
+ *
+ * @param multi The batch
+ */
+extern void api_multi_wait(api_multi_t* multi);
+
+/**
+ * @brief Free a batch, dropping any request that wasn't waited for.
+ *
+ * @param multi The batch to free (can be NULL)
+ */
+extern void api_multi_free(api_multi_t* multi);
+
+#endif  // API_MULTI_H_
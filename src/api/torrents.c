@@ -2,43 +2,29 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <json-glib/json-glib.h>
 #include "api/internal.h"
 #include "api/torrents.h"
 
-torrent_dto_t* parse_torrent_json(const char* json_str) {
-    JsonParser* parser = json_parser_new();
-
-    // Load JSON data into parser
-    if (!json_parser_load_from_data(parser, json_str, -1, NULL)) {
-        g_object_unref(parser);
-        return NULL;
-    }
-
-    // Get the root to make sure it's an object
-    JsonNode* root_node = json_parser_get_root(parser);
-    if (!root_node || !JSON_NODE_HOLDS_OBJECT(root_node)) {
-        g_object_unref(parser);
-        return NULL;
-    }
-
-    // Parse JSON object into torrent_dto_t
-    JsonObject* root_obj = json_node_get_object(root_node);
-    torrent_dto_t* dto = g_malloc0(sizeof(torrent_dto_t));
-
+// Copy the members of a torrent object into dto, allocating from the arena
+static void fill_torrent(api_arena_t* arena,
+                         JsonObject* root_obj,
+                         torrent_dto_t* dto) {
     if (json_object_has_member(root_obj, "id"))
         dto->id = json_object_get_int_member(root_obj, "id");
 
     if (json_object_has_member(root_obj, "name"))
-        dto->name = g_strdup(json_object_get_string_member(root_obj, "name"));
+        dto->name = api_arena_strdup(
+            arena, json_object_get_string_member(root_obj, "name"));
 
     if (json_object_has_member(root_obj, "description"))
-        dto->description =
-            g_strdup(json_object_get_string_member(root_obj, "description"));
+        dto->description = api_arena_strdup(
+            arena, json_object_get_string_member(root_obj, "description"));
 
     if (json_object_has_member(root_obj, "repoId"))
-        dto->repo_id =
-            g_strdup(json_object_get_string_member(root_obj, "repoId"));
+        dto->repo_id = api_arena_strdup(
+            arena, json_object_get_string_member(root_obj, "repoId"));
 
     if (json_object_has_member(root_obj, "fileSize"))
         dto->file_size = json_object_get_int_member(root_obj, "fileSize");
@@ -48,21 +34,106 @@ torrent_dto_t* parse_torrent_json(const char* json_str) {
             (int32_t)json_object_get_int_member(root_obj, "uploaderId");
 
     if (json_object_has_member(root_obj, "uploaderUsername"))
-        dto->uploader_username = g_strdup(
-            json_object_get_string_member(root_obj, "uploaderUsername"));
+        dto->uploader_username = api_arena_strdup(
+            arena, json_object_get_string_member(root_obj, "uploaderUsername"));
 
     if (json_object_has_member(root_obj, "createdAt"))
-        dto->created_at =
-            g_strdup(json_object_get_string_member(root_obj, "createdAt"));
+        dto->created_at = api_arena_strdup(
+            arena, json_object_get_string_member(root_obj, "createdAt"));
 
     if (json_object_has_member(root_obj, "updatedAt"))
-        dto->updated_at =
-            g_strdup(json_object_get_string_member(root_obj, "updatedAt"));
+        dto->updated_at = api_arena_strdup(
+            arena, json_object_get_string_member(root_obj, "updatedAt"));
+
+    // Optional list of HTTP mirrors to fall back on when there are no peers
+    JsonNode* web_seeds = json_object_get_member(root_obj, "webSeeds");
+    if (web_seeds && JSON_NODE_HOLDS_ARRAY(web_seeds)) {
+        JsonArray* urls = json_node_get_array(web_seeds);
+        guint len = json_array_get_length(urls);
+        char** seeds = api_arena_alloc(arena, (len + 1) * sizeof(char*));
+        guint n = 0;
+        for (guint i = 0; i < len; i++) {
+            JsonNode* url = json_array_get_element(urls, i);
+            if (JSON_NODE_HOLDS_VALUE(url) &&
+                json_node_get_value_type(url) == G_TYPE_STRING)
+                seeds[n++] =
+                    api_arena_strdup(arena, json_node_get_string(url));
+        }
+        dto->web_seeds = n > 0 ? seeds : NULL;
+    }
+}
+
+// Unescaped strings are never longer than they are in the JSON text,
+// so an arena this big rarely needs a second block
+static size_t arena_size(const char* json_str, size_t count) {
+    return strlen(json_str) + count * sizeof(torrent_dto_t);
+}
+
+torrent_dto_t* parse_torrent_json(const char* json_str) {
+    JsonParser* parser = json_parser_new();
+
+    // Load JSON data into parser
+    if (!json_parser_load_from_data(parser, json_str, -1, NULL)) {
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    // Get the root to make sure it's an object
+    JsonNode* root_node = json_parser_get_root(parser);
+    if (!root_node || !JSON_NODE_HOLDS_OBJECT(root_node)) {
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    // Parse JSON object into torrent_dto_t, which owns the arena it is in
+    api_arena_t* arena = api_arena_new(arena_size(json_str, 1));
+    torrent_dto_t* dto = api_arena_alloc(arena, sizeof(torrent_dto_t));
+    dto->arena = arena;
+    fill_torrent(arena, json_node_get_object(root_node), dto);
 
     g_object_unref(parser);
     return dto;
 }
 
+torrent_list_t* parse_torrent_list_json(const char* json_str) {
+    JsonParser* parser = json_parser_new();
+
+    if (!json_parser_load_from_data(parser, json_str, -1, NULL)) {
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    // Either a plain array or a page of results
+    JsonNode* root_node = json_parser_get_root(parser);
+    if (root_node && JSON_NODE_HOLDS_OBJECT(root_node)) {
+        root_node =
+            json_object_get_member(json_node_get_object(root_node), "content");
+    }
+    if (!root_node || !JSON_NODE_HOLDS_ARRAY(root_node)) {
+        g_object_unref(parser);
+        return NULL;
+    }
+
+    // The list, its torrents and their strings all live in one arena
+    JsonArray* array = json_node_get_array(root_node);
+    guint len = json_array_get_length(array);
+    api_arena_t* arena = api_arena_new(
+        sizeof(torrent_list_t) + arena_size(json_str, len));
+    torrent_list_t* list = api_arena_alloc(arena, sizeof(torrent_list_t));
+    list->arena = arena;
+    list->torrents = api_arena_alloc(arena, len * sizeof(torrent_dto_t));
+    for (guint i = 0; i < len; i++) {
+        JsonNode* element = json_array_get_element(array, i);
+        if (JSON_NODE_HOLDS_OBJECT(element)) {
+            fill_torrent(arena, json_node_get_object(element),
+                         &list->torrents[list->len++]);
+        }
+    }
+
+    g_object_unref(parser);
+    return list;
+}
+
 char* build_update_json(const torrent_update_t* update) {
     JsonBuilder* builder = json_builder_new();
     json_builder_begin_object(builder);
@@ -128,12 +199,15 @@ extern void torrent_dto_free(torrent_dto_t* dto) {
     if (!dto)
         return;
 
-    g_free(dto->name);
-    g_free(dto->description);
-    g_free(dto->uploader_username);
-    g_free(dto->created_at);
-    g_free(dto->updated_at);
-    g_free(dto);
+    // The torrent and its strings are all in its arena
+    api_arena_free(dto->arena);
+}
+
+extern void torrent_list_free(torrent_list_t* list) {
+    if (!list)
+        return;
+
+    api_arena_free(list->arena);
 }
 
 extern torrent_dto_t* api_get_torrent(int64_t torrent_id,
@@ -236,14 +310,8 @@ extern torrent_dto_t* api_get_torrent_by_repo_id(const char* repo_id,
 
     response_buf_t response = response_buf_init();
 
-    // Set curl options and perform request
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-
-    CURLcode res = curl_easy_perform(curl);
-    api_result_e check = api_check_response(curl, res);
+    // Perform the request, revalidating the cached response if there is one
+    api_result_e check = api_cached_get(curl, &headers, url, &response, NULL);
 
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
@@ -266,6 +334,137 @@ extern torrent_dto_t* api_get_torrent_by_repo_id(const char* repo_id,
     return dto;
 }
 
+typedef struct {
+    torrent_dto_cb cb;
+    void* userdata;
+} torrent_request_t;
+
+static void on_torrent(api_result_e result,
+                       const response_buf_t* response,
+                       void* userdata) {
+    torrent_request_t* request = userdata;
+
+    // Parse JSON response into DTO
+    torrent_dto_t* dto = NULL;
+    if (result == API_OK) {
+        dto = parse_torrent_json(response->data);
+        if (!dto)
+            result = API_SERVER_ERR;
+    }
+
+    request->cb(result, dto, request->userdata);
+    g_free(request);
+}
+
+extern int api_multi_get_torrent_by_repo_id(api_multi_t* multi,
+                                            const char* repo_id,
+                                            torrent_dto_cb cb,
+                                            void* userdata) {
+    torrent_request_t* request = g_new0(torrent_request_t, 1);
+    request->cb = cb;
+    request->userdata = userdata;
+
+    // Build the URL: /torrents/repository/{id}
+    int err = api_multi_get(multi, on_torrent, request,
+                            "/torrents/repository/%s", repo_id);
+    if (err)
+        g_free(request);
+
+    return err;
+}
+
+extern int api_multi_get_torrent_file(api_multi_t* multi,
+                                      int64_t torrent_id,
+                                      const char* output_path,
+                                      api_multi_cb cb,
+                                      void* userdata) {
+    // Build the URL: /torrents/{id}/file
+    return api_multi_get_file(multi, output_path, cb, userdata,
+                              "/torrents/%" PRId64 "/file", torrent_id);
+}
+
+// Lookups in flight at once, enough to fill the multiplexed connections
+// without creating a handle for every repository up front
+#define LOOKUP_CHUNK 64
+
+typedef struct {
+    api_multi_t* multi;
+    const char* const* repo_ids;
+    size_t count;
+    size_t next;
+    torrent_lookup_cb cb;
+    void* userdata;
+} lookup_t;
+
+typedef struct {
+    lookup_t* lookup;
+    size_t index;
+} lookup_request_t;
+
+static void on_lookup(api_result_e result,
+                      const response_buf_t* response,
+                      void* userdata);
+
+// Queue the next repository, reporting the ones that can't be queued
+static void lookup_next(lookup_t* lookup) {
+    while (lookup->next < lookup->count) {
+        lookup_request_t* request = g_new0(lookup_request_t, 1);
+        request->lookup = lookup;
+        request->index = lookup->next++;
+        const char* repo_id = lookup->repo_ids[request->index];
+
+        // Build the URL: /torrents/repository/{id}
+        if (!api_multi_get(lookup->multi, on_lookup, request,
+                           "/torrents/repository/%s", repo_id))
+            return;
+
+        g_free(request);
+        lookup->cb(repo_id, API_CURL_ERR, NULL, lookup->userdata);
+    }
+}
+
+static void on_lookup(api_result_e result,
+                      const response_buf_t* response,
+                      void* userdata) {
+    lookup_request_t* request = userdata;
+    lookup_t* lookup = request->lookup;
+
+    // Parse JSON response into DTO
+    torrent_dto_t* dto = NULL;
+    if (result == API_OK) {
+        dto = parse_torrent_json(response->data);
+        if (!dto)
+            result = API_SERVER_ERR;
+    }
+
+    lookup->cb(lookup->repo_ids[request->index], result, dto,
+               lookup->userdata);
+    g_free(request);
+
+    // Each completed lookup makes room for the next one
+    lookup_next(lookup);
+}
+
+extern int api_get_torrents_by_repo_ids(api_multi_t* multi,
+                                        const char* const* repo_ids,
+                                        size_t count,
+                                        torrent_lookup_cb cb,
+                                        void* userdata) {
+    if (!multi)
+        return -1;
+
+    lookup_t lookup = {.multi = multi,
+                       .repo_ids = repo_ids,
+                       .count = count,
+                       .cb = cb,
+                       .userdata = userdata};
+    for (size_t i = 0; i < LOOKUP_CHUNK && lookup.next < count; i++) {
+        lookup_next(&lookup);
+    }
+    api_multi_wait(multi);
+    return 0;
+}
+
 extern torrent_dto_t* api_update_torrent(int64_t torrent_id,
                                          const torrent_update_t* update,
                                          api_result_e* result) {
@@ -390,16 +589,6 @@ extern int api_get_torrent_file(int64_t torrent_id,
         return -1;
     }
 
-    // Open the output file for writing binary
-    FILE* fp = fopen(output_path, "wb");
-    if (!fp) {
-        curl_easy_cleanup(curl);
-        if (result)
-            *result = API_CURL_ERR;
-
-        return -1;
-    }
-
     // Set up headers
     struct curl_slist* headers = NULL;
     headers = curl_slist_append(headers, "Accept: application/x-bittorrent");
@@ -407,36 +596,22 @@ extern int api_get_torrent_file(int64_t torrent_id,
     if (auth_result != API_OK) {
         curl_slist_free_all(headers);
         curl_easy_cleanup(curl);
-        fclose(fp);
         if (result)
             *result = auth_result;
 
         return -1;
     }
 
-    // Set curl options and perform request
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_file_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-
-    CURLcode res = curl_easy_perform(curl);
-    api_result_e check = api_check_response(curl, res);
+    // Perform the request, revalidating the cached file if there is one
+    api_result_e check = api_cached_get(curl, &headers, url, NULL, output_path);
 
     curl_slist_free_all(headers);
     curl_easy_cleanup(curl);
-    fclose(fp);
 
     if (result)
         *result = check;
 
-    // Remove partial file on error
-    if (check != API_OK) {
-        remove(output_path);
-        return -1;
-    }
-
-    return 0;
+    return check == API_OK ? 0 : -1;
 }
 
 extern int api_update_torrent_file(int64_t torrent_id,
@@ -472,7 +647,7 @@ extern int api_update_torrent_file(int64_t torrent_id,
     curl_mime* mime = curl_mime_init(curl);
     curl_mimepart* part = curl_mime_addpart(mime);
     curl_mime_name(part, "file");
-    curl_mime_filedata(part, file_path);
+    api_mime_file(part, file_path);
     curl_mime_type(part, "application/x-bittorrent");
 
     // Set up headers
@@ -554,7 +729,7 @@ extern torrent_dto_t* api_upload_torrent(const torrent_upload_t* upload,
 
     curl_mimepart* file_part = curl_mime_addpart(mime);
     curl_mime_name(file_part, "file");
-    curl_mime_filedata(file_part, upload->file_path);
+    api_mime_file(file_part, upload->file_path);
     curl_mime_type(file_part, "application/x-bittorrent");
 
     // Set up headers and response buffer
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "api/internal.h"
+#include "api/multi.h"
 
 /**
  * @brief Represents a torrent (repository) returned by the API. Maps to
@@ -18,8 +19,23 @@ typedef struct {
     char* uploader_username;
     char* created_at;
     char* updated_at;
+    /// @brief BEP-19 web seed URLs serving the repository, NULL-terminated,
+    /// or NULL if the server has none
+    char** web_seeds;
+    /// @brief Owns the torrent and all its strings, NULL for the torrents of
+    /// a torrent_list_t which owns them instead
+    api_arena_t* arena;
 } torrent_dto_t;
 
+/**
+ * @brief A list of torrents returned by the API, allocated from one arena.
+ */
+typedef struct {
+    torrent_dto_t* torrents;
+    size_t len;
+    api_arena_t* arena;
+} torrent_list_t;
+
 /**
  * @brief Input for updating torrent metadata. Only non-NULL fields are sent.
  */
@@ -49,6 +65,17 @@ typedef struct {
  */
 torrent_dto_t* parse_torrent_json(const char* json_str);
 
+/**
+ * @brief Parse a JSON array of torrents, or a page object holding one in its
+ * "content" member, into a torrent_list_t. Internal function for parsing API
+ * responses.
+ *
+ * @param json_str The JSON string to parse
+ * @return torrent_list_t* The parsed torrents, or NULL on error. Caller must
+ * free with torrent_list_free().
+ */
+torrent_list_t* parse_torrent_list_json(const char* json_str);
+
 /**
  * @brief Serialize a torrent_update_t into a JSON string. Internal function for
  * sending API requests.
@@ -70,12 +97,20 @@ char* build_update_json(const torrent_update_t* update);
 char* build_upload_json(const torrent_upload_t* upload);
 
 /**
- * @brief Free a torrent_dto_t and its internal string fields.
+ * @brief Free a torrent_dto_t and its internal string fields. Does nothing for
+ * a torrent of a torrent_list_t.
  *
  * @param dto The torrent_dto_t to free (can be NULL)
  */
 extern void torrent_dto_free(torrent_dto_t* dto);
 
+/**
+ * @brief Free a torrent_list_t and all of its torrents.
+ *
+ * @param list The torrent_list_t to free (can be NULL)
+ */
+extern void torrent_list_free(torrent_list_t* list);
+
 /**
  * @brief Get torrent metadata by ID. GET /torrents/{id}
  *
@@ -97,6 +132,137 @@ extern torrent_dto_t* api_get_torrent(int64_t torrent_id, api_result_e* result);
  */
 extern torrent_dto_t* api_get_torrent_by_repo_id(const char* repo_id,
                                                  api_result_e* result);
+
+/**
+ * @brief Completion callback of a torrent request in a batch.
+ *
+ * @param result The API result code of the request
+ * @param dto The torrent, or NULL on error. Callee must free with
+ * torrent_dto_free().
+ * @param userdata The user data given with the request
+ */
+typedef void (*torrent_dto_cb)(api_result_e result,
+                               torrent_dto_t* dto,
+                               void* userdata);
+
+/**
+ * @brief Queue getting torrent metadata by the repository ID in a batch.
+ * GET /torrents/repository/{id}
+ *
+ * @param multi The batch to queue the request in
+ * @param repo_id The first commit of the repository hash
+ * @param cb Called with the torrent from api_multi_wait()
+ * @param userdata User data passed to the callback
+ * @return int 0 if queued, non-zero on error (the callback isn't called)
+ */
+extern int api_multi_get_torrent_by_repo_id(api_multi_t* multi,
+                                            const char* repo_id,
+                                            torrent_dto_cb cb,
+                                            void* userdata);
+
+/**
+ * @brief Queue downloading a .torrent file to disk in a batch.
+ * GET /torrents/{id}/file
+ *
+ * @param multi The batch to queue the request in
+ * @param torrent_id The torrent ID whose file to download
+ * @param output_path The file path to save the downloaded .torrent to
+ * @param cb Called once the file is downloaded from api_multi_wait()
+ * @param userdata User data passed to the callback
+ * @return int 0 if queued, non-zero on error (the callback isn't called)
+ */
+extern int api_multi_get_torrent_file(api_multi_t* multi,
+                                      int64_t torrent_id,
+                                      const char* output_path,
+                                      api_multi_cb cb,
+                                      void* userdata);
+
+/**
+ * @brief Result callback of a repository in a batched lookup.
+ *
+ * @param repo_id The repository ID that was looked up
+ * @param result API_OK, API_NOT_FOUND if the server has no such repository, or
+ * another API result code on error
+ * @param dto The torrent, or NULL on error. Callee must free with
+ * torrent_dto_free().
+ * @param userdata The user data given with the lookup
+ */
+typedef void (*torrent_lookup_cb)(const char* repo_id,
+                                  api_result_e result,
+                                  torrent_dto_t* dto,
+                                  void* userdata);
+
+/**
+ * @brief Get the torrent metadata of many repositories. GET
+ * /torrents/repository/{id} for each, multiplexed over a few connections with
+ * a bounded chunk of requests in flight. Results are streamed to the callback
+ * as they arrive, in no particular order. The callback may queue more
+ * requests in the batch, they are waited for as well.
+ *
+ * @param multi The batch to queue the lookups in
+ * @param repo_ids The first commit hashes of the repositories
+ * @param count Number of repository IDs
+ * @param cb Called once for every repository ID
+ * @param userdata User data passed to the callback
+ * @return int 0 once every request of the batch completed, non-zero if there
+ * is no batch (the callback isn't called)
+ */
+extern int api_get_torrents_by_repo_ids(api_multi_t* multi,
+                                        const char* const* repo_ids,
+                                        size_t count,
+                                        torrent_lookup_cb cb,
+                                        void* userdata);
+
+/**
+ * @brief Iterator over the torrents of a listing or search, fetched a page at
+ * a time and read as each page arrives.
+ */
+typedef struct torrent_iter torrent_iter_t;
+
+/**
+ * @brief List every torrent. GET /torrents?page={n}&size={page_size}
+ *
+ * @param page_size Number of torrents to ask for per page, 0 for the default
+ * @param result Pointer to store the API result code
+ * @return torrent_iter_t* The iterator, or NULL on error. Caller must free with
+ * torrent_iter_free().
+ */
+extern torrent_iter_t* api_list_torrents(size_t page_size,
+                                         api_result_e* result);
+
+/**
+ * @brief Search the torrents. GET
+ * /torrents/search?q={query}&page={n}&size={page_size}
+ *
+ * @param query The text to search for
+ * @param page_size Number of torrents to ask for per page, 0 for the default
+ * @param result Pointer to store the API result code
+ * @return torrent_iter_t* The iterator, or NULL on error. Caller must free with
+ * torrent_iter_free().
+ */
+extern torrent_iter_t* api_search_torrents(const char* query,
+                                           size_t page_size,
+                                           api_result_e* result);
+
+/**
+ * @brief Get the next torrent, downloading the next page when needed. Only
+ * the torrent being read is held in memory, however many there are.
+ *
+ * @param iter The iterator
+ * @param result Pointer to store the API result code
+ * @return torrent_dto_t* The next torrent, or NULL once there are no more or
+ * on error. Caller must free with torrent_dto_free().
+ */
+extern torrent_dto_t* torrent_iter_next(torrent_iter_t* iter,
+                                        api_result_e* result);
+
+/**
+ * @brief Free an iterator, dropping the torrents it hasn't handed out.
+ *
+ * @param iter The iterator to free (can be NULL)
+ */
+extern void torrent_iter_free(torrent_iter_t* iter);
+
 /**
  * @brief Update torrent metadata with non-NULL fields. PUT /torrents/{id}
  *
@@ -112,6 +278,9 @@ extern torrent_dto_t* api_update_torrent(int64_t torrent_id,
 
 /**
  * @brief Download a .torrent file to disk. GET /torrents/{id}/file
+ * The file is written next to output_path as output_path.part and renamed
+ * once complete, so output_path is never left half written. An interrupted
+ * download is continued from where it stopped, by this call or the next.
  *
  * @param torrent_id The torrent ID whose file to download
  * @param output_path The file path to save the downloaded .torrent to
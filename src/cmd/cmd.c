@@ -10,6 +10,7 @@
 #include "devs/devs.h"
 #include "init/init.h"
 #include "leech/leech.h"
+#include "list/list.h"
 #include "login/login.h"
 #include "seed/seed.h"
 #include "service/service.h"
@@ -24,6 +25,7 @@ static const char doc[] =
     "\n"
     "  init     Create an empty GitTor repository\n"
     "  leech    Clone a GitTor repository into a new directory\n"
+    "  list     List or search the repositories on the server\n"
     "  login    Authenticate with the GitTor server\n"
     "  seed     Share the current state of the repository\n"
     "  devs     Manage who can contribute to this repository\n"
@@ -67,6 +69,8 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
                 return gittor_init(state);
             } else if (strcmp(arg, "leech") == 0) {
                 return gittor_leech(state);
+            } else if (strcmp(arg, "list") == 0) {
+                return gittor_list(state);
             } else if (strcmp(arg, "seed") == 0) {
                 return gittor_seed(state);
             } else if (strcmp(arg, "login") == 0) {
@@ -1,4 +1,7 @@
+#include <gio/gio.h>
 #include <glib.h>
+#include <string.h>
+#include <glib/gstdio.h>
 #include "config/config.h"
 
 static gchar* local_config_path() {
@@ -14,52 +17,182 @@ extern gchar* global_config_path() {
     return config_path;
 }
 
-extern char* config_get(config_scope_e scope,
-                        const config_id_t* id,
-                        const gchar* default_value) {
-    GError* error = NULL;
-    GKeyFile* keyfile = g_key_file_new();
-    gchar* value = NULL;
+/**
+ * @brief A parsed config file, reused until the file changes
+ */
+typedef struct {
+    /// @brief The parsed file, or NULL if it couldn't be parsed
+    GKeyFile* keyfile;
+    gint64 mtime_ns;
+    goffset size;
+    guint64 inode;
+} snapshot_t;
 
-    // Try local config first
-    if (scope == CONFIG_SCOPE_LOCAL) {
-        gchar* local_path = local_config_path();
-        if (g_file_test(local_path, G_FILE_TEST_EXISTS)) {
-            g_key_file_load_from_file(keyfile, local_path, G_KEY_FILE_NONE,
-                                      &error);
-            if (!error) {
-                value =
-                    g_key_file_get_string(keyfile, id->group, id->key, NULL);
+static GMutex snapshots_lock;
+static GHashTable* snapshots = NULL;  // path -> snapshot_t*
+
+static void snapshot_free(gpointer data) {
+    snapshot_t* snapshot = data;
+    if (snapshot->keyfile) {
+        g_key_file_unref(snapshot->keyfile);
+    }
+    g_free(snapshot);
+}
+
+// Get the parsed contents of a config file, parsing it again only if it was
+// written since. The caller must unref the returned keyfile.
+static GKeyFile* load(const gchar* path) {
+    GStatBuf st;
+    gboolean exists = !g_stat(path, &st);
+
+    g_mutex_lock(&snapshots_lock);
+    if (!snapshots) {
+        snapshots = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          snapshot_free);
+    }
+
+    snapshot_t* snapshot = NULL;
+    if (!exists) {
+        g_hash_table_remove(snapshots, path);
+    } else {
+        // Files are replaced rather than rewritten, so the inode changes too
+        gint64 mtime_ns = (gint64)st.st_mtim.tv_sec * 1000000000 +
+                          st.st_mtim.tv_nsec;
+        snapshot = g_hash_table_lookup(snapshots, path);
+        if (!snapshot || snapshot->mtime_ns != mtime_ns ||
+            snapshot->size != (goffset)st.st_size ||
+            snapshot->inode != (guint64)st.st_ino) {
+            snapshot = g_new0(snapshot_t, 1);
+            snapshot->mtime_ns = mtime_ns;
+            snapshot->size = (goffset)st.st_size;
+            snapshot->inode = (guint64)st.st_ino;
+            snapshot->keyfile = g_key_file_new();
+            if (!g_key_file_load_from_file(snapshot->keyfile, path,
+                                           G_KEY_FILE_NONE, NULL)) {
+                g_clear_pointer(&snapshot->keyfile, g_key_file_unref);
             }
-            g_clear_error(&error);
+            g_hash_table_replace(snapshots, g_strdup(path), snapshot);
         }
+    }
+
+    GKeyFile* keyfile = snapshot && snapshot->keyfile
+                            ? g_key_file_ref(snapshot->keyfile)
+                            : NULL;
+    g_mutex_unlock(&snapshots_lock);
+    return keyfile;
+}
+
+static void invalidate(const gchar* path) {
+    g_mutex_lock(&snapshots_lock);
+    if (snapshots) {
+        g_hash_table_remove(snapshots, path);
+    }
+    g_mutex_unlock(&snapshots_lock);
+}
+
+// Get the files to look a key up in, most specific first
+static GKeyFile** load_scope(config_scope_e scope) {
+    GKeyFile** keyfiles = g_new0(GKeyFile*, 3);
+    int count = 0;
+    if (scope == CONFIG_SCOPE_LOCAL) {
+        gchar* local_path = local_config_path();
+        keyfiles[count] = load(local_path);
+        count += keyfiles[count] ? 1 : 0;
         g_free(local_path);
     }
+    gchar* global_path = global_config_path();
+    keyfiles[count] = load(global_path);
+    g_free(global_path);
+    return keyfiles;
+}
 
-    // If not found, try global config
-    if (!value) {
-        gchar* global_path = global_config_path();
-        if (g_file_test(global_path, G_FILE_TEST_EXISTS)) {
-            g_key_file_load_from_file(keyfile, global_path, G_KEY_FILE_NONE,
-                                      &error);
-            if (!error) {
-                value =
-                    g_key_file_get_string(keyfile, id->group, id->key, NULL);
-            }
-            g_clear_error(&error);
-        }
-        g_free(global_path);
+static void unload_scope(GKeyFile** keyfiles) {
+    for (GKeyFile** it = keyfiles; *it; it++) {
+        g_key_file_unref(*it);
     }
+    g_free(keyfiles);
+}
+
+extern char* config_get(config_scope_e scope,
+                        const config_id_t* id,
+                        const gchar* default_value) {
+    // Try local config first, then global config
+    GKeyFile** keyfiles = load_scope(scope);
+    gchar* value = NULL;
+    for (GKeyFile** it = keyfiles; *it && !value; it++) {
+        value = g_key_file_get_string(*it, id->group, id->key, NULL);
+    }
+    unload_scope(keyfiles);
 
     // If still not found, use default
     if (!value && default_value) {
         value = g_strdup(default_value);
     }
 
-    g_key_file_unref(keyfile);
     return value;
 }
 
+extern gint64 config_get_int(config_scope_e scope,
+                             const config_id_t* id,
+                             gint64 default_value) {
+    char* value = config_get(scope, id, NULL);
+    gint64 number = 0;
+    if (!value || !g_ascii_string_to_signed(g_strstrip(value), 10, G_MININT64,
+                                            G_MAXINT64, &number, NULL)) {
+        number = default_value;
+    }
+    g_free(value);
+    return number;
+}
+
+extern gboolean config_get_bool(config_scope_e scope,
+                                const config_id_t* id,
+                                gboolean default_value) {
+    char* value = config_get(scope, id, NULL);
+    gboolean flag = default_value;
+    if (value) {
+        g_strstrip(value);
+        if (!g_ascii_strcasecmp(value, "true") || !strcmp(value, "1") ||
+            !g_ascii_strcasecmp(value, "yes")) {
+            flag = TRUE;
+        } else if (!g_ascii_strcasecmp(value, "false") ||
+                   !strcmp(value, "0") || !g_ascii_strcasecmp(value, "no")) {
+            flag = FALSE;
+        }
+    }
+    g_free(value);
+    return flag;
+}
+
+extern gchar** config_get_list(config_scope_e scope, const config_id_t* id) {
+    GKeyFile** keyfiles = load_scope(scope);
+    GPtrArray* list = g_ptr_array_new();
+
+    // The first file with the key, or with any numbered key, has the list
+    for (GKeyFile** it = keyfiles; *it && list->len == 0; it++) {
+        gchar** values =
+            g_key_file_get_string_list(*it, id->group, id->key, NULL, NULL);
+        for (gchar** value = values; value && *value; value++) {
+            g_ptr_array_add(list, g_strdup(*value));
+        }
+        g_strfreev(values);
+
+        for (int i = 1;; i++) {
+            gchar* key = g_strdup_printf("%s%d", id->key, i);
+            gchar* value = g_key_file_get_string(*it, id->group, key, NULL);
+            g_free(key);
+            if (!value) {
+                break;
+            }
+            g_ptr_array_add(list, value);
+        }
+    }
+    unload_scope(keyfiles);
+
+    g_ptr_array_add(list, NULL);
+    return (gchar**)g_ptr_array_free(list, FALSE);
+}
+
 extern int config_set(config_scope_e scope,
                       const config_id_t* id,
                       const gchar* value) {
@@ -97,8 +230,88 @@ extern int config_set(config_scope_e scope,
         return -1;
     }
 
+    // Later lookups in this process see the new value even if the file's
+    // timestamp didn't move
+    invalidate(path);
+
     g_free(data);
     g_free(path);
     g_key_file_unref(keyfile);
     return 0;
 }
+
+struct config_watch {
+    GMainContext* context;
+    GFileMonitor* monitor;
+    gboolean changed;
+};
+
+static void on_config_changed(GFileMonitor* monitor,
+                              GFile* file,
+                              GFile* other_file,
+                              GFileMonitorEvent event,
+                              gpointer data) {
+    (void)monitor;
+    (void)file;
+    (void)other_file;
+    config_watch_t* watch = data;
+    if (event != G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED &&
+        event != G_FILE_MONITOR_EVENT_PRE_UNMOUNT &&
+        event != G_FILE_MONITOR_EVENT_UNMOUNTED) {
+        watch->changed = TRUE;
+    }
+}
+
+extern config_watch_t* config_watch_new(const gchar* path) {
+    config_watch_t* watch = g_new0(config_watch_t, 1);
+    watch->context = g_main_context_new();
+
+    // Events are dispatched to the context the monitor was created in, which
+    // is only run by config_watch_changed()
+    GError* error = NULL;
+    GFile* file = g_file_new_for_path(path);
+    g_main_context_push_thread_default(watch->context);
+    watch->monitor =
+        g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, &error);
+    g_main_context_pop_thread_default(watch->context);
+    g_object_unref(file);
+
+    if (error) {
+        g_printerr("Error watching config file: %s\n", error->message);
+        g_clear_error(&error);
+        config_watch_free(watch);
+        return NULL;
+    }
+
+    g_signal_connect(watch->monitor, "changed",
+                     G_CALLBACK(on_config_changed), watch);
+    return watch;
+}
+
+extern gboolean config_watch_changed(config_watch_t* watch) {
+    if (!watch)
+        return FALSE;
+
+    while (g_main_context_iteration(watch->context, FALSE)) {
+        // Dispatch every pending event
+    }
+
+    gboolean changed = watch->changed;
+    watch->changed = FALSE;
+    return changed;
+}
+
+extern void config_watch_free(config_watch_t* watch) {
+    if (!watch)
+        return;
+
+    if (watch->monitor) {
+        g_file_monitor_cancel(watch->monitor);
+        g_object_unref(watch->monitor);
+    }
+    while (g_main_context_iteration(watch->context, FALSE)) {
+        // Drop the events still pending
+    }
+    g_main_context_unref(watch->context);
+    g_free(watch);
+}
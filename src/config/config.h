@@ -31,7 +31,9 @@ extern gchar* global_config_path();
 extern int gittor_config(struct argp_state* state);
 
 /**
- * @brief Gets a configuration value.
+ * @brief Gets a configuration value. Config files are parsed once per process
+ * and parsed again only once they change, so lookups are cheap and safe from
+ * any thread.
  *
  * @param scope The configuration scope (global or local)
  * @param id The configuration identifier
@@ -42,6 +44,44 @@ extern char* config_get(config_scope_e scope,
                         const config_id_t* id,
                         const gchar* default_value);
 
+/**
+ * @brief Gets a configuration value as an integer.
+ *
+ * @param scope The configuration scope (global or local)
+ * @param id The configuration identifier
+ * @param default_value The value if the key is not found or not a number
+ * @return gint64 The configuration value
+ */
+extern gint64 config_get_int(config_scope_e scope,
+                             const config_id_t* id,
+                             gint64 default_value);
+
+/**
+ * @brief Gets a configuration value as a boolean, given as true/false, yes/no
+ * or 1/0.
+ *
+ * @param scope The configuration scope (global or local)
+ * @param id The configuration identifier
+ * @param default_value The value if the key is not found or not a boolean
+ * @return gboolean The configuration value
+ */
+extern gboolean config_get_bool(config_scope_e scope,
+                                const config_id_t* id,
+                                gboolean default_value);
+
+/**
+ * @brief Gets a list of configuration values. A list is either the key with
+ * its values separated by ';', or numbered keys such as tracker1, tracker2...
+ * for the key tracker, or both. The most specific file with any of them has
+ * the list.
+ *
+ * @param scope The configuration scope (global or local)
+ * @param id The configuration identifier
+ * @return gchar** The values, NULL-terminated and empty if there are none
+ * (must be freed by the caller with g_strfreev)
+ */
+extern gchar** config_get_list(config_scope_e scope, const config_id_t* id);
+
 /**
  * @brief Sets a configuration value.
  *
@@ -54,4 +94,33 @@ extern int config_set(config_scope_e scope,
                       const config_id_t* id,
                       const gchar* value);
 
+/// @brief Watch over a config file, to apply its changes while running
+typedef struct config_watch config_watch_t;
+
+/**
+ * @brief Start watching a config file for changes. The file doesn't need to
+ * exist yet.
+ *
+ * @param path The config file to watch, e.g. from global_config_path()
+ * @return config_watch_t* The watch, or NULL if the file can't be watched.
+ * Caller must free with config_watch_free().
+ */
+extern config_watch_t* config_watch_new(const gchar* path);
+
+/**
+ * @brief Check whether the watched file was written, created or deleted since
+ * the last check. Doesn't block, call it periodically from a single thread.
+ *
+ * @param watch The watch (can be NULL)
+ * @return gboolean TRUE if the file changed
+ */
+extern gboolean config_watch_changed(config_watch_t* watch);
+
+/**
+ * @brief Stop watching a config file.
+ *
+ * @param watch The watch to free (can be NULL)
+ */
+extern void config_watch_free(config_watch_t* watch);
+
 #endif  // CONFIG_CONFIG_H_
@@ -14,14 +14,10 @@
  * @return int error code
  */
 static int repo_config(git_repository* repo) {
-    int error = 0;
     git_config* cfg = NULL;
 
     // Initialize libgit2
-    int ret = git_libgit2_init();
-    if (ret < 0) {
-        error = ret;
-    }
+    int error = gittor_libgit2_init();
 
     // Open the configurations file
     if (!error) {
@@ -39,11 +35,11 @@ static int repo_config(git_repository* repo) {
     }
 
     git_config_free(cfg);
-    git_libgit2_shutdown();
     return error;
 }
 
-extern int create_bare_repo(char url[FILE_URL_MAX]) {
+extern int create_bare_repo(char url[FILE_URL_MAX],
+                            char repo_id[REPO_ID_MAX]) {
     int error = 0;
     const git_error* e = NULL;
     git_treebuilder* builder = NULL;
@@ -68,9 +64,8 @@ extern int create_bare_repo(char url[FILE_URL_MAX]) {
     }
 
     // Initialize libgit2
-    int ret = git_libgit2_init();
-    if (ret < 0) {
-        error = ret;
+    if (!error) {
+        error = gittor_libgit2_init();
     }
 
     // Initialize a new bare repo
@@ -107,14 +102,20 @@ extern int create_bare_repo(char url[FILE_URL_MAX]) {
         error = git_commit_create(&commit_oid, repo, "HEAD", me, me, "UTF-8",
                                   "init", tree, 0, NULL);
     }
-    char repo_id_str[GIT_OID_HEXSZ + 1] = {0};
-    git_oid_tostr(repo_id_str, sizeof(repo_id_str), &commit_oid);
+    if (!error) {
+        git_oid_tostr(repo_id, REPO_ID_MAX, &commit_oid);
+    }
 
     // Configure repo
     if (!error) {
         error = repo_config(repo);
     }
 
+    // Record its ID, which leechers receive along with the repository
+    if (!error) {
+        error = gittor_set_repo_id(repo, repo_id);
+    }
+
     // Close the repository
     git_repository_free(repo);
     git_treebuilder_free(builder);
@@ -124,7 +125,7 @@ extern int create_bare_repo(char url[FILE_URL_MAX]) {
     if (!error) {
         // Build the permanent path to the repo
         gchar remote_path[PATH_MAX];
-        gittor_remote_path(remote_path, repo_id_str);
+        gittor_remote_path(remote_path, repo_id);
 
         // Move repo to permanent path
         if (g_rename(tmp_remote_path, remote_path)) {
@@ -141,24 +142,30 @@ extern int create_bare_repo(char url[FILE_URL_MAX]) {
     }
 
     free(tmp_remote_path);
-    git_libgit2_shutdown();
     return error;
 }
 
-extern int clone_bare_repo(char url[FILE_URL_MAX], char path[PATH_MAX]) {
-    int error = 0;
+extern int clone_bare_repo(char url[FILE_URL_MAX],
+                           char path[PATH_MAX],
+                           const char* repo_id) {
     const git_error* e = NULL;
     git_repository* repo = NULL;
 
     // Initialize libgit2
-    int ret = git_libgit2_init();
-    if (ret < 0) {
-        error = ret;
-    }
+    int error = gittor_libgit2_init();
 
-    // Clone bare repository
+    // Clone bare repository, hardlinking its objects even from a file:// URL
+    git_clone_options opts;
+    if (!error) {
+        error = git_clone_options_init(&opts, GIT_CLONE_OPTIONS_VERSION);
+    }
+    if (!error) {
+        opts.local = GIT_CLONE_LOCAL;
+        opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_NONE;
+        error = git_clone(&repo, url, path, &opts);
+    }
     if (!error) {
-        error = git_clone(&repo, url, path, NULL);
+        error = gittor_git_checkout(repo);
     }
 
     // Configure repo
@@ -166,12 +173,16 @@ extern int clone_bare_repo(char url[FILE_URL_MAX], char path[PATH_MAX]) {
         error = repo_config(repo);
     }
 
+    // Record its ID, which the clone's config doesn't carry over
+    if (!error) {
+        error = gittor_set_repo_id(repo, repo_id);
+    }
+
     if (error < 0) {
         e = git_error_last();
         printf("Error %d/%d: %s\n", error, e->klass, e->message);
     }
 
     git_repository_free(repo);
-    git_libgit2_shutdown();
     return error;
 }
@@ -2,8 +2,10 @@
 #define INIT_INIT_H_
 
 #include <argp.h>
+#include <git2.h>
 
 #define FILE_URL_MAX (PATH_MAX + 7)
+#define REPO_ID_MAX (GIT_OID_HEXSZ + 1)
 
 /**
  * @brief Runs the init subcommand.
@@ -17,17 +19,21 @@ extern int gittor_init(struct argp_state* state);
  * @brief Create a bare repository.
  *
  * @param url Buffer of FILE_URL_MAX size to output the repository URL
+ * @param repo_id Buffer of REPO_ID_MAX size to output the repository ID
  * @return int error code
  */
-extern int create_bare_repo(char url[FILE_URL_MAX]);
+extern int create_bare_repo(char url[FILE_URL_MAX], char repo_id[REPO_ID_MAX]);
 
 /**
  * @brief Clone bare repository to local path.
  *
  * @param url URL to the bare repository
  * @param path Local path to the clone location
+ * @param repo_id ID of the bare repository, to record in the clone
  * @return int error code
  */
-extern int clone_bare_repo(char url[FILE_URL_MAX], char path[PATH_MAX]);
+extern int clone_bare_repo(char url[FILE_URL_MAX],
+                           char path[PATH_MAX],
+                           const char* repo_id);
 
 #endif  // INIT_INIT_H_
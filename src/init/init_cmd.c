@@ -78,14 +78,15 @@ extern int gittor_init(struct argp_state* state) {
 
     // Create bare repository
     char bare_repo[FILE_URL_MAX];
+    char repo_id[REPO_ID_MAX];
     if (!err && !helped) {
-        err = create_bare_repo(bare_repo);
+        err = create_bare_repo(bare_repo, repo_id);
     }
 
     // Clone bare repository
     gchar* path = g_build_filename(args.global->path, args.dir, NULL);
     if (!err && !helped) {
-        err = clone_bare_repo(bare_repo, path);
+        err = clone_bare_repo(bare_repo, path, repo_id);
     }
     free(path);
 
@@ -1,9 +1,16 @@
+#include <algorithm>
 #include <cctype>
 #include <chrono>
 #include <csignal>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
+#include <future>
+#include <gio/gio.h>  // NOLINT(build/include_order)
 #include <glib.h>  // NOLINT(build/include_order)
+#include <glib/gstdio.h>  // NOLINT(build/include_order)
 #include <iostream>
+#include <map>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -13,16 +20,21 @@
 #include <libtorrent/alert_types.hpp>
 #include <libtorrent/bdecode.hpp>
 #include <libtorrent/bencode.hpp>
+#include <libtorrent/bitfield.hpp>
 #include <libtorrent/create_torrent.hpp>
+#include <libtorrent/download_priority.hpp>
 #include <libtorrent/entry.hpp>
 #include <libtorrent/error_code.hpp>
 #include <libtorrent/file_storage.hpp>
+#include <libtorrent/hasher.hpp>
 #include <libtorrent/load_torrent.hpp>
 #include <libtorrent/magnet_uri.hpp>
 #include <libtorrent/read_resume_data.hpp>
 #include <libtorrent/session.hpp>
 #include <libtorrent/session_params.hpp>
+#include <libtorrent/sha1_hash.hpp>
 #include <libtorrent/span.hpp>
+#include <libtorrent/torrent_flags.hpp>
 #include <libtorrent/torrent_handle.hpp>
 #include <libtorrent/torrent_info.hpp>
 #include <libtorrent/torrent_status.hpp>
@@ -30,12 +42,15 @@
 
 extern "C" {
 #include "api/torrents.h"
-#include "config/config.h"
 #include "leech/leech.h"  // IWYU pragma: keep
 #include "leech/leech_internal.h"
 #include "seed/seed.h"
 #include "utils/utils.h"
+#include "verify/verify.h"
 }
+#include "leech/leech_torrent.h"
+#include "utils/mapped_file.h"
+#include "utils/session.h"
 
 namespace {
 
@@ -68,12 +83,6 @@ char const* state(lt::torrent_status::state_t s) {
 #endif
 }
 
-std::vector<char> load_file(char const* filename) {
-    std::ifstream ifs(filename, std::ios_base::binary);
-    ifs.unsetf(std::ios_base::skipws);
-    return {std::istream_iterator<char>(ifs), std::istream_iterator<char>()};
-}
-
 // set when we're exiting
 std::atomic<bool> shut_down{false};
 
@@ -123,10 +132,352 @@ void write_torrent_file(const std::string& path,
     of.write(data.data(), static_cast<int>(data.size()));
 }
 
+// create the leeching session, picking up the state saved by the last leech
+// of the repository at the given path
+std::unique_ptr<lt::session> make_session(const std::string& repo_path) {
+    lt::session_params params;
+    {
+        const mapped_file session_file =
+            map_file((repo_path + ".session").c_str());
+        if (session_file) {
+            params = lt::read_session_params(file_span(session_file));
+        }
+    }
+    params.settings.set_int(lt::settings_pack::alert_mask,
+                            lt::alert_category::error |
+                                lt::alert_category::storage |
+                                lt::alert_category::status);
+
+    // Set up network
+    gittor_network_settings(params.settings);
+
+    auto ses = std::make_unique<lt::session>(std::move(params));
+    gittor_network_session(*ses);
+    return ses;
+}
+
+// the pieces a partial leech wants, driven by a leech_partial_plan_t
+struct partial_leech {
+    std::shared_ptr<const lt::torrent_info> ti;
+    std::map<std::string, lt::file_index_t> files;
+    std::vector<bool> have;
+    std::vector<lt::download_priority_t> priorities;
+    bool changed = false;
+    leech_partial_plan_t* plan = nullptr;
+
+    partial_leech() = default;
+    partial_leech(const partial_leech&) = delete;
+    partial_leech& operator=(const partial_leech&) = delete;
+    ~partial_leech() { leech_partial_plan_free(plan); }
+};
+
+// path of a file relative to the repository, without the torrent's root
+std::string repo_relative_path(const lt::file_storage& fs,
+                               lt::file_index_t i) {
+    std::string path = fs.file_path(i);
+    for (char& c : path) {
+        if (c == '\\')
+            c = '/';
+    }
+    const std::size_t root = path.find('/');
+    return root == std::string::npos ? path : path.substr(root + 1);
+}
+
+// whether a repository path is a loose object, objects/xx/yyyy...
+bool is_loose_object(const std::string& path) {
+    const std::string prefix = "objects/";
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           path.size() > prefix.size() + 3 &&
+           std::isxdigit(static_cast<unsigned char>(path[prefix.size()])) &&
+           std::isxdigit(static_cast<unsigned char>(path[prefix.size() + 1])) &&
+           path[prefix.size() + 2] == '/';
+}
+
+// whether a repository path is a pack file
+bool is_pack(const std::string& path) {
+    const std::string prefix = "objects/pack/";
+    const std::string suffix = ".pack";
+    return path.compare(0, prefix.size(), prefix) == 0 &&
+           path.size() > prefix.size() + suffix.size() &&
+           path.compare(path.size() - suffix.size(), suffix.size(), suffix) ==
+               0;
+}
+
+// hand a completed file of the repository to the verification
+void verify_file(verify_t* verify,
+                 const lt::file_storage& fs,
+                 lt::file_index_t i,
+                 const std::string& save_path) {
+    const std::string path = repo_relative_path(fs, i);
+    if (is_pack(path))
+        verify_queue_pack(verify, fs.file_path(i, save_path).c_str());
+    else if (is_loose_object(path))
+        verify_queue_loose(verify, fs.file_path(i, save_path).c_str());
+}
+
+void want_piece(partial_leech& p,
+                lt::piece_index_t piece,
+                lt::download_priority_t priority) {
+    lt::download_priority_t& current =
+        p.priorities[static_cast<std::size_t>(static_cast<int>(piece))];
+    if (current < priority) {
+        current = priority;
+        p.changed = true;
+    }
+}
+
+// start by fetching everything but the objects, plus the header and trailer
+// of each pack so libgit2 can open them
+void partial_leech_start(partial_leech& p,
+                         std::shared_ptr<const lt::torrent_info> ti) {
+    p.ti = std::move(ti);
+    const lt::file_storage& fs = p.ti->files();
+    p.have.assign(static_cast<std::size_t>(fs.num_pieces()), false);
+    p.priorities.assign(static_cast<std::size_t>(fs.num_pieces()),
+                        lt::dont_download);
+
+    for (const lt::file_index_t i : fs.file_range()) {
+        if (fs.pad_file_at(i) || fs.file_size(i) == 0)
+            continue;
+
+        const std::string path = repo_relative_path(fs, i);
+        p.files.emplace(path, i);
+
+        const lt::piece_index_t first = fs.map_file(i, 0, 1).piece;
+        const lt::piece_index_t last =
+            fs.map_file(i, fs.file_size(i) - 1, 1).piece;
+        if (is_pack(path)) {
+            want_piece(p, first, lt::top_priority);
+            want_piece(p, last, lt::top_priority);
+        } else if (!is_loose_object(path)) {
+            for (lt::piece_index_t j = first; j <= last; ++j)
+                want_piece(p, j, lt::default_priority);
+        }
+    }
+}
+
+// leech_partial_range_cb backed by the torrent's pieces
+int partial_leech_range(const char* path,
+                        std::uint64_t offset,
+                        std::uint64_t length,
+                        void* payload) {
+    partial_leech& p = *static_cast<partial_leech*>(payload);
+    const auto it = p.files.find(path);
+    if (it == p.files.end())
+        return -1;
+
+    const lt::file_storage& fs = p.ti->files();
+    const auto size = static_cast<std::uint64_t>(fs.file_size(it->second));
+    if (offset >= size)
+        return -1;
+    length = std::min(length, size - offset);
+
+    const lt::piece_index_t first =
+        fs.map_file(it->second, static_cast<std::int64_t>(offset), 1).piece;
+    const lt::piece_index_t last =
+        fs.map_file(it->second, static_cast<std::int64_t>(offset + length - 1),
+                    1)
+            .piece;
+
+    bool ready = true;
+    for (lt::piece_index_t i = first; i <= last; ++i) {
+        if (!p.have[static_cast<std::size_t>(static_cast<int>(i))]) {
+            want_piece(p, i, lt::top_priority);
+            ready = false;
+        }
+    }
+    return ready ? 1 : 0;
+}
+
+// whether the pieces a file of the torrent lies in hash on disk, reading the
+// other files they span too. v2 only torrents have no piece hashes to go by
+bool file_hashes(const lt::torrent_info& ti,
+                 lt::file_index_t file,
+                 const std::string& save_path) {
+    if (!ti.v1())
+        return false;
+
+    const lt::file_storage& fs = ti.files();
+    const lt::piece_index_t first = fs.map_file(file, 0, 1).piece;
+    const lt::piece_index_t last =
+        fs.map_file(file, fs.file_size(file) - 1, 1).piece;
+    std::vector<char> buffer;
+    for (lt::piece_index_t p = first; p <= last; ++p) {
+        const int size = fs.piece_size(p);
+        buffer.assign(static_cast<std::size_t>(size), 0);
+        std::int64_t offset = 0;
+        for (const lt::file_slice& slice : fs.map_block(p, 0, size)) {
+            // Padding is all zeros and never on disk
+            if (!fs.pad_file_at(slice.file_index)) {
+                std::ifstream in(fs.file_path(slice.file_index, save_path),
+                                 std::ios_base::binary);
+                in.seekg(slice.offset);
+                in.read(buffer.data() + offset, slice.size);
+                if (!in)
+                    return false;
+            }
+            offset += slice.size;
+        }
+        if (lt::hasher(buffer.data(), size).final() != ti.hash_for_piece(p))
+            return false;
+    }
+    return true;
+}
+
 }  // namespace
 
+std::shared_ptr<const lt::torrent_info> leech_load_resume(
+    lt::add_torrent_params& atp,
+    const std::string& resume_path,
+    bool partial) {
+    const mapped_file resume_file = map_file(resume_path.c_str());
+    if (!resume_file) {
+        return nullptr;
+    }
+
+    lt::add_torrent_params atp_partial =
+        lt::read_resume_data(file_span(resume_file));
+    if (atp_partial.info_hashes != atp.info_hashes) {
+        return std::move(atp_partial.ti);
+    }
+
+    // Pieces an earlier partial leech skipped are wanted by a full one
+    atp = std::move(atp_partial);
+    if (!partial) {
+        atp.piece_priorities.clear();
+    }
+    return nullptr;
+}
+
+// with v2 torrents a file of the previous version with the same merkle root
+// is reused whatever its path; otherwise objects are taken from a clone's git
+// directory, which are named after their content. the check rejects anything
+// that doesn't hash, so copies are never trusted
+std::int64_t leech_reuse_local_files(
+    const lt::add_torrent_params& atp,
+    const std::shared_ptr<const lt::torrent_info>& previous,
+    const char* reuse_path) {
+    // Resumed torrents already know what they have
+    if (!atp.ti || !atp.have_pieces.empty()) {
+        return 0;
+    }
+
+    const lt::torrent_info& ti = *atp.ti;
+    const std::string& save_path = atp.save_path;
+    std::map<lt::sha256_hash, std::string> previous_roots;
+    if (previous && previous->v2() && ti.v2()) {
+        const lt::file_storage& pfs = previous->files();
+        for (const lt::file_index_t i : pfs.file_range()) {
+            if (!pfs.pad_file_at(i) && !pfs.root(i).is_all_zeros())
+                previous_roots.emplace(pfs.root(i),
+                                       pfs.file_path(i, save_path));
+        }
+    }
+
+    const lt::file_storage& fs = ti.files();
+    std::int64_t reused = 0;
+    for (const lt::file_index_t i : fs.file_range()) {
+        if (fs.pad_file_at(i) || fs.file_size(i) == 0)
+            continue;
+
+        const std::string target = fs.file_path(i, save_path);
+        GStatBuf st;
+        if (g_stat(target.c_str(), &st) == 0 && st.st_size == fs.file_size(i))
+            continue;
+
+        std::vector<std::string> sources;
+        if (!previous_roots.empty()) {
+            const auto it = previous_roots.find(fs.root(i));
+            if (it != previous_roots.end() && it->second != target)
+                sources.push_back(it->second);
+        }
+        const std::string path = repo_relative_path(fs, i);
+        if (reuse_path && path.compare(0, 8, "objects/") == 0)
+            sources.push_back(std::string(reuse_path) + "/" + path);
+
+        for (const std::string& source : sources) {
+            if (g_stat(source.c_str(), &st) != 0 ||
+                st.st_size != fs.file_size(i))
+                continue;
+
+            gchar* parent = g_path_get_dirname(target.c_str());
+            g_mkdir_with_parents(parent, 0755);
+            g_free(parent);
+
+            GFile* from = g_file_new_for_path(source.c_str());
+            GFile* to = g_file_new_for_path(target.c_str());
+            const gboolean copied =
+                g_file_copy(from, to, G_FILE_COPY_OVERWRITE, nullptr, nullptr,
+                            nullptr, nullptr);
+            g_object_unref(from);
+            g_object_unref(to);
+            if (copied) {
+                reused += fs.file_size(i);
+                break;
+            }
+        }
+    }
+
+    if (reused > 0) {
+        std::cout << "Reusing " << (reused / 1000)
+                  << " kB already on disk, checking it against the torrent\n";
+    }
+    return reused;
+}
+
+// libtorrent only writes the pieces it doesn't have, so a file linked to
+// other copies that is already complete is left as is
+int leech_unshare_written_files(const lt::add_torrent_params& atp,
+                                const std::string& repo_path) {
+    // Without metadata there is no telling which files are complete
+    if (!atp.ti) {
+        return gittor_unshare_files(repo_path.c_str());
+    }
+    if (atp.flags & lt::torrent_flags::seed_mode) {
+        return 0;
+    }
+
+    const lt::file_storage& fs = atp.ti->files();
+    const bool resumed = !atp.have_pieces.empty();
+    int copied = 0;
+    for (const lt::file_index_t i : fs.file_range()) {
+        if (fs.pad_file_at(i) || fs.file_size(i) == 0)
+            continue;
+
+        const std::string path = fs.file_path(i, atp.save_path);
+        GStatBuf st;
+        if (g_lstat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ||
+            st.st_nlink < 2)
+            continue;
+
+        // Resume data says which pieces are in, otherwise they are hashed
+        // as the initial check would
+        bool complete = st.st_size == fs.file_size(i);
+        if (complete && resumed) {
+            const lt::piece_index_t first = fs.map_file(i, 0, 1).piece;
+            const lt::piece_index_t last =
+                fs.map_file(i, fs.file_size(i) - 1, 1).piece;
+            for (lt::piece_index_t p = first; complete && p <= last; ++p) {
+                complete = static_cast<int>(p) < atp.have_pieces.size() &&
+                           atp.have_pieces.get_bit(p);
+            }
+        } else if (complete) {
+            complete = file_hashes(*atp.ti, i, atp.save_path);
+        }
+
+        if (!complete) {
+            const int one = gittor_unshare_file(path.c_str());
+            if (one < 0)
+                return one;
+            copied += one;
+        }
+    }
+    return copied;
+}
+
 extern "C" int leech_repository(const char* key,
                                 key_type_e type,
+                                const leech_options_t* options,
                                 char* output_path,
                                 size_t output_path_size) try {
     std::string dir = gittor_remote_dir();
@@ -136,13 +487,29 @@ extern "C" int leech_repository(const char* key,
     if (!dir.empty() && dir.back() != '/') {
         dir.push_back('/');
     }
+    const clk::time_point start = clk::now();
     std::string torrent_file_path;
+    std::vector<char> torrent_buf;
+    std::vector<std::string> web_seeds;
     bool should_write_torrent_file = false;
 
+    // Bootstrapping the session only needs the torrent's name, so it runs
+    // in the background while the torrent is fetched
+    std::string torrent_name;
+    std::future<std::unique_ptr<lt::session>> session_ready;
+    const auto start_session = [&](const std::string& name) {
+        session_ready =
+            std::async(std::launch::async, make_session, dir + name);
+    };
+
     // Load the torrent
     lt::add_torrent_params atp;
     switch (type) {
         case REPO_ID: {
+            // Repositories are named after their ID
+            torrent_name = sanitize_file_name(key);
+            start_session(torrent_name);
+
             api_result_e result = API_OK;
             torrent_dto_t* torrent = api_get_torrent_by_repo_id(key, &result);
             if (!torrent) {
@@ -150,15 +517,28 @@ extern "C" int leech_repository(const char* key,
                     "Failed to fetch torrent by repository id");
             }
 
-            torrent_file_path = dir + key + std::string(".torrent");
-            if (api_get_torrent_file(torrent->id, torrent_file_path.c_str(),
+            // Download next to the seeder's .torrent, which it still uses
+            const std::string download_path =
+                dir + torrent_name + ".torrent.download";
+            if (api_get_torrent_file(torrent->id, download_path.c_str(),
                                      &result) != 0) {
                 torrent_dto_free(torrent);
                 throw std::runtime_error("Failed to download torrent file");
             }
 
+            for (char** url = torrent->web_seeds; url && *url; url++)
+                web_seeds.emplace_back(*url);
             torrent_dto_free(torrent);
-            atp = lt::load_torrent_file(torrent_file_path);
+
+            // Keep the raw bytes to write the .torrent once seeding stopped
+            {
+                const mapped_file torrent_file =
+                    map_file(download_path.c_str());
+                const lt::span<const char> b = file_span(torrent_file);
+                torrent_buf.assign(b.begin(), b.end());
+            }
+            std::remove(download_path.c_str());
+            atp = lt::load_torrent_buffer(torrent_buf);
             break;
         }
         case MAGNET_LINK:
@@ -173,19 +553,32 @@ extern "C" int leech_repository(const char* key,
             throw std::logic_error("Unknown key type");
     }
 
-    // Get the torrent name
-    std::string torrent_name;
-    if (atp.ti) {
-        torrent_name = atp.ti->name();
-    } else {
-        torrent_name = atp.name;
-    }
+    // Get the torrent name and sanitize it to name files off of
+    const std::string name =
+        sanitize_file_name(atp.ti ? atp.ti->name() : atp.name);
 
-    // Sanitize it to name files off of
-    torrent_name = sanitize_file_name(torrent_name);
+    // Start over if the session was bootstrapped for another name
+    if (name != torrent_name || !session_ready.valid()) {
+        if (session_ready.valid()) {
+            session_ready.get();
+        }
+        torrent_name = name;
+        start_session(torrent_name);
+    }
 
+    // Only stop the seeder once the torrent to replace its own is in hand,
+    // so a failed fetch leaves it seeding
     gittor_seed_stop(torrent_name.c_str());
 
+    // Stopping the seeder removes its .torrent, so write the exact one we
+    // downloaded for the seeder to pick up once the leech is done
+    if (!torrent_buf.empty()) {
+        torrent_file_path = dir + torrent_name + ".torrent";
+        std::ofstream of(torrent_file_path, std::ios_base::binary);
+        of.write(torrent_buf.data(),
+                 static_cast<std::streamsize>(torrent_buf.size()));
+    }
+
     if (should_write_torrent_file) {
         torrent_file_path = dir + torrent_name + ".torrent";
         if (atp.ti) {
@@ -194,40 +587,60 @@ extern "C" int leech_repository(const char* key,
         }
     }
 
-    // load session parameters
-    std::vector<char> session_params =
-        load_file((dir + torrent_name + ".session").c_str());
-    lt::session_params params = session_params.empty()
-                                    ? lt::session_params()
-                                    : lt::read_session_params(session_params);
-    params.settings.set_int(lt::settings_pack::alert_mask,
-                            lt::alert_category::error |
-                                lt::alert_category::storage |
-                                lt::alert_category::status);
-
-    // Set up network
-    const config_id_t port_config = {.group = "network", .key = "port"};
-    char* port_str = config_get(CONFIG_SCOPE_GLOBAL, &port_config, NULL);
-    if (port_str != NULL) {
-        const std::string listen_interfaces =
-            std::string("0.0.0.0:") + port_str;
-        params.settings.set_str(lt::settings_pack::listen_interfaces,
-                                listen_interfaces);
-        free(port_str);
+    const std::unique_ptr<lt::session> session = session_ready.get();
+    lt::session& ses = *session;
+
+    // Completed files are verified while the rest is still downloading
+    verify_t* const verify = options ? options->verify : nullptr;
+    if (verify) {
+        lt::settings_pack pack;
+        pack.set_int(lt::settings_pack::alert_mask,
+                     lt::alert_category::error | lt::alert_category::storage |
+                         lt::alert_category::status |
+                         lt::alert_category::file_progress);
+        ses.apply_settings(std::move(pack));
     }
-
-    lt::session ses(params);
     clk::time_point last_save_resume = clk::now();
 
     // load resume data from disk and pass it in as we add the magnet link
-    std::vector<char> buf = load_file((dir + torrent_name + ".resume").c_str());
+    const std::shared_ptr<const lt::torrent_info> previous = leech_load_resume(
+        atp, dir + torrent_name + ".resume", leech_is_partial(options));
+    atp.save_path = dir;
 
-    if (buf.size()) {
-        lt::add_torrent_params atp_partial = lt::read_resume_data(buf);
-        if (atp_partial.info_hashes == atp.info_hashes)
-            atp = std::move(atp_partial);
+    // HTTP mirrors from the server let the download start before any peers
+    // show up, pieces then come from whichever source is faster
+    for (const std::string& url : web_seeds) {
+        if (std::find(atp.url_seeds.begin(), atp.url_seeds.end(), url) ==
+            atp.url_seeds.end())
+            atp.url_seeds.push_back(url);
+    }
+
+    // A new version of the repository mostly holds the same objects as the
+    // last one, only fetch what isn't already on disk somewhere
+    leech_reuse_local_files(atp, previous,
+                            options ? options->reuse_path : nullptr);
+
+    // A partial leech starts out with only the repository's metadata wanted
+    partial_leech partial;
+    if (leech_is_partial(options)) {
+        partial.plan = leech_partial_plan_new((dir + torrent_name).c_str(),
+                                              options, &partial_leech_range,
+                                              &partial);
+        if (atp.ti) {
+            partial_leech_start(partial, atp.ti);
+            atp.piece_priorities = partial.priorities;
+            partial.changed = false;
+        }
+    }
+
+    // libtorrent writes pieces into the files in place, which would also
+    // change the objects linked from there into a clone, or shared with
+    // other repositories by the deduper
+    const std::string repo_path = dir + torrent_name;
+    if (leech_unshare_written_files(atp, repo_path) < 0) {
+        throw std::runtime_error("Failed to copy linked files in " +
+                                 repo_path);
     }
-    atp.save_path = dir;
     ses.async_add_torrent(std::move(atp));
 
     // this is the handle we'll set once we get the notification of it being
@@ -237,6 +650,8 @@ extern "C" int leech_repository(const char* key,
     std::signal(SIGINT, &sighandler);
 
     bool done = false;
+    bool first_byte = false;
+    clk::time_point last_update = clk::now();
     for (;;) {
         std::vector<lt::alert*> alerts;
         ses.pop_alerts(&alerts);
@@ -257,16 +672,31 @@ extern "C" int leech_repository(const char* key,
                     lt::alert_cast<lt::add_torrent_alert>(a)) {
                 h = at->handle;
             }
-            if (should_write_torrent_file) {
-                if (const lt::metadata_received_alert* md =
-                        lt::alert_cast<lt::metadata_received_alert>(a)) {
+            if (const lt::metadata_received_alert* md =
+                    lt::alert_cast<lt::metadata_received_alert>(a)) {
+                if (should_write_torrent_file) {
                     write_torrent_file(torrent_file_path,
                                        md->handle.torrent_file());
                     should_write_torrent_file = false;
                 }
+                if (partial.plan && !partial.ti) {
+                    partial_leech_start(partial, md->handle.torrent_file());
+                    md->handle.prioritize_pieces(partial.priorities);
+                    partial.changed = false;
+                }
             }
-            // if we receive the finished alert or an error, we're done
-            if (lt::alert_cast<lt::torrent_finished_alert>(a)) {
+            if (const lt::file_completed_alert* fc =
+                    lt::alert_cast<lt::file_completed_alert>(a)) {
+                const std::shared_ptr<const lt::torrent_info> ti =
+                    fc->handle.torrent_file();
+                if (verify && ti)
+                    verify_file(verify, ti->files(), fc->index, dir);
+            }
+            // if we receive the finished alert or an error, we're done. A
+            // partial leech finishes each round of pieces its plan asks for,
+            // so the plan decides when it is done instead
+            if (lt::alert_cast<lt::torrent_finished_alert>(a) &&
+                !partial.plan) {
                 h.save_resume_data(lt::torrent_handle::only_if_modified |
                                    lt::torrent_handle::save_info_dict);
                 done = true;
@@ -303,6 +733,48 @@ extern "C" int leech_repository(const char* key,
                 // we only have a single torrent, so we know which one
                 // the status is for
                 const lt::torrent_status& s = st->status[0];
+
+                // Once every wanted piece is in, walk further into the
+                // repository and ask for the objects found missing
+                if (partial.plan && partial.ti && s.is_finished && !done) {
+                    for (std::size_t i = 0; i < partial.have.size(); ++i) {
+                        partial.have[i] =
+                            s.is_seeding ||
+                            (i < static_cast<std::size_t>(s.pieces.size()) &&
+                             s.pieces[lt::piece_index_t(static_cast<int>(i))]);
+                    }
+
+                    const int step = leech_partial_plan_step(partial.plan);
+                    if (step < 0) {
+                        // Fall back to leeching the entire repository
+                        leech_partial_plan_free(partial.plan);
+                        partial.plan = nullptr;
+                        partial.priorities.assign(partial.priorities.size(),
+                                                  lt::default_priority);
+                        h.prioritize_pieces(partial.priorities);
+                    } else if (step == 0) {
+                        h.save_resume_data(
+                            lt::torrent_handle::only_if_modified |
+                            lt::torrent_handle::save_info_dict);
+                        done = true;
+                    } else if (partial.changed) {
+                        h.prioritize_pieces(partial.priorities);
+                        partial.changed = false;
+                    }
+                }
+
+                // report how long it took from the command starting to the
+                // first payload arriving
+                if (!first_byte && s.total_payload_download > 0) {
+                    first_byte = true;
+                    std::cout << "\rFirst bytes after "
+                              << std::chrono::duration_cast<
+                                     std::chrono::milliseconds>(clk::now() -
+                                                                start)
+                                     .count()
+                              << " ms\x1b[K\n";
+                }
+
                 std::cout << '\r' << "Leech " << state(s.state) << ": "
                           << (s.download_payload_rate / 1000) << " kB/s "
                           << (s.total_done / 1000) << " kB ("
@@ -311,11 +783,16 @@ extern "C" int leech_repository(const char* key,
                 std::cout.flush();
             }
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        // wake up as soon as something happens rather than polling, so the
+        // torrent is picked up the moment it is added
+        ses.wait_for_alert(std::chrono::milliseconds(200));
 
         // ask the session to post a state_update_alert, to update our
         // state output for the torrent
-        ses.post_torrent_updates();
+        if (clk::now() - last_update >= std::chrono::milliseconds(200)) {
+            ses.post_torrent_updates();
+            last_update = clk::now();
+        }
 
         // save resume data once every 30 seconds
         if (clk::now() - last_save_resume > std::chrono::seconds(30)) {
@@ -327,6 +804,22 @@ extern "C" int leech_repository(const char* key,
 
 done:
     std::cout << "\rLeech complete. Saving session state...\x1b[K\n";
+
+    // Files already on disk before the leech, or whose alert was dropped,
+    // never reported completing
+    const std::shared_ptr<const lt::torrent_info> ti =
+        verify && h.is_valid() ? h.torrent_file() : nullptr;
+    if (ti) {
+        const lt::file_storage& fs = ti->files();
+        std::vector<std::int64_t> progress;
+        h.file_progress(progress, lt::torrent_handle::piece_granularity);
+        for (const lt::file_index_t i : fs.file_range()) {
+            if (progress[static_cast<std::size_t>(static_cast<int>(i))] ==
+                fs.file_size(i))
+                verify_file(verify, fs, i, dir);
+        }
+    }
+
     {
         std::ofstream of((dir + torrent_name + ".session"),
                          std::ios_base::binary);
@@ -339,12 +832,17 @@ done:
     std::cout << "Closing leeching client...\n";
 
     // Store the output path of the leeched bare repository
-    const std::string repo_path = dir + torrent_name;
     if (output_path && output_path_size > 0) {
         g_snprintf(output_path, output_path_size, "%s", repo_path.c_str());
     }
 
-    gittor_seed_start(torrent_name.c_str());
+    // Hand the verified torrent and its resume data straight to the seeder
+    // rather than having it hash the repository again
+    if (g_file_test(torrent_file_path.c_str(), G_FILE_TEST_EXISTS)) {
+        gittor_seed_resume(torrent_name.c_str());
+    } else {
+        gittor_seed_start(torrent_name.c_str());
+    }
 
     return 0;
 } catch (std::exception& e) {
@@ -12,26 +12,42 @@
 #include "leech/leech.h"
 #include "leech/leech_internal.h"
 #include "utils/utils.h"
+#include "verify/verify.h"
 
 #define KEY_USAGE 1
+#define KEY_VERIFY 2
 
 struct leech_arguments {
     struct global_arguments* global;
     char* key;
     key_type_e type;
     char* destination;
+    bool verify;
+    leech_options_t options;
 };
 
 static error_t parse_opt(int key, char* arg, struct argp_state* state);
 static key_type_e key_type(const char* key);
 static int get_repo_id(char* str, size_t n, const char* pat);
 static bool remote_url_matches_path(const char* remote_url, const char* path);
+static void find_git_dir(char* out, size_t n, const char* path);
+static int clone(git_repository** out,
+                 git_repository* leeched_repo,
+                 const char* leeched_path,
+                 const char* destination,
+                 const leech_options_t* options);
 static int infer_clone_destination(const char* global_path,
                                    const char* repo_id,
                                    char* out,
                                    size_t out_size);
 
 static struct argp_option options[] = {
+    {"branch", 'b', "BRANCH", 0,
+     "Only leech BRANCH instead of the whole repository", 0},
+    {"depth", 'd', "DEPTH", 0, "Only leech the last DEPTH commits of history",
+     0},
+    {"verify", KEY_VERIFY, NULL, 0,
+     "Check the objects and commit signatures of the leeched repository", 0},
     {"help", '?', NULL, 0, "Give this help list", -2},
     {"usage", KEY_USAGE, NULL, 0, "Give a short usage message", -1},
     {NULL, 0, NULL, 0, NULL, 0}};
@@ -67,6 +83,24 @@ static error_t parse_opt(int key, char* arg, struct argp_state* state) {
                 return E2BIG;
             }
             break;
+        case 'b':
+            args->options.branch = arg;
+            break;
+        case 'd': {
+            char* end = NULL;
+            long depth = strtol(arg, &end, 10);  // NOLINT(runtime/int)
+            if (*arg == '\0' || *end != '\0' || depth <= 0 ||
+                depth > INT_MAX) {
+                argp_error(state, "Invalid DEPTH, '%s' must be a positive "
+                           "number of commits.", arg);
+                return EINVAL;
+            }
+            args->options.depth = (int)depth;
+            break;
+        }
+        case KEY_VERIFY:
+            args->verify = true;
+            break;
         case '?':
             argp_help(&argp, stdout, ARGP_HELP_STD_HELP, state->name);
             helped = true;
@@ -105,7 +139,6 @@ extern int gittor_leech(struct argp_state* state) {
     char leeched_path[PATH_MAX] = {0};
     helped = false;
     int err = 0;
-    int ret = -1;
     git_repository* leeched_repo = NULL;
     git_repository* destination_repo = NULL;
     git_remote* origin = NULL;
@@ -131,31 +164,64 @@ extern int gittor_leech(struct argp_state* state) {
         goto end;
     }
 
-    // Stub output for template
-    err = leech_repository(args.key, args.type, leeched_path,
+    // An existing clone already holds most objects of a new version
+    char reuse_path[PATH_MAX] = {0};
+    if (args.destination) {
+        find_git_dir(reuse_path, sizeof(reuse_path), args.destination);
+    } else if (args.type == REPO_ID &&
+               !infer_clone_destination(args.global->path, args.key,
+                                        inferred_destination,
+                                        sizeof(inferred_destination))) {
+        find_git_dir(reuse_path, sizeof(reuse_path), inferred_destination);
+    }
+    if (reuse_path[0]) {
+        args.options.reuse_path = reuse_path;
+    }
+
+    // Files are verified as they complete, while the rest downloads
+    if (args.verify) {
+        args.options.verify = verify_new();
+    }
+
+    err = leech_repository(args.key, args.type, &args.options, leeched_path,
                            sizeof(leeched_path));
     if (err) {
         goto end;
     }
 
     // Initialize libgit2
-    ret = git_libgit2_init();
-    if (ret < 0) {
-        err = ret;
+    err = gittor_libgit2_init();
+    if (err) {
         goto end;
     }
 
-    // Open the leeched bare repository
-    err = git_repository_open(&leeched_repo, leeched_path);
+    // Open the leeched bare repository, which a partial leech already did
+    err = gittor_repo_open(&leeched_repo, leeched_path);
     if (err) {
         goto end;
     }
 
-    // Get repository ID
-    err = gittor_get_repo_id(leeched_repo_id, sizeof(leeched_repo_id),
-                             leeched_repo);
-    if (err) {
-        goto end;
+    // Wait for the files still being verified and check the signatures
+    if (args.options.verify) {
+        err = verify_finish(args.options.verify, leeched_repo);
+        args.options.verify = NULL;
+        if (err) {
+            goto end;
+        }
+    }
+
+    // Get repository ID. A partial leech may not have the root commit, but
+    // the leeched repository is always named after its ID.
+    if (leech_is_partial(&args.options)) {
+        gchar* basename = g_path_get_basename(leeched_path);
+        g_strlcpy(leeched_repo_id, basename, sizeof(leeched_repo_id));
+        g_free(basename);
+    } else {
+        err = gittor_get_repo_id(leeched_repo_id, sizeof(leeched_repo_id),
+                                 leeched_repo);
+        if (err) {
+            goto end;
+        }
     }
 
     // Evaluate the proper destination
@@ -173,12 +239,20 @@ extern int gittor_leech(struct argp_state* state) {
     // If destination already points to this same remote repository and
     // repository IDs match, fetch and tell the user to pull. Otherwise, clone
     // into the destination directory.
-    if (!git_repository_open(&destination_repo, destination)) {
+    if (!gittor_repo_open(&destination_repo, destination)) {
+        // A shallow destination has no root commit to take the ID from, but
+        // its origin is the leeched repository which is named after its ID
         char destination_repo_id[GIT_OID_HEXSZ + 1] = {0};
-        err = gittor_get_repo_id(destination_repo_id,
-                                 sizeof(destination_repo_id), destination_repo);
-        if (err) {
-            goto end;
+        if (git_repository_is_shallow(destination_repo)) {
+            g_strlcpy(destination_repo_id, leeched_repo_id,
+                      sizeof(destination_repo_id));
+        } else {
+            err = gittor_get_repo_id(destination_repo_id,
+                                     sizeof(destination_repo_id),
+                                     destination_repo);
+            if (err) {
+                goto end;
+            }
         }
 
         err = git_remote_lookup(&origin, destination_repo, "origin");
@@ -186,8 +260,28 @@ extern int gittor_leech(struct argp_state* state) {
             goto end;
         }
 
-        if (strcmp(destination_repo_id, leeched_repo_id) == 0 &&
-            remote_url_matches_path(git_remote_url(origin), leeched_path)) {
+        bool same_repo =
+            strcmp(destination_repo_id, leeched_repo_id) == 0 &&
+            remote_url_matches_path(git_remote_url(origin), leeched_path);
+        if (same_repo && leech_is_partial(&args.options)) {
+            err = leech_partial_fetch(destination_repo, leeched_repo,
+                                      &args.options);
+            if (err) {
+                goto end;
+            }
+
+            printf(
+                "Fetched latest changes. Run `git pull` in '%s' to apply the "
+                "latest changes\n",
+                destination);
+        } else if (same_repo) {
+            // With the leeched objects linked in, the fetch below finds
+            // every tip already present and only has to update refs. Fall
+            // back to a regular fetch across filesystems.
+            if (gittor_git_link_objects(destination_repo, leeched_repo) < 0) {
+                printf("Could not link objects, copying them instead\n");
+            }
+
             git_fetch_options fetch_opts;
             err =
                 git_fetch_options_init(&fetch_opts, GIT_FETCH_OPTIONS_VERSION);
@@ -205,20 +299,26 @@ extern int gittor_leech(struct argp_state* state) {
                 "latest changes\n",
                 destination);
         } else {
-            git_repository_free(destination_repo);
+            gittor_repo_close(destination_repo);
             destination_repo = NULL;
-            err = git_clone(&destination_repo, leeched_path, destination, NULL);
+            err = clone(&destination_repo, leeched_repo, leeched_path,
+                        destination, &args.options);
             if (err) {
                 goto end;
             }
         }
     } else {
-        err = git_clone(&destination_repo, leeched_path, destination, NULL);
+        err = clone(&destination_repo, leeched_repo, leeched_path, destination,
+                    &args.options);
         if (err) {
             goto end;
         }
     }
 
+    // Spare later commands walking the history for the ID, which a shallow
+    // clone couldn't even find
+    gittor_set_repo_id(destination_repo, leeched_repo_id);
+
 end:
     // Error handling and clean up
     if (err < 0) {
@@ -227,12 +327,12 @@ end:
             printf("Error %d/%d: %s\n", err, e->klass, e->message);
         }
     }
-    if (!ret) {
-        git_libgit2_shutdown();
+    if (args.options.verify) {
+        verify_finish(args.options.verify, NULL);
     }
     git_remote_free(origin);
-    git_repository_free(leeched_repo);
-    git_repository_free(destination_repo);
+    gittor_repo_close(leeched_repo);
+    gittor_repo_close(destination_repo);
 
     // Reset back to global
     free(argv[0]);
@@ -277,32 +377,29 @@ static key_type_e key_type(const char* key) {
 }
 
 static int get_repo_id(char* str, size_t n, const char* path) {
-    int err = 0;
-    int ret = -1;
     git_repository* repo = NULL;
 
-    // Initialize libgit2
-    ret = git_libgit2_init();
-    if (ret < 0) {
-        err = ret;
-    }
-
     // Open the local repository
-    if (!err) {
-        err = git_repository_open(&repo, path);
-    }
+    int err = gittor_repo_open(&repo, path);
 
     // Get the repo ID
     if (!err) {
         err = gittor_get_repo_id(str, n, repo);
     }
 
-    if (ret > 0) {
-        git_libgit2_shutdown();
+    gittor_repo_close(repo);
+    return err;
+}
+
+static void find_git_dir(char* out, size_t n, const char* path) {
+    git_repository* repo = NULL;
+
+    // Leave out empty if there is no repository at path
+    if (!gittor_repo_open(&repo, path)) {
+        g_strlcpy(out, git_repository_path(repo), n);
     }
-    git_repository_free(repo);
 
-    return err;
+    gittor_repo_close(repo);
 }
 
 static bool remote_url_matches_path(const char* remote_url, const char* path) {
@@ -324,6 +421,36 @@ static bool remote_url_matches_path(const char* remote_url, const char* path) {
     return false;
 }
 
+static int clone(git_repository** out,
+                 git_repository* leeched_repo,
+                 const char* leeched_path,
+                 const char* destination,
+                 const leech_options_t* options) {
+    // A partial leech only has the objects for the requested branch and
+    // depth, which a regular clone would try to walk past
+    if (leech_is_partial(options)) {
+        return leech_partial_clone(out, leeched_repo, leeched_path,
+                                   destination, options);
+    }
+
+    // The leeched repository is on the same machine, so clone it locally,
+    // hardlinking its objects instead of sending them through a transport
+    git_clone_options opts;
+    int err = git_clone_options_init(&opts, GIT_CLONE_OPTIONS_VERSION);
+    if (err) {
+        return err;
+    }
+    opts.local = GIT_CLONE_LOCAL;
+
+    // Check out the working tree in parallel once the clone is done
+    opts.checkout_opts.checkout_strategy = GIT_CHECKOUT_NONE;
+    err = git_clone(out, leeched_path, destination, &opts);
+    if (!err) {
+        err = gittor_git_checkout(*out);
+    }
+    return err;
+}
+
 static int infer_clone_destination(const char* global_path,
                                    const char* repo_id,
                                    char* out,
@@ -1,7 +1,10 @@
 #ifndef LEECH_LEECH_INTERNAL_H_
 #define LEECH_LEECH_INTERNAL_H_
 
+#include <git2.h>
 #include <stddef.h>
+#include <stdint.h>
+#include "verify/verify.h"
 
 typedef enum __attribute__((packed)) {
     REPO_ID,
@@ -10,11 +13,52 @@ typedef enum __attribute__((packed)) {
     INVALID,
 } key_type_e;
 
+/// @brief Narrows a leech down to what the caller needs
+typedef struct {
+    /// @brief Only leech this branch, NULL for the default branch
+    const char* branch;
+    /// @brief Only leech this many commits of history, 0 for all of it
+    int depth;
+    /// @brief Git directory of an existing clone whose objects can be reused
+    /// instead of downloaded, NULL for none
+    const char* reuse_path;
+    /// @brief Verification to hand completed files to, NULL for none
+    verify_t* verify;
+} leech_options_t;
+
+/// @brief Plan for downloading only the objects a partial leech needs
+typedef struct leech_partial_plan leech_partial_plan_t;
+
+/**
+ * @brief Callback asking for a byte range of a file in the leeched
+ * repository, bumping its download priority if it is not on disk yet.
+ *
+ * @param path Path of the file relative to the repository
+ * @param offset Offset of the range in the file
+ * @param length Length of the range, UINT64_MAX for the rest of the file
+ * @param payload User data given to the plan
+ * @return int 1 if the range is on disk, 0 if it is still being fetched,
+ * negative if the file is not part of the torrent
+ */
+typedef int (*leech_partial_range_cb)(const char* path,
+                                      uint64_t offset,
+                                      uint64_t length,
+                                      void* payload);
+
+/**
+ * @brief Checks if a leech should only fetch part of the repository.
+ *
+ * @param options The leech options, may be NULL
+ * @return int non-zero if the leech is partial
+ */
+extern int leech_is_partial(const leech_options_t* options);
+
 /**
- * @brief Leeches an entire repository.
+ * @brief Leeches a repository.
  *
  * @param key The key used to identify the repository to leech
  * @param type The type of key given
+ * @param options What to leech, NULL for the entire repository
  * @param output_path Buffer to store the path of the leeched bare repository
  * (should be at least PATH_MAX size)
  * @param output_path_size Size of the output_path buffer
@@ -22,7 +66,70 @@ typedef enum __attribute__((packed)) {
  */
 extern int leech_repository(const char* key,
                             key_type_e type,
+                            const leech_options_t* options,
                             char* output_path,
                             size_t output_path_size);
 
+/**
+ * @brief Creates a plan for a partial leech. The plan is stepped once the
+ * refs, pack indexes and pack boundaries of the repository are on disk.
+ *
+ * @param repo_path Path of the leeched bare repository
+ * @param options The branch and depth to leech
+ * @param range Callback asking for the byte ranges objects live in
+ * @param payload User data passed to the callback
+ * @return leech_partial_plan_t* The plan, free with leech_partial_plan_free
+ */
+extern leech_partial_plan_t* leech_partial_plan_new(
+    const char* repo_path,
+    const leech_options_t* options,
+    leech_partial_range_cb range,
+    void* payload);
+
+/**
+ * @brief Walks the objects needed so far, asking for the ones missing from
+ * disk. Each step gets further as the data from the previous one arrives.
+ *
+ * @param plan The plan
+ * @return int 0 when every needed object is on disk, 1 if more data was asked
+ * for, negative if the repository can't be leeched partially
+ */
+extern int leech_partial_plan_step(leech_partial_plan_t* plan);
+
+/**
+ * @brief Frees a partial leech plan.
+ *
+ * @param plan The plan to free, may be NULL
+ */
+extern void leech_partial_plan_free(leech_partial_plan_t* plan);
+
+/**
+ * @brief Copies the objects of a partial leech into a repository, recording
+ * where the history was cut off and updating its origin tracking branch.
+ *
+ * @param destination The repository to fetch into
+ * @param leeched The partially leeched bare repository
+ * @param options The branch and depth that were leeched
+ * @return int error code
+ */
+extern int leech_partial_fetch(git_repository* destination,
+                               git_repository* leeched,
+                               const leech_options_t* options);
+
+/**
+ * @brief Clones a partial leech into a new repository and checks it out.
+ *
+ * @param out Output for the cloned repository
+ * @param leeched The partially leeched bare repository
+ * @param url URL of the leeched repository to use as origin
+ * @param destination Directory to clone into, must be empty or missing
+ * @param options The branch and depth that were leeched
+ * @return int error code
+ */
+extern int leech_partial_clone(git_repository** out,
+                               git_repository* leeched,
+                               const char* url,
+                               const char* destination,
+                               const leech_options_t* options);
+
 #endif  // LEECH_LEECH_INTERNAL_H_
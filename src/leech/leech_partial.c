@@ -0,0 +1,855 @@
+#include <git2.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "leech/leech_internal.h"
+#include "utils/utils.h"
+
+#define IDX_MAGIC "\377tOc"
+#define IDX_VERSION 2
+#define IDX_FANOUT_OFFSET 8
+#define IDX_OIDS_OFFSET (IDX_FANOUT_OFFSET + 256 * 4)
+#define IDX_TRAILER_SIZE (2 * GIT_OID_RAWSZ)
+#define MAX_DELTA_CHAIN 4096
+
+/// @brief Objects needed to check out the requested refs
+typedef struct {
+    /// @brief Every commit, tree and blob found so far
+    GArray* objects;
+    /// @brief Commits whose parents were cut off by the depth limit
+    GArray* shallow;
+    /// @brief Number of needed objects whose data is not on disk yet
+    size_t pending;
+} partial_walk_t;
+
+/// @brief A pack file of the leeched repository and its mapped v2 index
+typedef struct {
+    /// @brief Path of the pack relative to the repository
+    char* path;
+    /// @brief Absolute path of the pack on disk
+    char* full_path;
+    GMappedFile* idx;
+    guint32 count;
+    /// @brief Offsets of every object in the pack, sorted
+    guint64* offsets;
+    FILE* fp;
+} pack_t;
+
+struct leech_partial_plan {
+    char* repo_path;
+    char* branch;
+    int depth;
+    leech_partial_range_cb range;
+    void* payload;
+    GPtrArray* packs;
+    git_repository* repo;
+    bool initialized;
+};
+
+/**
+ * @brief Callback to make sure an object can be read from the repository.
+ *
+ * @return int 1 if it can be read, 0 if its data is still being fetched,
+ * negative on error
+ */
+typedef int (*ensure_cb)(const git_oid* oid, void* payload);
+
+static guint oid_hash(gconstpointer key) {
+    guint hash = 0;
+    memcpy(&hash, ((const git_oid*)key)->id, sizeof(hash));
+    return hash;
+}
+
+static gboolean oid_equal(gconstpointer a, gconstpointer b) {
+    return git_oid_equal((const git_oid*)a, (const git_oid*)b);
+}
+
+static guint32 read_be32(const guint8* p) {
+    return ((guint32)p[0] << 24) | ((guint32)p[1] << 16) |
+           ((guint32)p[2] << 8) | (guint32)p[3];
+}
+
+static guint64 read_be64(const guint8* p) {
+    return ((guint64)read_be32(p) << 32) | read_be32(p + 4);
+}
+
+static int compare_offsets(const void* a, const void* b) {
+    guint64 x = *(const guint64*)a;
+    guint64 y = *(const guint64*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Mark an object as seen during a walk.
+ *
+ * @return true if this is the first time the object was seen
+ */
+static bool mark_seen(GHashTable* seen, const git_oid* oid) {
+    if (g_hash_table_contains(seen, oid)) {
+        return false;
+    }
+
+    git_oid* key = g_new(git_oid, 1);
+    git_oid_cpy(key, oid);
+    g_hash_table_add(seen, key);
+    return true;
+}
+
+static int ensure(ensure_cb cb, void* payload, const git_oid* oid) {
+    return cb ? cb(oid, payload) : 1;
+}
+
+static void walk_init(partial_walk_t* walk) {
+    walk->objects = g_array_new(FALSE, FALSE, sizeof(git_oid));
+    walk->shallow = g_array_new(FALSE, FALSE, sizeof(git_oid));
+    walk->pending = 0;
+}
+
+static void walk_clear(partial_walk_t* walk) {
+    g_array_free(walk->objects, TRUE);
+    g_array_free(walk->shallow, TRUE);
+}
+
+static int resolve_tip(git_oid* out, git_repository* repo, const char* branch) {
+    if (!branch) {
+        return git_reference_name_to_id(out, repo, "HEAD");
+    }
+
+    gchar* name = g_strdup_printf("refs/heads/%s", branch);
+    int err = git_reference_name_to_id(out, repo, name);
+    g_free(name);
+    return err;
+}
+
+static int resolve_branch(char* out,
+                          size_t out_size,
+                          git_repository* repo,
+                          const char* branch) {
+    if (branch) {
+        g_strlcpy(out, branch, out_size);
+        return 0;
+    }
+
+    // Follow HEAD of the leeched repository to its default branch
+    git_reference* head = NULL;
+    int err = git_reference_lookup(&head, repo, "HEAD");
+    if (!err && git_reference_type(head) != GIT_REFERENCE_SYMBOLIC) {
+        git_error_set_str(GIT_ERROR_REFERENCE,
+                          "leeched repository has a detached HEAD");
+        err = GIT_EINVALIDSPEC;
+    }
+
+    const char prefix[] = "refs/heads/";
+    if (!err) {
+        const char* target = git_reference_symbolic_target(head);
+        if (strncmp(target, prefix, sizeof(prefix) - 1) == 0) {
+            target += sizeof(prefix) - 1;
+        }
+        g_strlcpy(out, target, out_size);
+    }
+
+    git_reference_free(head);
+    return err;
+}
+
+static int walk_tree(git_repository* repo,
+                     const git_oid* root,
+                     GHashTable* seen,
+                     ensure_cb cb,
+                     void* payload,
+                     partial_walk_t* out) {
+    int err = 0;
+    GArray* stack = g_array_new(FALSE, FALSE, sizeof(git_oid));
+    g_array_append_vals(stack, root, 1);
+
+    while (!err && stack->len > 0) {
+        git_oid id = g_array_index(stack, git_oid, stack->len - 1);
+        g_array_set_size(stack, stack->len - 1);
+
+        int ready = ensure(cb, payload, &id);
+        if (ready <= 0) {
+            if (ready == 0) {
+                out->pending++;
+            }
+            err = ready;
+            continue;
+        }
+
+        git_tree* tree = NULL;
+        err = git_tree_lookup(&tree, repo, &id);
+        size_t count = err ? 0 : git_tree_entrycount(tree);
+        for (size_t i = 0; !err && i < count; i++) {
+            const git_tree_entry* entry = git_tree_entry_byindex(tree, i);
+            const git_oid* entry_id = git_tree_entry_id(entry);
+            git_object_t type = git_tree_entry_type(entry);
+
+            // Submodule commits live in other repositories
+            if (type == GIT_OBJECT_COMMIT || !mark_seen(seen, entry_id)) {
+                continue;
+            }
+
+            g_array_append_vals(out->objects, entry_id, 1);
+            if (type == GIT_OBJECT_TREE) {
+                g_array_append_vals(stack, entry_id, 1);
+                continue;
+            }
+
+            ready = ensure(cb, payload, entry_id);
+            if (ready == 0) {
+                out->pending++;
+            } else if (ready < 0) {
+                err = ready;
+            }
+        }
+        git_tree_free(tree);
+    }
+
+    g_array_free(stack, TRUE);
+    return err;
+}
+
+/**
+ * @brief Walk every object needed to check out a branch up to a given depth.
+ * Objects that are not readable yet are counted as pending and not descended
+ * into, so the walk can be repeated as more data arrives.
+ */
+static int partial_walk(git_repository* repo,
+                        const char* branch,
+                        int depth,
+                        ensure_cb cb,
+                        void* payload,
+                        partial_walk_t* out) {
+    typedef struct {
+        git_oid id;
+        int level;
+    } queued_commit_t;
+
+    git_oid tip;
+    int err = resolve_tip(&tip, repo, branch);
+    if (err) {
+        return err;
+    }
+
+    GHashTable* seen = g_hash_table_new_full(oid_hash, oid_equal, g_free, NULL);
+    GQueue queue = G_QUEUE_INIT;
+    queued_commit_t* item = g_new(queued_commit_t, 1);
+    git_oid_cpy(&item->id, &tip);
+    item->level = 1;
+    mark_seen(seen, &tip);
+    g_queue_push_tail(&queue, item);
+
+    // Breadth first, so every commit is reached at its shallowest level
+    while (!err && (item = g_queue_pop_head(&queue))) {
+        git_commit* commit = NULL;
+        int ready = ensure(cb, payload, &item->id);
+        if (ready <= 0) {
+            if (ready == 0) {
+                out->pending++;
+            }
+            err = ready;
+        } else {
+            err = git_commit_lookup(&commit, repo, &item->id);
+        }
+
+        if (commit) {
+            g_array_append_vals(out->objects, &item->id, 1);
+
+            const git_oid* tree_id = git_commit_tree_id(commit);
+            if (mark_seen(seen, tree_id)) {
+                g_array_append_vals(out->objects, tree_id, 1);
+                err = walk_tree(repo, tree_id, seen, cb, payload, out);
+            }
+
+            unsigned int parents = git_commit_parentcount(commit);
+            if (depth > 0 && item->level >= depth) {
+                if (parents > 0) {
+                    g_array_append_vals(out->shallow, &item->id, 1);
+                }
+            } else {
+                for (unsigned int i = 0; i < parents; i++) {
+                    const git_oid* parent = git_commit_parent_id(commit, i);
+                    if (mark_seen(seen, parent)) {
+                        queued_commit_t* next = g_new(queued_commit_t, 1);
+                        git_oid_cpy(&next->id, parent);
+                        next->level = item->level + 1;
+                        g_queue_push_tail(&queue, next);
+                    }
+                }
+            }
+            git_commit_free(commit);
+        }
+        g_free(item);
+    }
+
+    g_queue_clear_full(&queue, g_free);
+    g_hash_table_destroy(seen);
+    return err;
+}
+
+static void pack_free(gpointer data) {
+    pack_t* pack = data;
+    if (pack->fp) {
+        fclose(pack->fp);
+    }
+    if (pack->idx) {
+        g_mapped_file_unref(pack->idx);
+    }
+    g_free(pack->offsets);
+    g_free(pack->path);
+    g_free(pack->full_path);
+    g_free(pack);
+}
+
+static const guint8* pack_idx_data(const pack_t* pack) {
+    return (const guint8*)g_mapped_file_get_contents(pack->idx);
+}
+
+static guint64 pack_idx_offset(const pack_t* pack, guint32 i) {
+    const guint8* offsets =
+        pack_idx_data(pack) + IDX_OIDS_OFFSET + (gsize)pack->count * 24;
+    guint32 offset = read_be32(offsets + (gsize)i * 4);
+
+    // Offsets past 2 GiB are stored in a separate table of 64-bit values
+    if (offset & 0x80000000u) {
+        const guint8* large = offsets + (gsize)pack->count * 4;
+        return read_be64(large + (gsize)(offset & 0x7fffffffu) * 8);
+    }
+    return offset;
+}
+
+static int load_pack(leech_partial_plan_t* plan,
+                     const char* pack_dir,
+                     const char* idx_name) {
+    pack_t* pack = g_new0(pack_t, 1);
+    gchar* stem = g_strndup(idx_name, strlen(idx_name) - strlen(".idx"));
+    gchar* idx_path = g_build_filename(pack_dir, idx_name, NULL);
+    pack->full_path =
+        g_strdup_printf("%s%s%s.pack", pack_dir, G_DIR_SEPARATOR_S, stem);
+    pack->path = g_strdup_printf("objects/pack/%s.pack", stem);
+    pack->idx = g_mapped_file_new(idx_path, FALSE, NULL);
+    g_free(idx_path);
+    g_free(stem);
+
+    // Only version 2 indexes are understood, which is all libgit2 writes
+    const guint8* data = pack->idx ? pack_idx_data(pack) : NULL;
+    gsize len = pack->idx ? g_mapped_file_get_length(pack->idx) : 0;
+    if (len < IDX_OIDS_OFFSET + IDX_TRAILER_SIZE ||
+        memcmp(data, IDX_MAGIC, 4) != 0 || read_be32(data + 4) != IDX_VERSION) {
+        g_printerr("Unsupported pack index for %s\n", pack->path);
+        pack_free(pack);
+        return -1;
+    }
+
+    pack->count = read_be32(data + IDX_FANOUT_OFFSET + 255 * 4);
+    gsize tables = IDX_OIDS_OFFSET + (gsize)pack->count * (GIT_OID_RAWSZ + 8);
+    if (len < tables + IDX_TRAILER_SIZE) {
+        g_printerr("Truncated pack index for %s\n", pack->path);
+        pack_free(pack);
+        return -1;
+    }
+
+    // Every 64-bit offset referenced must lie inside the index
+    const guint8* offsets = data + tables - (gsize)pack->count * 4;
+    gsize large_count = (len - IDX_TRAILER_SIZE - tables) / 8;
+    for (guint32 i = 0; i < pack->count; i++) {
+        guint32 offset = read_be32(offsets + (gsize)i * 4);
+        if ((offset & 0x80000000u) &&
+            (offset & 0x7fffffffu) >= large_count) {
+            g_printerr("Corrupt pack index for %s\n", pack->path);
+            pack_free(pack);
+            return -1;
+        }
+    }
+
+    pack->offsets = g_new(guint64, pack->count ? pack->count : 1);
+    for (guint32 i = 0; i < pack->count; i++) {
+        pack->offsets[i] = pack_idx_offset(pack, i);
+    }
+    qsort(pack->offsets, pack->count, sizeof(*pack->offsets), compare_offsets);
+
+    g_ptr_array_add(plan->packs, pack);
+    return 0;
+}
+
+static int load_packs(leech_partial_plan_t* plan) {
+    gchar* pack_dir =
+        g_build_filename(plan->repo_path, "objects", "pack", NULL);
+    GDir* dir = g_dir_open(pack_dir, 0, NULL);
+    int err = 0;
+
+    // A repository without packs only has loose objects
+    if (dir) {
+        const gchar* name = NULL;
+        while (!err && (name = g_dir_read_name(dir))) {
+            if (g_str_has_suffix(name, ".idx")) {
+                err = load_pack(plan, pack_dir, name);
+            }
+        }
+        g_dir_close(dir);
+    }
+
+    g_free(pack_dir);
+    return err;
+}
+
+static bool pack_find(const pack_t* pack, const git_oid* oid, guint64* offset) {
+    const guint8* data = pack_idx_data(pack);
+    const guint8* fanout = data + IDX_FANOUT_OFFSET;
+    const guint8* ids = data + IDX_OIDS_OFFSET;
+    guint8 first = oid->id[0];
+    guint32 lo = first ? read_be32(fanout + (first - 1) * 4) : 0;
+    guint32 hi = read_be32(fanout + first * 4);
+
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        int cmp = memcmp(ids + (gsize)mid * GIT_OID_RAWSZ, oid->id,
+                         GIT_OID_RAWSZ);
+        if (cmp == 0) {
+            *offset = pack_idx_offset(pack, mid);
+            return true;
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return false;
+}
+
+static bool find_packed(const leech_partial_plan_t* plan,
+                        const git_oid* oid,
+                        pack_t** pack,
+                        guint64* offset) {
+    for (guint i = 0; i < plan->packs->len; i++) {
+        pack_t* candidate = g_ptr_array_index(plan->packs, i);
+        if (pack_find(candidate, oid, offset)) {
+            *pack = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Get where an object's data ends in its pack.
+ *
+ * @return guint64 Offset of the next object, or G_MAXUINT64 if it is the last
+ * object and runs to the end of the file
+ */
+static guint64 pack_object_end(const pack_t* pack, guint64 offset) {
+    guint32 lo = 0;
+    guint32 hi = pack->count;
+    while (lo < hi) {
+        guint32 mid = lo + (hi - lo) / 2;
+        if (pack->offsets[mid] <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < pack->count ? pack->offsets[lo] : G_MAXUINT64;
+}
+
+/**
+ * @brief Read the header of a packed object to find its delta base, if any.
+ *
+ * @param type Output for the object type
+ * @param base_offset Output for the base of an offset delta
+ * @param base_id Output for the base of a reference delta
+ * @return int 0 on success, non-zero on failure
+ */
+static int read_pack_header(pack_t* pack,
+                            guint64 offset,
+                            int* type,
+                            guint64* base_offset,
+                            git_oid* base_id) {
+    // Unbuffered, the data under us changes as pieces arrive
+    if (!pack->fp) {
+        pack->fp = g_fopen(pack->full_path, "rb");
+        if (!pack->fp) {
+            return -1;
+        }
+        setvbuf(pack->fp, NULL, _IONBF, 0);
+    }
+
+    guint8 buf[32];
+    if (fseeko(pack->fp, (off_t)offset, SEEK_SET) != 0) {
+        return -1;
+    }
+    size_t n = fread(buf, 1, sizeof(buf), pack->fp);
+    size_t pos = 0;
+    if (n == 0) {
+        return -1;
+    }
+
+    // Type and inflated size, the size is not needed
+    guint8 c = buf[pos++];
+    *type = (c >> 4) & 7;
+    while ((c & 0x80) && pos < n) {
+        c = buf[pos++];
+    }
+    if (c & 0x80) {
+        return -1;
+    }
+
+    if (*type == GIT_OBJECT_OFS_DELTA) {
+        if (pos >= n) {
+            return -1;
+        }
+        c = buf[pos++];
+        guint64 distance = c & 0x7f;
+        while (c & 0x80) {
+            if (pos >= n) {
+                return -1;
+            }
+            c = buf[pos++];
+            distance = ((distance + 1) << 7) | (c & 0x7f);
+        }
+        if (distance == 0 || distance > offset) {
+            return -1;
+        }
+        *base_offset = offset - distance;
+    } else if (*type == GIT_OBJECT_REF_DELTA) {
+        if (pos + GIT_OID_RAWSZ > n) {
+            return -1;
+        }
+        git_oid_fromraw(base_id, buf + pos);
+    }
+
+    return 0;
+}
+
+static int ensure_loose(leech_partial_plan_t* plan, const git_oid* oid) {
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), oid);
+    gchar* path = g_strdup_printf("objects/%.2s/%s", hex, hex + 2);
+    int ready = plan->range(path, 0, G_MAXUINT64, plan->payload);
+    g_free(path);
+    return ready < 0 ? GIT_ENOTFOUND : ready;
+}
+
+static int ensure_packed(leech_partial_plan_t* plan,
+                         pack_t* pack,
+                         guint64 offset) {
+    // Follow the delta chain, every base must be on disk to read the object
+    for (int i = 0; i < MAX_DELTA_CHAIN; i++) {
+        guint64 end = pack_object_end(pack, offset);
+        guint64 length = end == G_MAXUINT64 ? G_MAXUINT64 : end - offset;
+        int ready = plan->range(pack->path, offset, length, plan->payload);
+        if (ready <= 0) {
+            return ready;
+        }
+
+        int type = GIT_OBJECT_INVALID;
+        guint64 base_offset = 0;
+        git_oid base_id;
+        if (read_pack_header(pack, offset, &type, &base_offset, &base_id)) {
+            return -1;
+        }
+
+        if (type == GIT_OBJECT_OFS_DELTA) {
+            offset = base_offset;
+        } else if (type == GIT_OBJECT_REF_DELTA) {
+            if (!find_packed(plan, &base_id, &pack, &offset)) {
+                return ensure_loose(plan, &base_id);
+            }
+        } else {
+            return 1;
+        }
+    }
+
+    return -1;
+}
+
+static int plan_ensure(const git_oid* oid, void* payload) {
+    leech_partial_plan_t* plan = payload;
+    pack_t* pack = NULL;
+    guint64 offset = 0;
+
+    if (find_packed(plan, oid, &pack, &offset)) {
+        return ensure_packed(plan, pack, offset);
+    }
+    return ensure_loose(plan, oid);
+}
+
+extern int leech_is_partial(const leech_options_t* options) {
+    return options && (options->branch || options->depth > 0);
+}
+
+extern leech_partial_plan_t* leech_partial_plan_new(
+    const char* repo_path,
+    const leech_options_t* options,
+    leech_partial_range_cb range,
+    void* payload) {
+    leech_partial_plan_t* plan = g_new0(leech_partial_plan_t, 1);
+    plan->repo_path = g_strdup(repo_path);
+    plan->branch = g_strdup(options->branch);
+    plan->depth = options->depth;
+    plan->range = range;
+    plan->payload = payload;
+    plan->packs = g_ptr_array_new_with_free_func(pack_free);
+    return plan;
+}
+
+extern int leech_partial_plan_step(leech_partial_plan_t* plan) {
+    int err = 0;
+
+    // The indexes, refs and pack boundaries are on disk by the first step
+    if (!plan->initialized) {
+        plan->initialized = true;
+        err = gittor_libgit2_init();
+        if (err) {
+            return err;
+        }
+        err = load_packs(plan);
+        if (!err) {
+            err = gittor_repo_open(&plan->repo, plan->repo_path);
+        }
+        if (err) {
+            return err < 0 ? err : -err;
+        }
+    }
+    if (!plan->repo) {
+        return -1;
+    }
+
+    partial_walk_t walk;
+    walk_init(&walk);
+    err = partial_walk(plan->repo, plan->branch, plan->depth, plan_ensure,
+                       plan, &walk);
+    size_t pending = walk.pending;
+    walk_clear(&walk);
+
+    if (err) {
+        const git_error* e = git_error_last();
+        g_printerr("\nPartial leech failed, fetching everything: %s\n",
+                   e ? e->message : "unreadable pack data");
+        return err < 0 ? err : -err;
+    }
+    return pending > 0;
+}
+
+extern void leech_partial_plan_free(leech_partial_plan_t* plan) {
+    if (!plan) {
+        return;
+    }
+
+    // The leech opens the repository again once it is complete
+    gittor_repo_close(plan->repo);
+    g_ptr_array_free(plan->packs, TRUE);
+    g_free(plan->repo_path);
+    g_free(plan->branch);
+    g_free(plan);
+}
+
+/**
+ * @brief Check if every parent of a leeched commit is already in the
+ * destination, in which case it must not be recorded as shallow.
+ */
+static bool parents_present(git_odb* odb,
+                            git_repository* leeched,
+                            const git_oid* oid) {
+    git_commit* commit = NULL;
+    if (git_commit_lookup(&commit, leeched, oid)) {
+        return false;
+    }
+
+    bool present = true;
+    unsigned int parents = git_commit_parentcount(commit);
+    for (unsigned int i = 0; present && i < parents; i++) {
+        present = git_odb_exists(odb, git_commit_parent_id(commit, i));
+    }
+
+    git_commit_free(commit);
+    return present;
+}
+
+static int write_shallow(git_repository* destination,
+                         git_repository* leeched,
+                         git_odb* odb,
+                         const GArray* shallow) {
+    gchar* path =
+        g_build_filename(git_repository_path(destination), "shallow", NULL);
+    GHashTable* seen = g_hash_table_new_full(oid_hash, oid_equal, g_free, NULL);
+    GString* content = g_string_new(NULL);
+    char hex[GIT_OID_HEXSZ + 1];
+    int err = 0;
+
+    // Keep the cut-off points of earlier partial leeches
+    gchar* old = NULL;
+    if (g_file_get_contents(path, &old, NULL, NULL)) {
+        gchar** lines = g_strsplit(old, "\n", -1);
+        for (gchar** line = lines; *line; line++) {
+            git_oid oid;
+            if (strlen(*line) >= GIT_OID_HEXSZ &&
+                !git_oid_fromstrn(&oid, *line, GIT_OID_HEXSZ) &&
+                mark_seen(seen, &oid)) {
+                git_oid_tostr(hex, sizeof(hex), &oid);
+                g_string_append_printf(content, "%s\n", hex);
+            }
+        }
+        g_strfreev(lines);
+        g_free(old);
+    }
+
+    for (guint i = 0; i < shallow->len; i++) {
+        const git_oid* oid = &g_array_index(shallow, git_oid, i);
+        if (!parents_present(odb, leeched, oid) && mark_seen(seen, oid)) {
+            git_oid_tostr(hex, sizeof(hex), oid);
+            g_string_append_printf(content, "%s\n", hex);
+        }
+    }
+
+    if (content->len > 0 &&
+        !g_file_set_contents(path, content->str, (gssize)content->len, NULL)) {
+        git_error_set_str(GIT_ERROR_OS, "failed to write the shallow file");
+        err = -1;
+    }
+
+    g_string_free(content, TRUE);
+    g_hash_table_destroy(seen);
+    g_free(path);
+    return err;
+}
+
+extern int leech_partial_fetch(git_repository* destination,
+                               git_repository* leeched,
+                               const leech_options_t* options) {
+    int err = 0;
+    char branch[256] = {0};
+    git_oid tip;
+    git_odb* odb = NULL;
+    git_packbuilder* pb = NULL;
+    git_reference* tracking = NULL;
+    partial_walk_t walk;
+    walk_init(&walk);
+
+    err = resolve_branch(branch, sizeof(branch), leeched, options->branch);
+    if (!err) {
+        err = resolve_tip(&tip, leeched, options->branch);
+    }
+    if (!err) {
+        err = partial_walk(leeched, options->branch, options->depth, NULL,
+                           NULL, &walk);
+    }
+
+    // Pack only the walked objects the destination is missing
+    if (!err) {
+        err = git_repository_odb(&odb, destination);
+    }
+    if (!err) {
+        err = git_packbuilder_new(&pb, leeched);
+    }
+    if (!err) {
+        git_packbuilder_set_threads(pb, 0);
+        for (guint i = 0; !err && i < walk.objects->len; i++) {
+            const git_oid* oid = &g_array_index(walk.objects, git_oid, i);
+            if (!git_odb_exists(odb, oid)) {
+                err = git_packbuilder_insert(pb, oid, NULL);
+            }
+        }
+    }
+    if (!err && git_packbuilder_object_count(pb) > 0) {
+        gchar* pack_dir = g_build_filename(git_repository_path(destination),
+                                           "objects", "pack", NULL);
+        err = git_packbuilder_write(pb, pack_dir, 0, NULL, NULL);
+        g_free(pack_dir);
+    }
+
+    if (!err) {
+        err = write_shallow(destination, leeched, odb, walk.shallow);
+    }
+
+    // Point the remote-tracking branch at the leeched tip
+    if (!err) {
+        gchar* name = g_strdup_printf("refs/remotes/origin/%s", branch);
+        err = git_reference_create(&tracking, destination, name, &tip, 1,
+                                   "leech: partial fetch");
+        g_free(name);
+    }
+
+    git_reference_free(tracking);
+    git_packbuilder_free(pb);
+    git_odb_free(odb);
+    walk_clear(&walk);
+    return err;
+}
+
+static bool dir_is_empty(const char* path) {
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (!dir) {
+        return true;
+    }
+
+    bool empty = g_dir_read_name(dir) == NULL;
+    g_dir_close(dir);
+    return empty;
+}
+
+extern int leech_partial_clone(git_repository** out,
+                               git_repository* leeched,
+                               const char* url,
+                               const char* destination,
+                               const leech_options_t* options) {
+    int err = 0;
+    char branch[256] = {0};
+    git_oid tip;
+    git_repository* repo = NULL;
+    git_remote* origin = NULL;
+    git_reference* local = NULL;
+
+    if (!dir_is_empty(destination)) {
+        git_error_set_str(GIT_ERROR_INVALID,
+                          "destination path already exists and is not an "
+                          "empty directory");
+        return GIT_EEXISTS;
+    }
+
+    err = resolve_branch(branch, sizeof(branch), leeched, options->branch);
+    if (!err) {
+        err = resolve_tip(&tip, leeched, options->branch);
+    }
+    if (!err) {
+        err = git_repository_init(&repo, destination, false);
+    }
+    if (!err) {
+        err = git_remote_create(&origin, repo, "origin", url);
+    }
+    if (!err) {
+        err = leech_partial_fetch(repo, leeched, options);
+    }
+
+    // Create the local branch tracking the leeched one and check it out
+    if (!err) {
+        gchar* name = g_strdup_printf("refs/heads/%s", branch);
+        err = git_reference_create(&local, repo, name, &tip, 0,
+                                   "leech: partial clone");
+        if (!err) {
+            err = git_repository_set_head(repo, name);
+        }
+        g_free(name);
+    }
+    if (!err) {
+        gchar* upstream = g_strdup_printf("origin/%s", branch);
+        err = git_branch_set_upstream(local, upstream);
+        g_free(upstream);
+    }
+    if (!err) {
+        err = gittor_git_checkout(repo);
+    }
+
+    git_reference_free(local);
+    git_remote_free(origin);
+    if (err) {
+        git_repository_free(repo);
+        repo = NULL;
+    }
+    *out = repo;
+    return err;
+}
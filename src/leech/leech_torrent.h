@@ -0,0 +1,59 @@
+#ifndef LEECH_LEECH_TORRENT_H_
+#define LEECH_LEECH_TORRENT_H_
+
+// C++ only, the leecher's handling of the torrent it adds
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <libtorrent/add_torrent_params.hpp>
+#include <libtorrent/torrent_info.hpp>
+
+/**
+ * @brief Pick up the resume data saved by the last leech of the repository.
+ * If it is for the same torrent it replaces the parameters, with the piece
+ * priorities of an earlier partial leech dropped unless this one is partial
+ * too. Otherwise it is the previous version of the repository.
+ *
+ * @param atp The parameters of the torrent to add
+ * @param resume_path The .resume file of the repository
+ * @param partial Whether this leech only fetches part of the repository
+ * @return std::shared_ptr<const lt::torrent_info> The torrent of the previous
+ * version, empty if there is none or the resume data is for this one
+ */
+std::shared_ptr<const lt::torrent_info> leech_load_resume(
+    lt::add_torrent_params& atp,
+    const std::string& resume_path,
+    bool partial);
+
+/**
+ * @brief Copy files of the torrent that are missing from its save path out of
+ * an older copy of the repository, so the initial check finds them instead of
+ * downloading them again. Nothing is copied into a resumed torrent.
+ *
+ * @param atp The parameters of the torrent to add
+ * @param previous The torrent of the previous version, may be empty
+ * @param reuse_path Git directory of a clone to take objects from, may be
+ * NULL
+ * @return std::int64_t The number of bytes copied
+ */
+std::int64_t leech_reuse_local_files(
+    const lt::add_torrent_params& atp,
+    const std::shared_ptr<const lt::torrent_info>& previous,
+    const char* reuse_path);
+
+/**
+ * @brief Give the files of the torrent that libtorrent may still write into
+ * their own copy, if they are linked to other copies. Those are the files
+ * with pieces missing from the resume data, or that don't hash when there is
+ * none. Every linked file of the repository is copied if the torrent's
+ * metadata isn't known yet.
+ *
+ * @param atp The parameters of the torrent to add
+ * @param repo_path Path of the repository in the remotes directory
+ * @return int Number of files copied, negative on error
+ */
+int leech_unshare_written_files(const lt::add_torrent_params& atp,
+                                const std::string& repo_path);
+
+#endif  // LEECH_LEECH_TORRENT_H_
@@ -0,0 +1,14 @@
+#ifndef LIST_LIST_H_
+#define LIST_LIST_H_
+
+#include <argp.h>
+
+/**
+ * @brief Runs the list subcommand.
+ *
+ * @param state The arguments of the subcommand
+ * @return int error code
+ */
+extern int gittor_list(struct argp_state* state);
+
+#endif  // LIST_LIST_H_
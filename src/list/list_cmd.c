@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "api/torrents.h"
+#include "cmd/cmd.h"
+#include "list/list.h"
+
+#define KEY_USAGE 1
+
+struct list_arguments {
+    struct global_arguments* global;
+    char* query;
+    size_t page_size;
+};
+
+static error_t parse_opt(int key, char* arg, struct argp_state* state);
+
+static struct argp_option options[] = {
+    {"page-size", 'n', "COUNT", 0,
+     "Ask the server for COUNT torrents at a time", 0},
+    {"help", '?', NULL, 0, "Give this help list", -2},
+    {"usage", KEY_USAGE, NULL, 0, "Give a short usage message", -1},
+    {NULL, 0, NULL, 0, NULL, 0}};
+
+static char doc[] =
+    "Lists the repositories on the server, or only those matching QUERY.";
+
+static struct argp argp = {options, parse_opt, "[QUERY]", doc,
+                           NULL,    NULL,      NULL};
+
+static bool helped;
+static error_t parse_opt(int key, char* arg, struct argp_state* state) {
+    struct list_arguments* args = state->input;
+
+    switch (key) {
+        case 'n': {
+            char* end = NULL;
+            long long count = strtoll(arg, &end, 10);  // NOLINT(runtime/int)
+            if (!*arg || *end || count <= 0) {
+                argp_error(state, "Invalid COUNT '%s'", arg);
+                return EINVAL;
+            }
+            args->page_size = (size_t)count;
+            break;
+        }
+
+        case '?':
+            argp_help(&argp, stdout, ARGP_HELP_STD_HELP, state->name);
+            helped = true;
+            break;
+
+        case KEY_USAGE:
+            argp_help(&argp, stdout, ARGP_HELP_STD_USAGE, state->name);
+            helped = true;
+            break;
+
+        case ARGP_KEY_ARG:
+            if (state->arg_num == 0) {
+                args->query = arg;
+            } else {
+                return E2BIG;
+            }
+            break;
+
+        default:
+            return ARGP_ERR_UNKNOWN;
+    }
+
+    return 0;
+}
+
+extern int gittor_list(struct argp_state* state) {
+    // Set defaults arguments
+    struct list_arguments args = {0};
+    helped = false;
+
+    // Change the arguments array for just list
+    int argc = state->argc - state->next + 1;
+    char** argv = &state->argv[state->next - 1];
+    args.global = state->input;
+
+    // Change the command name to gittor list
+    const char name[] = "list";
+    size_t argv0len = strlen(state->name) + sizeof(name) + 1;
+    char* argv0 = argv[0];
+    argv[0] = malloc(argv0len);
+    g_snprintf(argv[0], argv0len, "%s %s", state->name, name);
+
+    // Parse arguments
+    int err = argp_parse(&argp, argc, argv, ARGP_NO_EXIT, &argc, &args);
+    if (!err && !helped) {
+        api_result_e result = API_OK;
+        torrent_iter_t* iter =
+            args.query ? api_search_torrents(args.query, args.page_size,
+                                             &result)
+                       : api_list_torrents(args.page_size, &result);
+
+        // Print each repository as soon as it arrives, one per line
+        torrent_dto_t* dto = NULL;
+        while ((dto = torrent_iter_next(iter, &result))) {
+            printf("%s\t%s\t%s\n", dto->repo_id ? dto->repo_id : "",
+                   dto->name ? dto->name : "",
+                   dto->description ? dto->description : "");
+            fflush(stdout);
+            torrent_dto_free(dto);
+        }
+        torrent_iter_free(iter);
+
+        if (result != API_OK) {
+            g_printerr("Error (%d): Failed to communicate with API.\n",
+                       result);
+            err = result;
+        }
+    }
+
+    // Reset back to global
+    free(argv[0]);
+    argv[0] = argv0;
+    state->next += argc - 1;
+
+    return err;
+}
@@ -9,6 +9,8 @@ static char* command_to_str(type_e cmd) {
             return "start";
         case SEED_STOP:
             return "stop";
+        case SEED_RESUME:
+            return "resume";
         default:
             return "unknown";
     }
@@ -54,3 +56,7 @@ extern int gittor_seed_start(const char* repo_id) {
 extern int gittor_seed_stop(const char* repo_id) {
     return gittor_seed_command(repo_id, SEED_STOP);
 }
+
+extern int gittor_seed_resume(const char* repo_id) {
+    return gittor_seed_command(repo_id, SEED_RESUME);
+}
@@ -28,4 +28,13 @@ extern int gittor_seed_start(const char* repo_id);
  */
 extern int gittor_seed_stop(const char* repo_id);
 
+/**
+ * @brief Start seeding a GitTor repository from the .torrent and resume data
+ * already in the remotes directory, without recreating or rechecking it.
+ *
+ * @param repo_id Repository ID (40-character hex string).
+ * @return int error code
+ */
+extern int gittor_seed_resume(const char* repo_id);
+
 #endif  // SEED_SEED_H_
@@ -113,7 +113,6 @@ extern int gittor_seed(struct argp_state* state) {
     struct seed_arguments args = {0};
     helped = false;
     int err = 0;
-    int ret = -1;
     api_result_e result = API_OK;
     git_repository* repo = NULL;
     torrent_dto_t* torrent_dto = NULL;
@@ -139,13 +138,13 @@ extern int gittor_seed(struct argp_state* state) {
     }
 
     // Initialize libgit2
-    ret = git_libgit2_init();
-    if (ret < 0) {
+    err = gittor_libgit2_init();
+    if (err) {
         goto end;
     }
 
     // Open the local repository
-    err = git_repository_open(&repo, args.global->path);
+    err = gittor_repo_open(&repo, args.global->path);
     if (err) {
         goto end;
     }
@@ -234,10 +233,7 @@ end:
             printf("Error %d/%d: %s\n", err, e->klass, e->message);
         }
     }
-    if (!ret) {
-        git_libgit2_shutdown();
-    }
-    git_repository_free(repo);
+    gittor_repo_close(repo);
     torrent_dto_free(torrent_dto);
 
     // Reset back to global
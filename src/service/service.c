@@ -106,6 +106,7 @@ static gpointer handle_client(gpointer data) {
                 break;
             case SEED_START:
             case SEED_STOP:
+            case SEED_RESUME:
                 reply.len = -1;
                 reply.type = packet.type;
                 reply.data = NULL;
@@ -223,6 +224,10 @@ extern int gittor_service_main() {
     GThread* seed_thread =
         g_thread_new("handle_seeding", handle_seeding, &seed_data);
 
+    // Pick up repositories deleted or updated while the service was down
+    GThread* reconcile_thread =
+        g_thread_new("handle_reconcile", handle_reconcile, cancellable);
+
     // Establish connections
     while (true) {
         // Accept a new connection
@@ -271,6 +276,7 @@ extern int gittor_service_main() {
         g_thread_join(g_ptr_array_index(client_threads, i));
     }
     g_thread_join(seed_thread);
+    g_thread_join(reconcile_thread);
 
     g_ptr_array_free(client_threads, true);
     g_object_unref(socket);
@@ -16,6 +16,8 @@ typedef enum __attribute__((packed)) {
     SERVICE_ERROR,
     SEED_START,
     SEED_STOP,
+    /// @brief Seed an already verified torrent from its saved resume data
+    SEED_RESUME,
 } type_e;
 
 /**
@@ -88,6 +90,14 @@ extern int gittor_service_restart();
  */
 extern const char* gittor_service_status();
 
+/**
+ * @brief Share identical object files between the seeded repositories, and
+ * print the disk usage before and after
+ *
+ * @return int error code
+ */
+extern int gittor_service_dedupe();
+
 /**
  * @brief Disconnect from the GiTtor service if connected
  */
@@ -22,6 +22,7 @@ static const char doc[] =
     "  stop     Ensures the GitTor service is not running\n"
     "  restart  Stops and starts the GitTor service\n"
     "  status   Prints the GitTor service status (up, down)\n"
+    "  dedupe   Shares identical objects between seeded repositories\n"
     "\n"
     "OPTIONS:"
     "\v";
@@ -42,6 +43,8 @@ static error_t parse_opt(int key,
             } else if (strcmp(arg, "status") == 0) {
                 printf("%s\n", gittor_service_status());
                 return 0;
+            } else if (strcmp(arg, "dedupe") == 0) {
+                return gittor_service_dedupe();
             } else if (strcmp(arg, "run") == 0) {  // Hidden command
                 return gittor_service_run(false);
             } else {
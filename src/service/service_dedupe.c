@@ -0,0 +1,344 @@
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "service/service_internals.h"
+#include "utils/utils.h"
+
+// Directory of the remotes dir holding one link to each shared file. Git
+// never writes into an object file, but libtorrent does, so the leecher
+// gives the shared files it may still write their own copies first.
+#define POOL_DIR ".pool"
+
+// Files written more recently than this may still be leeched into
+#define MIN_AGE_SECONDS (10 * 60)
+
+#define READ_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+    gchar* path;
+    dev_t dev;
+    ino_t ino;
+    /// @brief Content hash, known up front for files in the pool
+    gchar* hash;
+} file_t;
+
+static void file_free(file_t* file) {
+    g_free(file->path);
+    g_free(file->hash);
+    g_free(file);
+}
+
+static gchar* inode_key(dev_t dev, ino_t ino) {
+    return g_strdup_printf("%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT,
+                           (guint64)dev, (guint64)ino);
+}
+
+// Bytes allocated on disk below a path, counting each file only once however
+// many links it has
+static guint64 disk_usage(const char* path, GHashTable* seen) {
+    GStatBuf st;
+    if (g_lstat(path, &st)) {
+        return 0;
+    }
+
+    guint64 usage = 0;
+    gchar* key = inode_key(st.st_dev, st.st_ino);
+    if (!g_hash_table_contains(seen, key)) {
+        usage += (guint64)st.st_blocks * 512;
+        g_hash_table_add(seen, key);
+    } else {
+        g_free(key);
+    }
+
+    GDir* dir = S_ISDIR(st.st_mode) ? g_dir_open(path, 0, NULL) : NULL;
+    const gchar* name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        gchar* child = g_build_filename(path, name, NULL);
+        usage += disk_usage(child, seen);
+        g_free(child);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+    return usage;
+}
+
+static guint64 total_usage(const char* dir) {
+    GHashTable* seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             NULL);
+    guint64 usage = disk_usage(dir, seen);
+    g_hash_table_destroy(seen);
+    return usage;
+}
+
+static gchar* hash_file(const char* path) {
+    FILE* fp = g_fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+
+    GChecksum* checksum = g_checksum_new(G_CHECKSUM_SHA256);
+    guchar* buffer = g_malloc(READ_BUFFER_SIZE);
+    size_t len = 0;
+    while ((len = fread(buffer, 1, READ_BUFFER_SIZE, fp)) > 0) {
+        g_checksum_update(checksum, buffer, len);
+    }
+    gchar* hash = ferror(fp) ? NULL : g_strdup(g_checksum_get_string(checksum));
+
+    g_free(buffer);
+    g_checksum_free(checksum);
+    fclose(fp);
+    return hash;
+}
+
+// Group a file with the others of the same size, the only ones it can share
+// its contents with
+static void add_file(GHashTable* sizes,
+                     const char* path,
+                     const GStatBuf* st,
+                     const char* hash) {
+    file_t* file = g_new0(file_t, 1);
+    file->path = g_strdup(path);
+    file->dev = st->st_dev;
+    file->ino = st->st_ino;
+    file->hash = g_strdup(hash);
+
+    gint64 size = (gint64)st->st_size;
+    GPtrArray* files = g_hash_table_lookup(sizes, &size);
+    if (!files) {
+        gint64* key = g_new(gint64, 1);
+        *key = size;
+        files = g_ptr_array_new_with_free_func((GDestroyNotify)file_free);
+        g_hash_table_insert(sizes, key, files);
+    }
+    g_ptr_array_add(files, file);
+}
+
+// Only files git never changes once written, and that are already whole
+static void add_object(GHashTable* sizes,
+                       const char* path,
+                       dedupe_report_t* report) {
+    GStatBuf st;
+    if (g_lstat(path, &st) || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return;
+    }
+
+    // Leeched files are allocated sparse and filled in as pieces arrive
+    gint64 age = g_get_real_time() / G_USEC_PER_SEC - (gint64)st.st_mtime;
+    if ((guint64)st.st_blocks * 512 < (guint64)st.st_size ||
+        age < MIN_AGE_SECONDS) {
+        return;
+    }
+
+    report->files++;
+    add_file(sizes, path, &st, NULL);
+}
+
+static gboolean is_loose_dir(const char* name) {
+    return strlen(name) == 2 && g_ascii_isxdigit(name[0]) &&
+           g_ascii_isxdigit(name[1]);
+}
+
+static void add_repo(GHashTable* sizes,
+                     const char* repo,
+                     dedupe_report_t* report) {
+    gchar* objects = g_build_filename(repo, "objects", NULL);
+    GDir* dir = g_dir_open(objects, 0, NULL);
+    const gchar* name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        gchar* sub = g_build_filename(objects, name, NULL);
+        bool packs = strcmp(name, "pack") == 0;
+        GDir* files = packs || is_loose_dir(name) ? g_dir_open(sub, 0, NULL)
+                                                  : NULL;
+        const gchar* file = NULL;
+        while (files && (file = g_dir_read_name(files))) {
+            if (packs && !g_str_has_suffix(file, ".pack") &&
+                !g_str_has_suffix(file, ".idx") &&
+                !g_str_has_suffix(file, ".rev")) {
+                continue;
+            }
+            gchar* path = g_build_filename(sub, file, NULL);
+            add_object(sizes, path, report);
+            g_free(path);
+        }
+        if (files) {
+            g_dir_close(files);
+        }
+        g_free(sub);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+    g_free(objects);
+}
+
+// Drop pooled files no repository links to anymore, and group the rest
+static void add_pool(GHashTable* sizes, const char* pool) {
+    GDir* dir = g_dir_open(pool, 0, NULL);
+    const gchar* name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        gchar* sub = g_build_filename(pool, name, NULL);
+        GDir* files = g_dir_open(sub, 0, NULL);
+        const gchar* file = NULL;
+        while (files && (file = g_dir_read_name(files))) {
+            gchar* path = g_build_filename(sub, file, NULL);
+            gchar* hash = g_strconcat(name, file, NULL);
+            GStatBuf st;
+            if (!g_lstat(path, &st) && S_ISREG(st.st_mode)) {
+                if (st.st_nlink > 1) {
+                    add_file(sizes, path, &st, hash);
+                } else {
+                    g_remove(path);
+                }
+            }
+            g_free(hash);
+            g_free(path);
+        }
+        if (files) {
+            g_dir_close(files);
+        }
+        g_rmdir(sub);  // Only if emptied
+        g_free(sub);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+}
+
+// Replace a file with a link to another, atomically, so that it is never
+// missing for the seeder or git
+static int replace_with_link(const char* target, const char* path) {
+    gchar* tmp = g_strconcat(path, ".dedupe", NULL);
+    g_remove(tmp);
+    int error = link(target, tmp);
+    if (!error) {
+        error = g_rename(tmp, path);
+        if (error) {
+            g_remove(tmp);
+        }
+    }
+    g_free(tmp);
+    return error;
+}
+
+// Link every file of a group with the same contents to one pooled copy
+static void dedupe_group(GPtrArray* files,
+                         const char* pool,
+                         dedupe_report_t* report) {
+    GHashTable* hashes = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, g_free);
+    GHashTable* pooled = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                               g_free, g_free);
+
+    // Files that are already links to each other are only read once
+    for (guint i = 0; i < files->len; i++) {
+        file_t* file = g_ptr_array_index(files, i);
+        gchar* key = inode_key(file->dev, file->ino);
+        const gchar* hash = g_hash_table_lookup(hashes, key);
+        if (!file->hash) {
+            file->hash = hash ? g_strdup(hash) : hash_file(file->path);
+        }
+        if (file->hash && !hash) {
+            g_hash_table_insert(hashes, key, g_strdup(file->hash));
+        } else {
+            g_free(key);
+        }
+        if (file->hash && g_str_has_prefix(file->path, pool)) {
+            g_hash_table_insert(pooled, g_strdup(file->hash),
+                                g_strdup(file->path));
+        }
+    }
+
+    for (guint i = 0; i < files->len; i++) {
+        file_t* file = g_ptr_array_index(files, i);
+        if (!file->hash || g_str_has_prefix(file->path, pool)) {
+            continue;
+        }
+
+        // The first copy found becomes the pooled one
+        const gchar* target = g_hash_table_lookup(pooled, file->hash);
+        if (!target) {
+            gchar prefix[3] = {file->hash[0], file->hash[1], '\0'};
+            gchar* sub = g_build_filename(pool, prefix, NULL);
+            gchar* path = g_build_filename(sub, file->hash + 2, NULL);
+            g_mkdir_with_parents(sub, 0755);
+            if (!link(file->path, path)) {
+                g_hash_table_insert(pooled, g_strdup(file->hash), path);
+                path = NULL;
+            }
+            g_free(path);
+            g_free(sub);
+            continue;
+        }
+
+        GStatBuf st;
+        if (!g_lstat(target, &st) &&
+            (st.st_dev != file->dev || st.st_ino != file->ino) &&
+            !replace_with_link(target, file->path)) {
+            report->linked++;
+        }
+    }
+
+    g_hash_table_destroy(pooled);
+    g_hash_table_destroy(hashes);
+}
+
+extern int gittor_service_dedupe_dir(const char* dir,
+                                     dedupe_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    report->before = total_usage(dir);
+
+    // Every seeded repository has a .torrent named after it, anything else
+    // is either being leeched or not a repository
+    gchar* pool = g_build_filename(dir, POOL_DIR, NULL);
+    GHashTable* sizes = g_hash_table_new_full(
+        g_int64_hash, g_int64_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    add_pool(sizes, pool);
+    GDir* handle = g_dir_open(dir, 0, NULL);
+    const gchar* name = NULL;
+    while (handle && (name = g_dir_read_name(handle))) {
+        gchar* repo = g_build_filename(dir, name, NULL);
+        gchar* torrent = g_strconcat(repo, ".torrent", NULL);
+        if (name[0] != '.' && g_file_test(repo, G_FILE_TEST_IS_DIR) &&
+            g_file_test(torrent, G_FILE_TEST_IS_REGULAR)) {
+            add_repo(sizes, repo, report);
+        }
+        g_free(torrent);
+        g_free(repo);
+    }
+    if (handle) {
+        g_dir_close(handle);
+    }
+
+    // Only files of the same size can have the same contents
+    GHashTableIter iter;
+    gpointer files = NULL;
+    g_hash_table_iter_init(&iter, sizes);
+    while (g_hash_table_iter_next(&iter, NULL, &files)) {
+        if (((GPtrArray*)files)->len > 1) {
+            dedupe_group(files, pool, report);
+        }
+    }
+
+    g_hash_table_destroy(sizes);
+    g_free(pool);
+    report->after = total_usage(dir);
+    return 0;
+}
+
+extern int gittor_service_dedupe() {
+    dedupe_report_t report;
+    int error = gittor_service_dedupe_dir(gittor_remote_dir(), &report);
+
+    gchar* before = g_format_size(report.before);
+    gchar* after = g_format_size(report.after);
+    printf("Linked %u of %u object files to shared copies\n", report.linked,
+           report.files);
+    printf("Disk usage: %s before, %s after\n", before, after);
+    g_free(after);
+    g_free(before);
+    return error;
+}
@@ -38,6 +38,65 @@ typedef struct {
     int error_code;
 } seed_thread_queue_item_t;
 
+/// @brief Outcome of reconciling the seeded repositories with the server
+typedef struct {
+    /// @brief Repositories the server answered for
+    guint checked;
+    /// @brief Repositories deleted or with a newer version on the server
+    guint stale;
+    /// @brief Repositories deleted from the server
+    guint deleted;
+    /// @brief Repositories that couldn't be looked up
+    guint failed;
+} reconcile_report_t;
+
+/**
+ * @brief Look up every repository seeded from a directory on the server, and
+ * download the .torrent of each one it still has in the same batch, to find
+ * the ones deleted or updated since they were seeded
+ *
+ * @param dir The directory holding the repositories and their .torrent files
+ * @param report Output for the outcome
+ * @return int 0 if done, non-zero if some repositories couldn't be looked up
+ * and it should be retried
+ */
+extern int gittor_service_reconcile(const char* dir,
+                                    reconcile_report_t* report);
+
+/// @brief Outcome of sharing identical object files between repositories
+typedef struct {
+    /// @brief Bytes on disk under the directory before
+    guint64 before;
+    /// @brief Bytes on disk under the directory after
+    guint64 after;
+    /// @brief Object files that could be shared
+    guint files;
+    /// @brief Object files replaced by a link to an identical one
+    guint linked;
+} dedupe_report_t;
+
+/**
+ * @brief Hardlink the identical object and pack files of the repositories
+ * seeded from a directory to a single copy, kept in a pool named after its
+ * contents. Each repository keeps every file, byte for byte, so its torrent
+ * stays valid.
+ *
+ * @param dir The directory holding the repositories and their .torrent files
+ * @param report Output for the outcome
+ * @return int error code
+ */
+extern int gittor_service_dedupe_dir(const char* dir,
+                                     dedupe_report_t* report);
+
+/**
+ * @brief Thread function to reconcile the seeded repositories with the server,
+ * retrying until the server could be reached
+ *
+ * @param data GCancellable stopping the thread
+ * @return gpointer NULL
+ */
+extern gpointer handle_reconcile(gpointer data);
+
 /**
  * @brief Thread function to handle seeding torrent repositories
  *
@@ -0,0 +1,186 @@
+#include <git2.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "api/torrents.h"
+#include "service/service_internals.h"
+#include "utils/utils.h"
+
+// How long to wait before reconciling again after the API was unreachable
+#define RECONCILE_RETRY_SECONDS 60
+
+typedef struct {
+    /// @brief The batch the lookups run in, the .torrent files are
+    /// downloaded in it too
+    api_multi_t* multi;
+    const char* dir;
+    reconcile_report_t* report;
+} reconcile_t;
+
+/**
+ * @brief A repository the server still has, whose .torrent is downloaded
+ * next to ours to compare them
+ */
+typedef struct {
+    reconcile_t* reconcile;
+    gchar* repo_id;
+    gchar* ours;
+    gchar* theirs;
+} torrent_check_t;
+
+static gboolean is_repo_id(const char* name, size_t len) {
+    if (len != GIT_OID_HEXSZ) {
+        return FALSE;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!g_ascii_isxdigit(name[i])) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void torrent_check_free(torrent_check_t* check) {
+    g_free(check->theirs);
+    g_free(check->ours);
+    g_free(check->repo_id);
+    g_free(check);
+}
+
+// The server has a newer version if its .torrent differs from ours. Both are
+// the exact same bytes while nothing changed: the seeder uploads the file it
+// wrote and the leecher writes the one it downloaded. Neither the time of
+// the upload nor edits to the name or description tell that much.
+static void on_torrent_file(api_result_e result,
+                            const response_buf_t* response,
+                            void* userdata) {
+    (void)response;
+    torrent_check_t* check = userdata;
+    reconcile_report_t* report = check->reconcile->report;
+    gchar* our_data = NULL;
+    gchar* their_data = NULL;
+    gsize our_len = 0;
+    gsize their_len = 0;
+
+    if (result != API_OK ||
+        !g_file_get_contents(check->ours, &our_data, &our_len, NULL) ||
+        !g_file_get_contents(check->theirs, &their_data, &their_len, NULL)) {
+        report->failed++;
+    } else {
+        report->checked++;
+        if (our_len != their_len || memcmp(our_data, their_data, our_len)) {
+            g_print("[GitTor Service] Repository %s has a new version\n",
+                    check->repo_id);
+            report->stale++;
+        }
+    }
+
+    g_remove(check->theirs);
+    g_free(their_data);
+    g_free(our_data);
+    torrent_check_free(check);
+}
+
+static void on_repo(const char* repo_id,
+                    api_result_e result,
+                    torrent_dto_t* dto,
+                    void* userdata) {
+    reconcile_t* reconcile = userdata;
+    reconcile_report_t* report = reconcile->report;
+
+    if (result == API_NOT_FOUND) {
+        g_print("[GitTor Service] Repository %s was deleted\n", repo_id);
+        report->checked++;
+        report->stale++;
+        report->deleted++;
+    } else if (result != API_OK) {
+        report->failed++;
+    } else {
+        // Then compare its .torrent, fetched in the same batch
+        torrent_check_t* check = g_new0(torrent_check_t, 1);
+        gchar* name = g_strconcat(repo_id, ".torrent", NULL);
+        check->reconcile = reconcile;
+        check->repo_id = g_strdup(repo_id);
+        check->ours = g_build_filename(reconcile->dir, name, NULL);
+        check->theirs = g_strconcat(check->ours, ".reconcile", NULL);
+        g_free(name);
+        if (api_multi_get_torrent_file(reconcile->multi, dto->id,
+                                       check->theirs, on_torrent_file,
+                                       check)) {
+            report->failed++;
+            torrent_check_free(check);
+        }
+    }
+
+    torrent_dto_free(dto);
+}
+
+extern int gittor_service_reconcile(const char* dir,
+                                    reconcile_report_t* report) {
+    memset(report, 0, sizeof(*report));
+
+    // Every seeded repository has a .torrent named after its ID
+    GPtrArray* seeded = g_ptr_array_new_with_free_func(g_free);
+    GDir* handle = g_dir_open(dir, 0, NULL);
+    const gchar* name = NULL;
+    while (handle && (name = g_dir_read_name(handle))) {
+        const char* ext = strrchr(name, '.');
+        if (ext && strcmp(ext, ".torrent") == 0 &&
+            is_repo_id(name, (size_t)(ext - name))) {
+            g_ptr_array_add(seeded, g_strndup(name, ext - name));
+        }
+    }
+    if (handle) {
+        g_dir_close(handle);
+    }
+
+    guint count = seeded->len;
+    int error = 0;
+    if (count > 0) {
+        api_result_e result = API_OK;
+        reconcile_t reconcile = {.multi = api_multi_new(&result),
+                                 .dir = dir,
+                                 .report = report};
+        error = api_get_torrents_by_repo_ids(reconcile.multi,
+                                             (const char**)seeded->pdata,
+                                             count, on_repo, &reconcile);
+        api_multi_free(reconcile.multi);
+
+        // Without a session there is nothing to retry until the user logs in
+        if (error && result != API_CURL_ERR) {
+            error = 0;
+        }
+    }
+    if (!error && report->failed) {
+        error = -1;
+    }
+    if (count > 0) {
+        g_print("[GitTor Service] Reconciled %u of %u repositories, %u stale "
+                "(%u deleted)\n",
+                report->checked, count, report->stale, report->deleted);
+    }
+
+    g_ptr_array_unref(seeded);
+    return error;
+}
+
+extern gpointer handle_reconcile(gpointer data) {
+    GCancellable* cancellable = data;
+
+    // Reconcile once at startup, and again once the API can be reached if
+    // some repositories couldn't be checked
+    while (!g_cancellable_is_cancelled(cancellable)) {
+        reconcile_report_t report;
+        if (!gittor_service_reconcile(gittor_remote_dir(), &report)) {
+            break;
+        }
+        for (int i = 0; i < RECONCILE_RETRY_SECONDS * 5 &&
+                        !g_cancellable_is_cancelled(cancellable);
+             i++) {
+            g_usleep(200UL * 1000UL);  // 200 ms
+        }
+    }
+
+    return NULL;
+}
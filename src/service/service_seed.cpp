@@ -7,7 +7,8 @@
 #include <git2.h>  // NOLINT(build/include_order)
 #include <glib.h>  // NOLINT(build/include_order)
 #include <iostream>
-#include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <utility>
@@ -25,7 +26,7 @@
 #include <libtorrent/read_resume_data.hpp>
 #include <libtorrent/session.hpp>
 #include <libtorrent/session_params.hpp>
-#include <libtorrent/span.hpp>
+#include <libtorrent/torrent_flags.hpp>
 #include <libtorrent/torrent_handle.hpp>
 #include <libtorrent/torrent_status.hpp>
 #include <libtorrent/write_resume_data.hpp>
@@ -35,6 +36,8 @@ extern "C" {
 #include "service/service_internals.h"
 #include "utils/utils.h"
 }
+#include "utils/mapped_file.h"
+#include "utils/session.h"
 
 namespace fs = std::filesystem;
 
@@ -71,12 +74,6 @@ char const* state(lt::torrent_status::state_t s) {
     }
 }
 
-std::vector<char> load_file(const char* filename) {
-    std::ifstream ifs(filename, std::ios_base::binary);
-    ifs.unsetf(std::ios_base::skipws);
-    return {std::istream_iterator<char>(ifs), std::istream_iterator<char>()};
-}
-
 void load_torrent(torrent_t& t, const fs::directory_entry& file) {
     // torrent_name
     const std::string torrent_name = file.path().stem().string();
@@ -139,7 +136,7 @@ int get_creator(char* buf, size_t size) {
     const char* email = nullptr;
     std::string creator = "GitTor";
 
-    if (git_libgit2_init() < 0) {
+    if (gittor_libgit2_init()) {
         error = -1;
     }
 
@@ -166,10 +163,56 @@ int get_creator(char* buf, size_t size) {
     g_strlcpy(buf, creator.c_str(), size);
 
     git_config_free(snapshot);
-    git_libgit2_shutdown();
     return error;
 }
 
+// add a repository's .torrent to the session, resuming from its saved resume
+// data when it matches
+int add_torrent(lt::session& ses,
+                std::deque<torrent_t>& torrents,
+                const std::string& torrent_path,
+                bool just_created) try {
+    const fs::directory_entry entry(torrent_path);
+    torrent_t t;
+    load_torrent(t, entry);
+
+    const mapped_file torrent_file = map_file(t.torrent_path);
+    if (!torrent_file) {
+        throw std::runtime_error(std::string("Missing torrent file: ") +
+                                 t.torrent_path);
+    }
+    lt::add_torrent_params atp =
+        lt::load_torrent_buffer(file_span(torrent_file));
+
+    bool resumed = false;
+    const mapped_file resume_file = map_file(t.resume_path);
+    if (resume_file) {
+        lt::add_torrent_params resume_atp =
+            lt::read_resume_data(file_span(resume_file));
+        if (atp.info_hashes == resume_atp.info_hashes) {
+            atp = std::move(resume_atp);
+            resumed = true;
+        }
+    }
+
+    // The piece hashes were just computed from these exact files, so skip the
+    // recheck and only verify pieces lazily as peers request them
+    if (just_created && !resumed) {
+        atp.flags |= lt::torrent_flags::seed_mode;
+    }
+
+    // store the torrent so its address is stable and use that for userdata
+    torrents.push_back(std::move(t));
+    torrent_t* stored = &torrents.back();
+    atp.save_path = stored->save_path;
+    atp.userdata = stored;
+    ses.async_add_torrent(atp);
+    return 0;
+} catch (std::exception& e) {
+    std::cerr << "Error Adding Torrent: " << e.what() << '\n';
+    return 1;
+}
+
 }  // anonymous namespace
 
 extern "C" gpointer handle_seeding(gpointer data) {
@@ -202,39 +245,23 @@ extern "C" gpointer handle_seeding(gpointer data) {
                                 lt::alert_category::status);
 
     // Set up network
-    const config_id_t port_config = {.group = "network", .key = "port"};
-    char* port_str = config_get(CONFIG_SCOPE_GLOBAL, &port_config, NULL);
-    if (port_str != NULL) {
-        const std::string listen_interfaces =
-            std::string("0.0.0.0:") + port_str;
-        params.settings.set_str(lt::settings_pack::listen_interfaces,
-                                listen_interfaces);
-        free(port_str);
-    }
+    gittor_network_settings(params.settings);
 
     // Start the session
     lt::session ses(params);
+    gittor_network_session(ses);
+
+    // Apply network settings as they change, rather than on a restart that
+    // would drop every peer and announce every repository again
+    gchar* config_path = global_config_path();
+    config_watch_t* config_watch = config_watch_new(config_path);
+    g_free(config_path);
 
     // Load the torrents into a deque so addresses remain stable when
     // adding/removing
-    std::vector<torrent_t> initial = find_torrents(dir);
     std::deque<torrent_t> torrents;
-    for (torrent_t& t0 : initial) {
-        torrents.push_back(std::move(t0));
-    }
-    for (torrent_t& t : torrents) {
-        lt::entry::preformatted_type buf = load_file(t.resume_path);
-        lt::add_torrent_params atp = lt::load_torrent_file(t.torrent_path);
-
-        if (buf.size()) {
-            lt::add_torrent_params resume_atp = lt::read_resume_data(buf);
-            if (atp.info_hashes == resume_atp.info_hashes)
-                atp = std::move(resume_atp);
-        }
-
-        atp.save_path = t.save_path;
-        atp.userdata = &t;
-        ses.async_add_torrent(atp);
+    for (const torrent_t& t : find_torrents(dir)) {
+        add_torrent(ses, torrents, t.torrent_path, false);
     }
 
     // Seed the torrents
@@ -301,6 +328,14 @@ extern "C" gpointer handle_seeding(gpointer data) {
 
         std::this_thread::sleep_for(std::chrono::milliseconds(200));
 
+        if (config_watch_changed(config_watch)) {
+            std::clog << "[GitTor Service thread=";
+            std::clog << reinterpret_cast<void*>(g_thread_self());
+            std::clog << "] Config changed, applying network settings\n";
+            std::clog.flush();
+            gittor_network_reload(ses);
+        }
+
         // ask the session to post a state_update_alert, to update our
         // state output for the torrent
         ses.post_torrent_updates();
@@ -326,34 +361,28 @@ extern "C" gpointer handle_seeding(gpointer data) {
                     // Create the torrent file on disk
                     gittor_remote_path(
                         remote_dir, reinterpret_cast<char*>(item->packet.data));
-                    create_torrent(remote_dir);
+                    if (create_torrent(remote_dir)) {
+                        item->error_code = 1;
+                        break;
+                    }
 
-                    // Load the .torrent and add it to the session using a
-                    // stable storage
+                    // Load the .torrent and add it to the session
                     const std::string torrent_path =
                         std::string(remote_dir) + ".torrent";
-                    const fs::directory_entry entry(torrent_path);
-                    torrent_t t;
-                    load_torrent(t, entry);
-
-                    lt::entry::preformatted_type buf = load_file(t.resume_path);
-                    lt::add_torrent_params atp =
-                        lt::load_torrent_file(t.torrent_path);
-                    if (buf.size()) {
-                        lt::add_torrent_params resume_atp =
-                            lt::read_resume_data(buf);
-                        if (atp.info_hashes == resume_atp.info_hashes)
-                            atp = std::move(resume_atp);
-                    }
+                    item->error_code =
+                        add_torrent(ses, torrents, torrent_path, true);
+                    break;
+                }
 
-                    // store the torrent so its address is stable and use that
-                    // for userdata
-                    torrents.push_back(std::move(t));
-                    torrent_t* stored = &torrents.back();
-                    atp.save_path = stored->save_path;
-                    atp.userdata = stored;
-                    ses.async_add_torrent(atp);
-                    item->error_code = 0;
+                case SEED_RESUME: {
+                    // The leecher already verified every piece and left its
+                    // .torrent and resume data behind, so seed those as-is
+                    gittor_remote_path(
+                        remote_dir, reinterpret_cast<char*>(item->packet.data));
+                    const std::string torrent_path =
+                        std::string(remote_dir) + ".torrent";
+                    item->error_code =
+                        add_torrent(ses, torrents, torrent_path, false);
                     break;
                 }
 
@@ -395,6 +424,8 @@ extern "C" gpointer handle_seeding(gpointer data) {
         }
     }
 
+    config_watch_free(config_watch);
+
     if (old_clog_buf) {
         std::clog.rdbuf(old_clog_buf);
     }
@@ -415,20 +446,12 @@ extern "C" int create_torrent(char path[PATH_MAX]) try {
 
     // Get the list of trackers from the config
     lt::create_torrent t(fs);
-    config_id_t config_id = {.group = "network", .key = NULL};
-
-    for (int i = 1; i < 100; i++) {
-        char key[32];
-        g_snprintf(key, sizeof(key), "tracker%d", i);
-        config_id.key = key;
-        char* tracker = config_get(CONFIG_SCOPE_GLOBAL, &config_id, NULL);
-
-        if (tracker == NULL) {
-            break;
-        }
-        t.add_tracker(tracker);
-        free(tracker);
+    const config_id_t config_id = {.group = "network", .key = "tracker"};
+    gchar** trackers = config_get_list(CONFIG_SCOPE_GLOBAL, &config_id);
+    for (gchar** tracker = trackers; *tracker; tracker++) {
+        t.add_tracker(*tracker);
     }
+    g_strfreev(trackers);
 
     // Set the creator
     char creator[256];
@@ -0,0 +1,44 @@
+#ifndef UTILS_MAPPED_FILE_H_
+#define UTILS_MAPPED_FILE_H_
+
+// C++ only, shared by the leecher and the seeder
+
+#include <glib.h>  // NOLINT(build/include_order)
+#include <cstddef>
+#include <memory>
+#include <libtorrent/span.hpp>
+
+extern "C" {
+#include "utils/utils.h"
+}
+
+/// @brief A file mapped into memory, unmapped when it goes out of scope
+using mapped_file =
+    std::unique_ptr<GMappedFile, decltype(&g_mapped_file_unref)>;
+
+/**
+ * @brief Map a file into memory.
+ *
+ * @param filename The file to map
+ * @return mapped_file The mapping, empty if the file is missing or empty
+ */
+inline mapped_file map_file(const char* filename) {
+    return {gittor_map_file(filename), &g_mapped_file_unref};
+}
+
+/**
+ * @brief View the contents of a mapped file, so libtorrent can decode it in
+ * place.
+ *
+ * @param file The mapped file
+ * @return lt::span<const char> Its contents, empty if it isn't mapped
+ */
+inline lt::span<const char> file_span(const mapped_file& file) {
+    if (!file) {
+        return {};
+    }
+    return {g_mapped_file_get_contents(file.get()),
+            static_cast<std::ptrdiff_t>(g_mapped_file_get_length(file.get()))};
+}
+
+#endif  // UTILS_MAPPED_FILE_H_
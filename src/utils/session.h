@@ -0,0 +1,42 @@
+#ifndef UTILS_SESSION_H_
+#define UTILS_SESSION_H_
+
+// C++ only, shared by the leecher and the seeder
+
+#include <libtorrent/ip_filter.hpp>
+#include <libtorrent/session.hpp>
+#include <libtorrent/settings_pack.hpp>
+
+/**
+ * @brief Apply the network configuration to the settings of a session about
+ * to be created: the listen port, local service discovery and LAN only mode.
+ *
+ * @param settings The settings to update
+ */
+void gittor_network_settings(lt::settings_pack& settings);
+
+/**
+ * @brief Get the filter of LAN only mode, which blocks every address but the
+ * loopback, private and link-local ones.
+ *
+ * @return lt::ip_filter The filter
+ */
+lt::ip_filter gittor_lan_filter();
+
+/**
+ * @brief Apply the network configuration that needs a running session. In
+ * LAN only mode all addresses outside the local network are filtered out.
+ *
+ * @param ses The session to configure
+ */
+void gittor_network_session(lt::session& ses);
+
+/**
+ * @brief Apply the network configuration again to a running session, after
+ * it changed. Peers stay connected unless the port changed.
+ *
+ * @param ses The session to configure
+ */
+void gittor_network_reload(lt::session& ses);
+
+#endif  // UTILS_SESSION_H_
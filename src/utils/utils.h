@@ -2,10 +2,42 @@
 #define UTILS_UTILS_H_
 
 #include <git2.h>
+#include <glib.h>
 #include <limits.h>
 
 /**
- * @brief Get a repositories unique identifier.
+ * @brief Initialize libgit2 for the rest of the process, the first time it is
+ * called. It is shut down at exit, along with the repositories still open.
+ *
+ * @return int error code
+ */
+extern int gittor_libgit2_init();
+
+/**
+ * @brief Open a repository, reusing a handle closed with gittor_repo_close()
+ * if there is one. Reused handles keep their object database, so the pack
+ * indexes aren't read again. A repository deleted or replaced at the same path
+ * since is opened afresh. The handle is the caller's alone until closed.
+ *
+ * @param out Output for the repository
+ * @param path Path to the working directory or the git directory
+ * @return int error code
+ */
+extern int gittor_repo_open(git_repository** out, const char* path);
+
+/**
+ * @brief Close a repository, keeping it open for the next gittor_repo_open()
+ * of the same path. Only the few most recently used are kept.
+ *
+ * @param repo Repository to close (can be NULL)
+ */
+extern void gittor_repo_close(git_repository* repo);
+
+/**
+ * @brief Get a repositories unique identifier, the ID of its first commit.
+ * It is read from gittor.repoid in the repository's config when that still
+ * names a root commit, and otherwise found by walking the whole history and
+ * recorded there.
  *
  * @param repo_id Output buffer for repository ID
  * @param repo Repository
@@ -14,10 +46,64 @@
 extern int gittor_get_repo_id(char* repo_id, size_t n, git_repository* repo);
 
 /**
- * @brief Push the repository to the remote.
+ * @brief Record a repository's unique identifier in its config, so that
+ * gittor_get_repo_id() doesn't need to walk its history.
+ *
+ * @param repo Repository
+ * @param repo_id The repository ID
+ * @return int error code
+ */
+extern int gittor_set_repo_id(git_repository* repo, const char* repo_id);
+
+/**
+ * @brief Push the repository to the remote. A remote on this machine is
+ * fast-forwarded directly, hardlinking the objects into it where possible.
  */
 extern int gittor_git_push(git_repository* repo);
 
+/**
+ * @brief Hardlink the packs and loose objects of one repository into another
+ * on the same filesystem, skipping the ones it already has. A fetch between
+ * the two then only has to update references. Git never writes into an
+ * object file once it exists, but the leecher does, so it unshares the
+ * files it may still write with gittor_unshare_file before leeching.
+ *
+ * @param destination Repository to link the objects into
+ * @param source Repository to take the objects from
+ * @return int Number of files linked, negative on error
+ */
+extern int gittor_git_link_objects(git_repository* destination,
+                                   git_repository* source);
+
+/**
+ * @brief Give a file that has other hardlinks its own copy, so that writing
+ * into it in place leaves the other links untouched.
+ *
+ * @param path File to unshare
+ * @return int 1 if it was copied, 0 if it had no other links or is missing,
+ * negative on error
+ */
+extern int gittor_unshare_file(const char* path);
+
+/**
+ * @brief Unshare every file below a directory with gittor_unshare_file.
+ *
+ * @param path Directory to walk
+ * @return int Number of files copied, negative on error
+ */
+extern int gittor_unshare_files(const char* path);
+
+/**
+ * @brief Check out HEAD into the empty working tree of a fresh clone,
+ * inflating and writing the files on a pool of worker threads. Falls back
+ * to libgit2's serial checkout when the files need filters or line ending
+ * conversions.
+ *
+ * @param repo Repository to check out
+ * @return int error code
+ */
+extern int gittor_git_checkout(git_repository* repo);
+
 /**
  * @brief Get the directory containing all the repository remotes.
  *
@@ -34,4 +120,13 @@ extern const char* gittor_remote_dir();
  */
 extern int gittor_remote_path(char buf[PATH_MAX], const char* repo_id);
 
+/**
+ * @brief Map a file read-only into memory so it can be parsed in place.
+ *
+ * @param path Path to the file
+ * @return GMappedFile* The mapped file, or NULL if it is missing or empty.
+ * Caller must release it with g_mapped_file_unref().
+ */
+extern GMappedFile* gittor_map_file(const char* path);
+
 #endif  // UTILS_UTILS_H_
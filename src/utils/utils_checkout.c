@@ -0,0 +1,320 @@
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include <errno.h>
+#include <git2.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "utils/utils.h"
+
+typedef struct {
+    gchar* path;
+    git_oid id;
+    git_filemode_t mode;
+    GStatBuf st;
+} checkout_file_t;
+
+typedef struct {
+    const char* workdir;
+    gchar* objects;
+    GPtrArray* files;
+    gboolean symlinks;
+    guint workers;
+    gint failed;
+} checkout_t;
+
+static void free_file(gpointer data) {
+    checkout_file_t* file = data;
+    g_free(file->path);
+    g_free(file);
+}
+
+// Whether an attributes file is in one of libgit2's search paths, which is
+// where it looks for the ones outside the repository
+static gboolean has_attributes(git_config_level_t level, const char* name) {
+    git_buf buf = {0};
+    gboolean found = FALSE;
+    if (!git_libgit2_opts(GIT_OPT_GET_SEARCH_PATH, level, &buf) && buf.ptr) {
+        gchar** dirs = g_strsplit(buf.ptr, G_SEARCHPATH_SEPARATOR_S, -1);
+        for (gchar** dir = dirs; !found && *dir; dir++) {
+            gchar* path = g_build_filename(*dir, name, NULL);
+            found = **dir && g_file_test(path, G_FILE_TEST_IS_REGULAR);
+            g_free(path);
+        }
+        g_strfreev(dirs);
+    }
+    git_buf_dispose(&buf);
+    return found;
+}
+
+// Filters and line ending conversions are left to libgit2's own checkout
+static gboolean needs_filters(git_repository* repo, git_config* cfg) {
+    const char* value = NULL;
+    if (!git_config_get_string(&value, cfg, "core.autocrlf") &&
+        g_ascii_strcasecmp(value, "false") != 0) {
+        return TRUE;
+    }
+    if (!git_config_get_string(&value, cfg, "core.attributesfile")) {
+        return TRUE;
+    }
+
+    // Attributes from outside the tree: the repository's own, the user's in
+    // $XDG_CONFIG_HOME/git/attributes and the system's
+    gchar* info = g_build_filename(git_repository_path(repo), "info",
+                                   "attributes", NULL);
+    gboolean found = g_file_test(info, G_FILE_TEST_IS_REGULAR) ||
+                     has_attributes(GIT_CONFIG_LEVEL_XDG, "attributes") ||
+                     has_attributes(GIT_CONFIG_LEVEL_SYSTEM, "gitattributes");
+    g_free(info);
+    return found;
+}
+
+// Collect the files of the tree, creating the directories as they are
+// walked so the workers never race to create the same one
+static int collect(const char* root, const git_tree_entry* entry, void* p) {
+    checkout_t* checkout = p;
+    const char* name = git_tree_entry_name(entry);
+    git_filemode_t mode = git_tree_entry_filemode(entry);
+    int error = 0;
+
+    if (strcmp(name, ".gitattributes") == 0 ||
+        (mode == GIT_FILEMODE_LINK && !checkout->symlinks)) {
+        return GIT_PASSTHROUGH;
+    }
+
+    // Submodules are left as empty directories, same as git does
+    gchar* path = g_strconcat(root, name, NULL);
+    if (mode == GIT_FILEMODE_TREE || mode == GIT_FILEMODE_COMMIT) {
+        gchar* dir = g_build_filename(checkout->workdir, path, NULL);
+        if (g_mkdir_with_parents(dir, 0777)) {
+            git_error_set_str(GIT_ERROR_OS, g_strerror(errno));
+            error = -1;
+        }
+        g_free(dir);
+        g_free(path);
+    } else {
+        checkout_file_t* file = g_new0(checkout_file_t, 1);
+        file->path = path;
+        file->mode = mode;
+        git_oid_cpy(&file->id, git_tree_entry_id(entry));
+        g_ptr_array_add(checkout->files, file);
+    }
+
+    return error;
+}
+
+static int write_blob(const char* path,
+                      const checkout_file_t* file,
+                      const git_odb_object* blob) {
+    const char* data = git_odb_object_data(blob);
+    size_t size = git_odb_object_size(blob);
+    int error = 0;
+
+#ifndef _WIN32
+    if (file->mode == GIT_FILEMODE_LINK) {
+        gchar* target = g_strndup(data, size);
+        error = symlink(target, path);
+        g_free(target);
+        return error;
+    }
+#endif
+
+    FILE* out = g_fopen(path, "wb");
+    if (!out) {
+        return -1;
+    }
+    if (size > 0 && fwrite(data, 1, size, out) != size) {
+        error = -1;
+    }
+    if (fclose(out)) {
+        error = -1;
+    }
+
+#ifndef _WIN32
+    // Give execute permission wherever the umask gave read permission
+    GStatBuf st;
+    if (!error && file->mode == GIT_FILEMODE_BLOB_EXECUTABLE) {
+        error = g_stat(path, &st);
+    }
+    if (!error && file->mode == GIT_FILEMODE_BLOB_EXECUTABLE) {
+        error = g_chmod(path, (st.st_mode & 0777) | ((st.st_mode & 0444) >> 2));
+    }
+#endif
+
+    return error;
+}
+
+static int write_file(git_odb* odb,
+                      const char* workdir,
+                      checkout_file_t* file) {
+    git_odb_object* blob = NULL;
+    gchar* path = g_build_filename(workdir, file->path, NULL);
+
+    int error = git_odb_read(&blob, odb, &file->id);
+    if (error) {
+        const git_error* e = git_error_last();
+        g_printerr("Failed to read '%s': %s\n", file->path,
+                   e ? e->message : "unknown error");
+    } else if (write_blob(path, file, blob) || g_lstat(path, &file->st)) {
+        g_printerr("Failed to write '%s': %s\n", file->path,
+                   g_strerror(errno));
+        error = -1;
+    }
+
+    git_odb_object_free(blob);
+    g_free(path);
+    return error;
+}
+
+// Each worker inflates and writes every n-th file through its own object
+// database, libgit2 handles aren't meant to be shared between threads
+static void write_files(gpointer data, gpointer user_data) {
+    checkout_t* checkout = user_data;
+    git_odb* odb = NULL;
+    int error = git_odb_open(&odb, checkout->objects);
+
+    GPtrArray* files = checkout->files;
+    for (guint i = GPOINTER_TO_UINT(data) - 1;
+         !error && i < files->len && !g_atomic_int_get(&checkout->failed);
+         i += checkout->workers) {
+        error = write_file(odb, checkout->workdir, files->pdata[i]);
+    }
+
+    if (error) {
+        g_atomic_int_set(&checkout->failed, 1);
+    }
+    git_odb_free(odb);
+}
+
+static void fill_time(git_index_time* out,
+                      const GStatBuf* st,
+                      gboolean modified) {
+    out->seconds = (int32_t)(modified ? st->st_mtime : st->st_ctime);
+#ifdef __linux__
+    out->nanoseconds =
+        (uint32_t)(modified ? st->st_mtim.tv_nsec : st->st_ctim.tv_nsec);
+#endif
+}
+
+// Stat the index against the written files, so that git doesn't have to
+// hash the whole working tree again on the first status
+static int write_index(git_repository* repo,
+                       git_tree* tree,
+                       GPtrArray* files) {
+    git_index* index = NULL;
+    int error = git_repository_index(&index, repo);
+    if (!error) {
+        error = git_index_read_tree(index, tree);
+    }
+
+    for (guint i = 0; !error && i < files->len; i++) {
+        const checkout_file_t* file = files->pdata[i];
+        git_index_entry entry = {0};
+        fill_time(&entry.ctime, &file->st, FALSE);
+        fill_time(&entry.mtime, &file->st, TRUE);
+        entry.dev = (uint32_t)file->st.st_dev;
+        entry.ino = (uint32_t)file->st.st_ino;
+        entry.mode = file->mode;
+        entry.uid = (uint32_t)file->st.st_uid;
+        entry.gid = (uint32_t)file->st.st_gid;
+        entry.file_size = (uint32_t)file->st.st_size;
+        entry.path = file->path;
+        git_oid_cpy(&entry.id, &file->id);
+        error = git_index_add(index, &entry);
+    }
+
+    if (!error) {
+        error = git_index_write(index);
+    }
+    git_index_free(index);
+    return error;
+}
+
+extern int gittor_git_checkout(git_repository* repo) {
+    git_tree* tree = NULL;
+    git_config* cfg = NULL;
+    checkout_t checkout = {0};
+
+    // Initialize libgit2
+    int error = gittor_libgit2_init();
+
+    if (!error && git_repository_is_bare(repo)) {
+        git_error_set_str(GIT_ERROR_INVALID,
+                          "cannot check out into a bare repository");
+        error = GIT_EBAREREPO;
+    }
+
+    // Nothing to check out on an unborn branch
+    if (!error) {
+        error = git_repository_head_tree(&tree, repo);
+    }
+    if (error == GIT_EUNBORNBRANCH) {
+        error = 1;
+    }
+
+    // Check whether any file needs libgit2's filters
+    if (!error) {
+        error = git_repository_config_snapshot(&cfg, repo);
+    }
+    if (!error && needs_filters(repo, cfg)) {
+        error = GIT_PASSTHROUGH;
+    }
+    if (!error) {
+        int symlinks = 1;
+#ifdef _WIN32
+        symlinks = 0;
+#else
+        git_config_get_bool(&symlinks, cfg, "core.symlinks");
+#endif
+        checkout.symlinks = symlinks;
+        checkout.workdir = git_repository_workdir(repo);
+        checkout.objects =
+            g_build_filename(git_repository_path(repo), "objects", NULL);
+        checkout.files = g_ptr_array_new_with_free_func(free_file);
+        error = git_tree_walk(tree, GIT_TREEWALK_PRE, collect, &checkout);
+    }
+
+    // Write the files with one worker per processor
+    if (!error && checkout.files->len > 0) {
+        checkout.workers =
+            CLAMP(g_get_num_processors(), 1, checkout.files->len);
+        GThreadPool* pool = g_thread_pool_new(write_files, &checkout,
+                                              checkout.workers, TRUE, NULL);
+        for (guint i = 1; pool && i <= checkout.workers; i++) {
+            g_thread_pool_push(pool, GUINT_TO_POINTER(i), NULL);
+        }
+        if (pool) {
+            g_thread_pool_free(pool, FALSE, TRUE);
+        }
+        if (!pool || checkout.failed) {
+            git_error_set_str(GIT_ERROR_CHECKOUT,
+                              "failed to write the working tree");
+            error = -1;
+        }
+    }
+
+    if (!error) {
+        error = write_index(repo, tree, checkout.files);
+    }
+
+    // Fall back to the serial checkout that applies the filters
+    if (error == GIT_PASSTHROUGH) {
+        git_checkout_options opts;
+        error = git_checkout_options_init(&opts, GIT_CHECKOUT_OPTIONS_VERSION);
+        if (!error) {
+            opts.checkout_strategy = GIT_CHECKOUT_FORCE;
+            error = git_checkout_head(repo, &opts);
+        }
+    }
+
+    if (checkout.files) {
+        g_ptr_array_free(checkout.files, TRUE);
+    }
+    g_free(checkout.objects);
+    git_config_free(cfg);
+    git_tree_free(tree);
+    return error > 0 ? 0 : error;
+}
@@ -0,0 +1,14 @@
+#include <glib.h>
+#include "utils/utils.h"
+
+extern GMappedFile* gittor_map_file(const char* path) {
+    GMappedFile* file = g_mapped_file_new(path, FALSE, NULL);
+
+    // Treat empty files the same as missing ones, there is nothing to parse
+    if (file && g_mapped_file_get_length(file) == 0) {
+        g_mapped_file_unref(file);
+        return NULL;
+    }
+
+    return file;
+}
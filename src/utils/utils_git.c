@@ -1,22 +1,195 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
 #include <git2.h>
 #include <glib.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <git2/oid.h>
+#include <git2/sys/odb_backend.h>
+#include <glib/gstdio.h>
 #include "utils/utils.h"
 
-extern int gittor_get_repo_id(char* str, size_t n, git_repository* repo) {
+#define COPY_BUFFER_SIZE (64 * 1024)
+
+static int link_file(const char* from, const char* to) {
+#ifdef _WIN32
+    return CreateHardLinkA(to, from, NULL) ? 0 : -1;
+#else
+    return link(from, to);
+#endif
+}
+
+static guint oid_hash(gconstpointer key) {
+    guint hash = 0;
+    memcpy(&hash, ((const git_oid*)key)->id, sizeof(hash));
+    return hash;
+}
+
+static gboolean oid_equal(gconstpointer a, gconstpointer b) {
+    return git_oid_equal(a, b);
+}
+
+// Add an object to a set, FALSE if it was already there
+static gboolean add_oid(GHashTable* set, const git_oid* id) {
+    if (g_hash_table_contains(set, id)) {
+        return FALSE;
+    }
+    git_oid* key = g_new(git_oid, 1);
+    git_oid_cpy(key, id);
+    return g_hash_table_add(set, key);
+}
+
+// Link a file unless the destination already has it, counting what's linked
+static int link_missing(const char* from_dir,
+                        const char* to_dir,
+                        const char* name,
+                        int* linked) {
+    gchar* from = g_build_filename(from_dir, name, NULL);
+    gchar* to = g_build_filename(to_dir, name, NULL);
     int error = 0;
+
+    if (g_file_test(from, G_FILE_TEST_IS_REGULAR) &&
+        !g_file_test(to, G_FILE_TEST_EXISTS)) {
+        error = link_file(from, to);
+        if (!error) {
+            (*linked)++;
+        }
+    }
+
+    g_free(from);
+    g_free(to);
+    return error;
+}
+
+// Replace a file with a copy of itself, atomically, so that it no longer
+// shares its contents with its other links
+static int unshare_file(const char* path, const GStatBuf* st) {
+    gchar* tmp = g_strconcat(path, ".unshare", NULL);
+    FILE* from = g_fopen(path, "rb");
+    FILE* to = from ? g_fopen(tmp, "wb") : NULL;
+    int error = to ? 0 : -1;
+
+    gchar* buffer = g_malloc(COPY_BUFFER_SIZE);
+    size_t len = 0;
+    while (!error && (len = fread(buffer, 1, COPY_BUFFER_SIZE, from)) > 0) {
+        if (fwrite(buffer, 1, len, to) != len) {
+            error = -1;
+        }
+    }
+    if (from && ferror(from)) {
+        error = -1;
+    }
+    if (to && fclose(to)) {
+        error = -1;
+    }
+    if (from) {
+        fclose(from);
+    }
+
+    if (!error) {
+        error = g_chmod(tmp, st->st_mode & 07777);
+    }
+    if (!error) {
+        error = g_rename(tmp, path);
+    }
+    if (error) {
+        g_remove(tmp);
+    }
+    g_free(buffer);
+    g_free(tmp);
+    return error;
+}
+
+static gboolean is_loose_dir(const char* name) {
+    return strlen(name) == 2 && g_ascii_isxdigit(name[0]) &&
+           g_ascii_isxdigit(name[1]);
+}
+
+// The repository's own config, never the user's or the system's
+static int local_config(git_config** out, git_repository* repo) {
+    git_config* cfg = NULL;
+    int error = git_repository_config(&cfg, repo);
+    if (!error) {
+        error = git_config_open_level(out, cfg, GIT_CONFIG_LEVEL_LOCAL);
+    }
+    git_config_free(cfg);
+    return error;
+}
+
+// Read the ID recorded in the repository, if it still names a root commit
+static int read_repo_id(git_oid* out, git_repository* repo) {
+    git_config* cfg = NULL;
+    git_config* snapshot = NULL;
+    git_commit* commit = NULL;
+    const char* value = NULL;
+
+    int error = local_config(&cfg, repo);
+    if (!error) {
+        error = git_config_snapshot(&snapshot, cfg);
+    }
+    if (!error) {
+        error = git_config_get_string(&value, snapshot, "gittor.repoid");
+    }
+    if (!error && strlen(value) != GIT_OID_HEXSZ) {
+        error = GIT_EINVALID;
+    }
+    if (!error) {
+        error = git_oid_fromstr(out, value);
+    }
+
+    // A shallow repository doesn't have its root commit to check against
+    if (!error) {
+        error = git_commit_lookup(&commit, repo, out);
+        if (error == GIT_ENOTFOUND && git_repository_is_shallow(repo)) {
+            error = 0;
+        } else if (!error && git_commit_parentcount(commit) != 0) {
+            error = GIT_EINVALID;
+        }
+    }
+
+    git_commit_free(commit);
+    git_config_free(snapshot);
+    git_config_free(cfg);
+    return error;
+}
+
+extern int gittor_set_repo_id(git_repository* repo, const char* repo_id) {
+    git_config* cfg = NULL;
+
+    // Initialize libgit2
+    int error = gittor_libgit2_init();
+
+    if (!error) {
+        error = local_config(&cfg, repo);
+    }
+    if (!error) {
+        error = git_config_set_string(cfg, "gittor.repoid", repo_id);
+    }
+
+    git_config_free(cfg);
+    return error;
+}
+
+extern int gittor_get_repo_id(char* str, size_t n, git_repository* repo) {
     git_revwalk* walk = NULL;
     git_commit* commit = NULL;
     git_oid repo_id;
 
     // Initialize libgit2
-    int ret = git_libgit2_init();
-    if (ret < 0) {
-        error = ret;
+    int error = gittor_libgit2_init();
+
+    // Recorded when the repository was created or cloned
+    if (!error && !read_repo_id(&repo_id, repo)) {
+        git_oid_tostr(str, n, &repo_id);
+        return 0;
     }
 
+    // Otherwise it's the first commit, which takes walking the whole history
     if (!error) {
         error = git_revwalk_new(&walk, repo);
     }
@@ -37,33 +210,358 @@ extern int gittor_get_repo_id(char* str, size_t n, git_repository* repo) {
         git_oid_tostr(str, n, &repo_id);
     }
 
+    // Record it for next time. Bare repositories are seeded as they are, so
+    // they are left untouched and only get it from whoever created them.
+    if (!error && !git_repository_is_bare(repo)) {
+        char hex[GIT_OID_HEXSZ + 1];
+        git_oid_tostr(hex, sizeof(hex), &repo_id);
+        gittor_set_repo_id(repo, hex);
+    }
+
     git_revwalk_free(walk);
     git_commit_free(commit);
-    git_libgit2_shutdown();
     return error;
 }
 
-extern int gittor_git_push(git_repository* repo) {
+// The bare repository a remote URL points to, if it is on this machine
+static gchar* local_remote_path(git_remote* remote) {
+    const char* url = git_remote_pushurl(remote);
+    if (!url) {
+        url = git_remote_url(remote);
+    }
+    if (url && g_str_has_prefix(url, "file://")) {
+        return g_strdup(url + strlen("file://"));
+    }
+    if (url && g_path_is_absolute(url)) {
+        return g_strdup(url);
+    }
+    return NULL;
+}
+
+// Whether every object of a pack is in a set
+static int not_in_set(const git_oid* id, void* payload) {
+    return g_hash_table_contains(payload, id) ? 0 : 1;
+}
+
+static bool pack_within(const char* idx, GHashTable* set) {
+    git_odb* odb = NULL;
+    git_odb_backend* backend = NULL;
+    int error = git_odb_new(&odb);
+    if (!error) {
+        error = git_odb_backend_one_pack(&backend, idx);
+    }
+    if (!error) {
+        error = git_odb_add_backend(odb, backend, 1);
+        if (error) {
+            backend->free(backend);
+        }
+    }
+    if (!error) {
+        error = git_odb_foreach(odb, not_in_set, set);
+    }
+    git_odb_free(odb);
+    git_error_clear();
+    return !error;
+}
+
+// Whether a loose object, named after the directory it is in and itself,
+// is in a set
+static bool loose_within(const char* dir, const char* name, GHashTable* set) {
+    gchar* hex = g_strconcat(dir, name, NULL);
+    git_oid id;
+    bool within = strlen(hex) == GIT_OID_HEXSZ && !git_oid_fromstr(&id, hex) &&
+                  g_hash_table_contains(set, &id);
+    g_free(hex);
+    return within;
+}
+
+// Link the packs and loose objects holding only objects of a set, or all of
+// them without one
+static int link_objects(git_repository* destination,
+                        git_repository* source,
+                        GHashTable* only) {
+    int error = 0;
+    int linked = 0;
+    gchar* from_objects =
+        g_build_filename(git_repository_path(source), "objects", NULL);
+    gchar* to_objects =
+        g_build_filename(git_repository_path(destination), "objects", NULL);
+    gchar* from_packs = g_build_filename(from_objects, "pack", NULL);
+    gchar* to_packs = g_build_filename(to_objects, "pack", NULL);
+
+    // Packs are found by their index, so link it after the pack itself
+    GDir* dir = g_dir_open(from_packs, 0, NULL);
+    const gchar* name = NULL;
+    g_mkdir_with_parents(to_packs, 0755);
+    while (!error && dir && (name = g_dir_read_name(dir))) {
+        if (!g_str_has_suffix(name, ".idx")) {
+            continue;
+        }
+        gchar* idx = g_build_filename(from_packs, name, NULL);
+        bool within = !only || pack_within(idx, only);
+        g_free(idx);
+        if (!within) {
+            continue;
+        }
+
+        gchar* stem = g_strndup(name, strlen(name) - strlen(".idx"));
+        gchar* pack = g_strconcat(stem, ".pack", NULL);
+        gchar* rev = g_strconcat(stem, ".rev", NULL);
+        error = link_missing(from_packs, to_packs, pack, &linked);
+        if (!error) {
+            error = link_missing(from_packs, to_packs, rev, &linked);
+        }
+        if (!error) {
+            error = link_missing(from_packs, to_packs, name, &linked);
+        }
+        g_free(rev);
+        g_free(pack);
+        g_free(stem);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+
+    // Loose objects live in directories named after their first byte
+    dir = error ? NULL : g_dir_open(from_objects, 0, NULL);
+    while (!error && dir && (name = g_dir_read_name(dir))) {
+        if (!is_loose_dir(name)) {
+            continue;
+        }
+
+        gchar* from_dir = g_build_filename(from_objects, name, NULL);
+        gchar* to_dir = g_build_filename(to_objects, name, NULL);
+        GDir* objects = g_dir_open(from_dir, 0, NULL);
+        const gchar* object = NULL;
+        while (!error && objects && (object = g_dir_read_name(objects))) {
+            if (only && !loose_within(name, object, only)) {
+                continue;
+            }
+            g_mkdir_with_parents(to_dir, 0755);
+            error = link_missing(from_dir, to_dir, object, &linked);
+        }
+        if (objects) {
+            g_dir_close(objects);
+        }
+        g_free(from_dir);
+        g_free(to_dir);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+
+    g_free(from_packs);
+    g_free(to_packs);
+    g_free(from_objects);
+    g_free(to_objects);
+    return error ? -1 : linked;
+}
+
+// Write the objects of a set the destination is still missing into a pack
+// of its own
+static int pack_missing(git_repository* destination,
+                        git_repository* source,
+                        git_odb* odb,
+                        GHashTable* set) {
+    git_packbuilder* pb = NULL;
+    gchar* packs = g_build_filename(git_repository_path(destination),
+                                    "objects", "pack", NULL);
+
+    int error = git_packbuilder_new(&pb, source);
+    if (!error) {
+        git_packbuilder_set_threads(pb, 0);  // One per core
+    }
+    GHashTableIter iter;
+    gpointer id = NULL;
+    g_hash_table_iter_init(&iter, set);
+    while (!error && g_hash_table_iter_next(&iter, &id, NULL)) {
+        if (!git_odb_exists(odb, id)) {
+            error = git_packbuilder_insert(pb, id, NULL);
+        }
+    }
+    if (!error && git_packbuilder_object_count(pb) > 0) {
+        error = git_packbuilder_write(pb, packs, 0, NULL, NULL);
+    }
+
+    git_packbuilder_free(pb);
+    g_free(packs);
+    return error;
+}
+
+// Add the entries of a tree to a set, skipping the subtrees already in it
+static int add_entry(const char* root,
+                     const git_tree_entry* entry,
+                     void* payload) {
+    (void)root;
+
+    // Submodule commits live in another repository
+    if (git_tree_entry_type(entry) == GIT_OBJECT_COMMIT) {
+        return 1;
+    }
+    return add_oid(payload, git_tree_entry_id(entry)) ? 0 : 1;
+}
+
+// Collect every object of the commits from tip back to known, which is all
+// a push publishes
+static int reachable_objects(GHashTable* out,
+                             git_repository* repo,
+                             const git_oid* tip,
+                             const git_oid* known) {
+    git_revwalk* walk = NULL;
+    git_oid id;
+    int error = git_revwalk_new(&walk, repo);
+    if (!error) {
+        error = git_revwalk_push(walk, tip);
+    }
+    if (!error && known) {
+        error = git_revwalk_hide(walk, known);
+    }
+    while (!error && !(error = git_revwalk_next(&id, walk))) {
+        git_commit* commit = NULL;
+        git_tree* tree = NULL;
+        add_oid(out, &id);
+        error = git_commit_lookup(&commit, repo, &id);
+        if (!error && add_oid(out, git_commit_tree_id(commit))) {
+            error = git_commit_tree(&tree, commit);
+            if (!error) {
+                error = git_tree_walk(tree, GIT_TREEWALK_PRE, add_entry, out);
+            }
+        }
+        git_tree_free(tree);
+        git_commit_free(commit);
+    }
+    if (error == GIT_ITEROVER) {
+        error = 0;
+    }
+    git_revwalk_free(walk);
+    return error;
+}
+
+// Point the remote-tracking branch at what was pushed, as a push would
+static int update_tracking(git_remote* remote,
+                           git_repository* repo,
+                           const char* branch,
+                           const git_oid* oid) {
     int error = 0;
+    size_t count = git_remote_refspec_count(remote);
+    for (size_t i = 0; i < count && !error; i++) {
+        const git_refspec* spec = git_remote_get_refspec(remote, i);
+        if (git_refspec_direction(spec) != GIT_DIRECTION_FETCH ||
+            !git_refspec_src_matches(spec, branch)) {
+            continue;
+        }
+
+        git_buf tracking = {0};
+        git_reference* ref = NULL;
+        error = git_refspec_transform(&tracking, spec, branch);
+        if (!error) {
+            error = git_reference_create(&ref, repo, tracking.ptr, oid, 1,
+                                         "update by push");
+        }
+        git_reference_free(ref);
+        git_buf_dispose(&tracking);
+    }
+    return error;
+}
+
+/**
+ * @brief Push a branch to a bare repository on this machine by hardlinking
+ * the object files that hold nothing but the pushed history into it, and
+ * writing the pushed objects it still lacks into a pack, then moving its
+ * reference.
+ *
+ * @return int error code, GIT_PASSTHROUGH to push the usual way instead
+ */
+static int push_local(git_repository* repo,
+                      git_remote* remote,
+                      const char* branch,
+                      const git_oid* tip) {
+    gchar* path = local_remote_path(remote);
+    git_repository* destination = NULL;
+    git_reference* ref = NULL;
+    git_odb* odb = NULL;
+    GHashTable* pushed = NULL;
+    int error = path ? gittor_repo_open(&destination, path) : GIT_PASSTHROUGH;
+    if (error) {
+        g_free(path);
+        git_error_clear();
+        return GIT_PASSTHROUGH;
+    }
+
+    // Only fast-forwards, the usual push explains why anything else fails
+    git_oid known;
+    bool exists = !git_reference_name_to_id(&known, destination, branch);
+    bool same = exists && git_oid_equal(&known, tip);
+    if (exists && !same && git_graph_descendant_of(repo, tip, &known) != 1) {
+        error = GIT_PASSTHROUGH;
+    }
+
+    // Only files holding nothing but pushed objects are linked, the rest of
+    // the repository, other branches, stashes and unreachable objects, stays
+    // private. Objects the destination already has are skipped.
+    if (!error && !same) {
+        pushed = g_hash_table_new_full(oid_hash, oid_equal, g_free, NULL);
+        error = reachable_objects(pushed, repo, tip, exists ? &known : NULL);
+    }
+    if (!error) {
+        error = git_repository_odb(&odb, destination);
+    }
+    if (!error && !same) {
+        // Nothing links across filesystems, the pack below has it all then
+        link_objects(destination, repo, pushed);
+        error = git_odb_refresh(odb);
+    }
+    if (!error && !same) {
+        error = pack_missing(destination, repo, odb, pushed);
+    }
+    if (!error && !git_odb_exists(odb, tip)) {
+        error = git_odb_refresh(odb);
+        if (!error && !git_odb_exists(odb, tip)) {
+            error = GIT_PASSTHROUGH;
+        }
+    }
+
+    // Move the branch only if nobody else did in the meantime
+    if (!error && !same) {
+        error = git_reference_create_matching(&ref, destination, branch, tip,
+                                              exists, exists ? &known : NULL,
+                                              "push");
+    }
+    if (!error) {
+        error = update_tracking(remote, repo, branch, tip);
+    }
+
+    if (error == GIT_PASSTHROUGH) {
+        git_error_clear();
+    }
+    if (pushed) {
+        g_hash_table_destroy(pushed);
+    }
+    git_reference_free(ref);
+    git_odb_free(odb);
+    gittor_repo_close(destination);
+    g_free(path);
+    return error;
+}
+
+extern int gittor_git_push(git_repository* repo) {
     git_remote* remote = NULL;
     git_reference* head = NULL;
     git_reference* resolved = NULL;
     git_push_options opts;
 
     // Initialize libgit2
-    int ret = git_libgit2_init();
-    if (ret < 0) {
-        error = ret;
-    }
+    int error = gittor_libgit2_init();
 
     // Load the remote
     if (!error) {
         error = git_remote_lookup(&remote, repo, "origin");
     }
 
-    // Load the push options
+    // Load the push options, building any pack on every core
     if (!error) {
         error = git_push_options_init(&opts, GIT_PUSH_OPTIONS_VERSION);
+        opts.pb_parallelism = 0;
     }
 
     // Get the HEAD of the repository
@@ -74,9 +572,20 @@ extern int gittor_git_push(git_repository* repo) {
         error = git_reference_resolve(&resolved, head);
     }
 
+    // The remotes are usually on this machine, and can be pushed to directly
+    bool pushed = false;
+    if (!error) {
+        error = push_local(repo, remote, git_reference_name(resolved),
+                           git_reference_target(resolved));
+        pushed = error != GIT_PASSTHROUGH;
+        if (!pushed) {
+            error = 0;
+        }
+    }
+
     // Push to the remote
     git_strarray refspecs = {0};
-    if (!error) {
+    if (!error && !pushed) {
         const char* branch = git_reference_name(resolved);
         size_t len = strlen(branch) * 2 + 2;
         char* spec = malloc(len);
@@ -92,12 +601,49 @@ extern int gittor_git_push(git_repository* repo) {
 
     if (error < 0) {
         const git_error* e = git_error_last();
-        printf("Error %d/%d: %s\n", error, e->klass, e->message);
+        printf("Error %d/%d: %s\n", error, e ? e->klass : 0,
+               e ? e->message : "unknown error");
     }
 
     git_reference_free(resolved);
     git_reference_free(head);
     git_remote_free(remote);
-    git_libgit2_shutdown();
     return error;
 }
+
+extern int gittor_git_link_objects(git_repository* destination,
+                                   git_repository* source) {
+    return link_objects(destination, source, NULL);
+}
+
+extern int gittor_unshare_file(const char* path) {
+    GStatBuf st;
+    if (g_lstat(path, &st) || !S_ISREG(st.st_mode) || st.st_nlink < 2) {
+        return 0;
+    }
+    return unshare_file(path, &st) ? -1 : 1;
+}
+
+extern int gittor_unshare_files(const char* path) {
+    int copied = 0;
+    GDir* dir = g_dir_open(path, 0, NULL);
+    const gchar* name = NULL;
+    while (copied >= 0 && dir && (name = g_dir_read_name(dir))) {
+        gchar* child = g_build_filename(path, name, NULL);
+        GStatBuf st;
+        if (g_lstat(child, &st)) {
+            // Gone in the meantime, nothing left to share
+        } else if (S_ISDIR(st.st_mode)) {
+            int sub = gittor_unshare_files(child);
+            copied = sub < 0 ? sub : copied + sub;
+        } else {
+            int one = gittor_unshare_file(child);
+            copied = one < 0 ? one : copied + one;
+        }
+        g_free(child);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+    return copied;
+}
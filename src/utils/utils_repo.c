@@ -0,0 +1,136 @@
+#include <git2.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "utils/utils.h"
+
+// Repositories kept open between uses, the least recently used is closed
+#define REPO_CACHE_SIZE 8
+
+// An idle handle, with the git directory it had open when it was closed. A
+// new directory may get the inode of a deleted one, but not its change time.
+typedef struct {
+    git_repository* repo;
+    dev_t dev;
+    ino_t ino;
+    gint64 changed_ns;
+} cached_repo_t;
+
+static GMutex cache_lock;
+static GQueue cache = G_QUEUE_INIT;  // Idle handles, most recently used first
+static int init_error = 0;
+
+static gint64 changed_ns(const GStatBuf* st) {
+    return (gint64)st->st_ctim.tv_sec * 1000000000 + st->st_ctim.tv_nsec;
+}
+
+static void cached_repo_free(cached_repo_t* cached) {
+    if (cached) {
+        git_repository_free(cached->repo);
+        g_free(cached);
+    }
+}
+
+static void libgit2_cleanup() {
+    g_mutex_lock(&cache_lock);
+    cached_repo_t* cached = NULL;
+    while ((cached = g_queue_pop_head(&cache))) {
+        cached_repo_free(cached);
+    }
+    g_mutex_unlock(&cache_lock);
+    git_libgit2_shutdown();
+}
+
+extern int gittor_libgit2_init() {
+    static gsize initialized = 0;
+
+    // Set up once and torn down at exit, rather than around every call
+    if (g_once_init_enter(&initialized)) {
+        int ret = git_libgit2_init();
+        if (ret < 0) {
+            init_error = ret;
+        } else {
+            atexit(libgit2_cleanup);
+        }
+        g_once_init_leave(&initialized, 1);
+    }
+    return init_error;
+}
+
+// Compare a directory from libgit2, which ends with a slash, to a path
+static gboolean same_dir(const char* dir, const char* path) {
+    if (!dir) {
+        return FALSE;
+    }
+    size_t len = strlen(path);
+    return strncmp(dir, path, len) == 0 &&
+           (dir[len] == '\0' || (dir[len] == '/' && dir[len + 1] == '\0'));
+}
+
+extern int gittor_repo_open(git_repository** out, const char* path) {
+    int error = gittor_libgit2_init();
+    if (error) {
+        return error;
+    }
+
+    // Reuse an idle handle of the repository, with its packs already indexed
+    gchar* key = g_canonicalize_filename(path, NULL);
+    cached_repo_t* cached = NULL;
+    g_mutex_lock(&cache_lock);
+    for (GList* it = cache.head; it; it = it->next) {
+        git_repository* repo = ((cached_repo_t*)it->data)->repo;
+        if (same_dir(git_repository_workdir(repo), key) ||
+            same_dir(git_repository_path(repo), key)) {
+            cached = it->data;
+            g_queue_delete_link(&cache, it);
+            break;
+        }
+    }
+    g_mutex_unlock(&cache_lock);
+    g_free(key);
+
+    // Unless it was deleted since, or replaced by another repository at the
+    // same path, as a leech of it again does
+    GStatBuf st;
+    if (cached && (g_stat(git_repository_path(cached->repo), &st) ||
+                   st.st_dev != cached->dev || st.st_ino != cached->ino ||
+                   changed_ns(&st) != cached->changed_ns)) {
+        cached_repo_free(cached);
+        cached = NULL;
+    }
+
+    if (cached) {
+        *out = cached->repo;
+        g_free(cached);
+        return 0;
+    }
+    return git_repository_open(out, path);
+}
+
+extern void gittor_repo_close(git_repository* repo) {
+    if (!repo)
+        return;
+
+    // A git directory that is gone already can't be reused
+    GStatBuf st;
+    if (g_stat(git_repository_path(repo), &st)) {
+        git_repository_free(repo);
+        return;
+    }
+    cached_repo_t* cached = g_new(cached_repo_t, 1);
+    cached->repo = repo;
+    cached->dev = st.st_dev;
+    cached->ino = st.st_ino;
+    cached->changed_ns = changed_ns(&st);
+
+    // Bare or not, a repository is found again by its directories
+    cached_repo_t* evicted = NULL;
+    g_mutex_lock(&cache_lock);
+    g_queue_push_head(&cache, cached);
+    if (g_queue_get_length(&cache) > REPO_CACHE_SIZE) {
+        evicted = g_queue_pop_tail(&cache);
+    }
+    g_mutex_unlock(&cache_lock);
+    cached_repo_free(evicted);
+}
@@ -0,0 +1,99 @@
+#include <cstdlib>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <libtorrent/address.hpp>
+#include <libtorrent/ip_filter.hpp>
+#include <libtorrent/session.hpp>
+#include <libtorrent/settings_pack.hpp>
+
+extern "C" {
+#include "config/config.h"
+}
+#include "utils/session.h"
+
+namespace {
+
+// read a true/false network setting from the global config
+bool network_flag(const char* key, bool fallback) {
+    const config_id_t id = {.group = "network", .key = key};
+    return config_get_bool(CONFIG_SCOPE_GLOBAL, &id, fallback);
+}
+
+void allow_range(lt::ip_filter& filter, const char* first, const char* last) {
+    filter.add_rule(lt::make_address(first), lt::make_address(last), 0);
+}
+
+}  // namespace
+
+void gittor_network_settings(lt::settings_pack& settings) {
+    const config_id_t port_config = {.group = "network", .key = "port"};
+    char* port_str = config_get(CONFIG_SCOPE_GLOBAL, &port_config, NULL);
+    if (port_str != NULL) {
+        settings.set_str(lt::settings_pack::listen_interfaces,
+                         std::string("0.0.0.0:") + port_str);
+        free(port_str);
+    }
+
+    // Find peers on the same network by multicast, which also works offline
+    // and spares the WAN link when a colleague already has the repository
+    settings.set_bool(lt::settings_pack::enable_lsd,
+                      network_flag("lsd", true));
+
+    // Nothing that would reach out past the local network
+    if (network_flag("lan_only", false)) {
+        settings.set_bool(lt::settings_pack::enable_lsd, true);
+        settings.set_bool(lt::settings_pack::enable_dht, false);
+        settings.set_bool(lt::settings_pack::enable_upnp, false);
+        settings.set_bool(lt::settings_pack::enable_natpmp, false);
+        settings.set_bool(lt::settings_pack::apply_ip_filter_to_trackers,
+                          true);
+    }
+}
+
+lt::ip_filter gittor_lan_filter() {
+    // Block everything but loopback, private and link-local addresses
+    lt::ip_filter filter;
+    filter.add_rule(lt::make_address("0.0.0.0"),
+                    lt::make_address("255.255.255.255"),
+                    lt::ip_filter::blocked);
+    filter.add_rule(lt::make_address("::"),
+                    lt::make_address("ffff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"),
+                    lt::ip_filter::blocked);
+    allow_range(filter, "10.0.0.0", "10.255.255.255");
+    allow_range(filter, "127.0.0.0", "127.255.255.255");
+    allow_range(filter, "169.254.0.0", "169.254.255.255");
+    allow_range(filter, "172.16.0.0", "172.31.255.255");
+    allow_range(filter, "192.168.0.0", "192.168.255.255");
+    allow_range(filter, "::1", "::1");
+    allow_range(filter, "fc00::", "fdff:ffff:ffff:ffff:ffff:ffff:ffff:ffff");
+    allow_range(filter, "fe80::", "febf:ffff:ffff:ffff:ffff:ffff:ffff:ffff");
+    return filter;
+}
+
+void gittor_network_session(lt::session& ses) {
+    // An empty filter also lifts one left over from LAN only mode
+    ses.set_ip_filter(network_flag("lan_only", false) ? gittor_lan_filter()
+                                                      : lt::ip_filter());
+}
+
+void gittor_network_reload(lt::session& ses) {
+    // Settings no longer configured go back to their defaults. Those that
+    // keep their value are left alone, so the listen sockets are only
+    // reopened when the port changes.
+    const lt::settings_pack defaults = lt::default_settings();
+    lt::settings_pack settings;
+    settings.set_str(
+        lt::settings_pack::listen_interfaces,
+        defaults.get_str(lt::settings_pack::listen_interfaces));
+    for (const int name : {lt::settings_pack::enable_dht,
+                           lt::settings_pack::enable_upnp,
+                           lt::settings_pack::enable_natpmp,
+                           lt::settings_pack::apply_ip_filter_to_trackers}) {
+        settings.set_bool(name, defaults.get_bool(name));
+    }
+
+    gittor_network_settings(settings);
+    ses.apply_settings(std::move(settings));
+    gittor_network_session(ses);
+}
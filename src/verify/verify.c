@@ -0,0 +1,377 @@
+#include <errno.h>
+#include <gio/gio.h>
+#include <git2.h>
+#include <glib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "utils/utils.h"
+#include "verify/verify.h"
+
+#define EMPTY_TREE_ID "4b825dc642cb6eb9a060e54bf8d69288fbee4904"
+
+typedef enum {
+    VERIFY_PACK,
+    VERIFY_LOOSE,
+    VERIFY_COMMITS,
+} verify_kind_e;
+
+typedef struct {
+    verify_kind_e kind;
+    gchar* path;
+    guint chunk;
+} verify_task_t;
+
+struct verify {
+    GThreadPool* pool;
+    GHashTable* queued;
+    GArray* commits;
+    const char* repo_path;
+    guint workers;
+    gint failures;
+    gint packs;
+    gint loose;
+    gint signed_commits;
+};
+
+static void remove_dir(const char* path) {
+    GDir* dir = g_dir_open(path, 0, NULL);
+    const gchar* name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        gchar* file = g_build_filename(path, name, NULL);
+        g_remove(file);
+        g_free(file);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+    g_rmdir(path);
+}
+
+// Index the pack from scratch next to it, which inflates and hashes every
+// object, and check it is named after the checksum in its trailer
+static int check_pack(const char* path) {
+    gchar* dir = g_path_get_dirname(path);
+    gchar* tmp = g_build_filename(dir, ".verify-XXXXXX", NULL);
+    gchar* basename = g_path_get_basename(path);
+    git_indexer* indexer = NULL;
+    git_indexer_progress stats = {0};
+    FILE* in = NULL;
+    char buffer[64 * 1024];
+    size_t n = 0;
+
+    int error = g_mkdtemp(tmp) ? 0 : -1;
+    if (!error) {
+        error = git_indexer_new(&indexer, tmp, 0, NULL, NULL);
+    }
+    if (!error) {
+        in = g_fopen(path, "rb");
+        error = in ? 0 : -1;
+    }
+    while (!error && (n = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        error = git_indexer_append(indexer, buffer, n, &stats);
+    }
+    if (!error && ferror(in)) {
+        error = -1;
+    }
+    if (!error) {
+        error = git_indexer_commit(indexer, &stats);
+    }
+
+    if (error) {
+        const git_error* e = git_error_last();
+        g_printerr("Pack '%s' is corrupt: %s\n", basename,
+                   e ? e->message : g_strerror(errno));
+    } else {
+        gchar* expected =
+            g_strdup_printf("pack-%s.pack", git_indexer_name(indexer));
+        if (strcmp(basename, expected) != 0) {
+            g_printerr("Pack '%s' does not match its checksum\n", basename);
+            error = -1;
+        }
+        g_free(expected);
+    }
+
+    if (in) {
+        fclose(in);
+    }
+    git_indexer_free(indexer);
+    remove_dir(tmp);
+    g_free(basename);
+    g_free(tmp);
+    g_free(dir);
+    return error;
+}
+
+// A loose object is named after the hash of its inflated contents
+static int check_loose(const char* path) {
+    gchar* data = NULL;
+    gsize size = 0;
+    if (!g_file_get_contents(path, &data, &size, NULL)) {
+        g_printerr("Object '%s' could not be read\n", path);
+        return -1;
+    }
+
+    GZlibDecompressor* zlib =
+        g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+    GChecksum* sha1 = g_checksum_new(G_CHECKSUM_SHA1);
+    guchar out[64 * 1024];
+    gsize offset = 0;
+    GConverterResult result = G_CONVERTER_CONVERTED;
+    while (result == G_CONVERTER_CONVERTED) {
+        gsize read = 0;
+        gsize written = 0;
+        result = g_converter_convert(
+            G_CONVERTER(zlib), data + offset, size - offset, out, sizeof(out),
+            G_CONVERTER_INPUT_AT_END, &read, &written, NULL);
+        offset += read;
+        g_checksum_update(sha1, out, written);
+        if (result == G_CONVERTER_CONVERTED && !read && !written) {
+            result = G_CONVERTER_ERROR;
+        }
+    }
+
+    gchar* dir = g_path_get_dirname(path);
+    gchar* prefix = g_path_get_basename(dir);
+    gchar* rest = g_path_get_basename(path);
+    gchar* expected = g_strconcat(prefix, rest, NULL);
+    int error = 0;
+    if (result != G_CONVERTER_FINISHED ||
+        g_ascii_strcasecmp(g_checksum_get_string(sha1), expected) != 0) {
+        g_printerr("Object %s is corrupt\n", expected);
+        error = -1;
+    }
+
+    g_free(expected);
+    g_free(rest);
+    g_free(prefix);
+    g_free(dir);
+    g_checksum_free(sha1);
+    g_object_unref(zlib);
+    g_free(data);
+    return error;
+}
+
+static gchar* write_tmp(const char* contents, gsize length) {
+    gchar* path = NULL;
+    int fd = g_file_open_tmp("gittor-verify-XXXXXX", &path, NULL);
+    if (fd < 0) {
+        return NULL;
+    }
+    g_close(fd, NULL);
+    if (!g_file_set_contents(path, contents, (gssize)length, NULL)) {
+        g_remove(path);
+        g_free(path);
+        return NULL;
+    }
+    return path;
+}
+
+// Have gpg check the signature against the keys the user trusts
+static int check_signature(git_repository* repo, const git_oid* id) {
+    git_buf signature = {0};
+    git_buf data = {0};
+    gchar* signature_path = NULL;
+    gchar* data_path = NULL;
+    gchar* output = NULL;
+    GError* gerr = NULL;
+    char hex[GIT_OID_HEXSZ + 1] = {0};
+    git_oid_tostr(hex, sizeof(hex), id);
+
+    int error = git_commit_extract_signature(&signature, &data, repo,
+                                             (git_oid*)id, NULL);
+    if (error == GIT_ENOTFOUND) {
+        g_printerr("Commit %s is not signed\n", hex);
+    } else if (error) {
+        const git_error* e = git_error_last();
+        g_printerr("Commit %s could not be read: %s\n", hex,
+                   e ? e->message : "unknown error");
+    }
+
+    if (!error) {
+        signature_path = write_tmp(signature.ptr, signature.size);
+        data_path = write_tmp(data.ptr, data.size);
+        error = signature_path && data_path ? 0 : -1;
+    }
+    if (!error) {
+        gchar* argv[] = {"gpg",       "--batch", "--no-tty",
+                         "--status-fd", "1",       "--verify",
+                         signature_path, data_path, NULL};
+        gint status = -1;
+        if (!g_spawn_sync(NULL, argv, NULL,
+                          G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+                          NULL, NULL, &output, NULL, &status, &gerr)) {
+            g_printerr("Commit %s could not be checked: %s\n", hex,
+                       gerr->message);
+            error = -1;
+        } else if (status != 0 || !strstr(output, "[GNUPG:] GOODSIG ")) {
+            g_printerr("Commit %s has a bad or unknown signature\n", hex);
+            error = -1;
+        } else if (!strstr(output, "[GNUPG:] TRUST_FULLY") &&
+                   !strstr(output, "[GNUPG:] TRUST_ULTIMATE")) {
+            g_printerr("Commit %s is signed by a key that is not trusted\n",
+                       hex);
+            error = -1;
+        }
+    }
+
+    if (signature_path) {
+        g_remove(signature_path);
+    }
+    if (data_path) {
+        g_remove(data_path);
+    }
+    g_clear_error(&gerr);
+    g_free(output);
+    g_free(data_path);
+    g_free(signature_path);
+    git_buf_dispose(&data);
+    git_buf_dispose(&signature);
+    return error;
+}
+
+// GitTor starts every repository with an unsigned root commit of an empty
+// tree, which holds nothing for a signature to vouch for
+static bool is_init_commit(git_repository* repo, const git_oid* id) {
+    git_commit* commit = NULL;
+    git_oid empty;
+    bool init = !git_oid_fromstr(&empty, EMPTY_TREE_ID) &&
+                !git_commit_lookup(&commit, repo, id) &&
+                git_commit_parentcount(commit) == 0 &&
+                git_oid_equal(git_commit_tree_id(commit), &empty);
+    git_commit_free(commit);
+    return init;
+}
+
+// Each chunk checks every n-th commit through its own repository handle,
+// libgit2 handles aren't meant to be shared between threads
+static int check_commits(verify_t* verify, guint chunk) {
+    git_repository* repo = NULL;
+    int error = git_repository_open_bare(&repo, verify->repo_path);
+    int failed = error;
+    if (error) {
+        g_printerr("Repository '%s' could not be opened\n", verify->repo_path);
+    }
+
+    for (guint i = chunk; !error && i < verify->commits->len;
+         i += verify->workers) {
+        const git_oid* id = &g_array_index(verify->commits, git_oid, i);
+        if (is_init_commit(repo, id)) {
+            continue;
+        }
+        if (check_signature(repo, id)) {
+            failed = -1;
+        } else {
+            g_atomic_int_inc(&verify->signed_commits);
+        }
+    }
+
+    git_repository_free(repo);
+    return failed;
+}
+
+static void run_task(gpointer data, gpointer user_data) {
+    verify_task_t* task = data;
+    verify_t* verify = user_data;
+    int error = 0;
+
+    switch (task->kind) {
+        case VERIFY_PACK:
+            error = check_pack(task->path);
+            if (!error) {
+                g_atomic_int_inc(&verify->packs);
+            }
+            break;
+        case VERIFY_LOOSE:
+            error = check_loose(task->path);
+            if (!error) {
+                g_atomic_int_inc(&verify->loose);
+            }
+            break;
+        case VERIFY_COMMITS:
+            error = check_commits(verify, task->chunk);
+            break;
+    }
+
+    if (error) {
+        g_atomic_int_inc(&verify->failures);
+    }
+    g_free(task->path);
+    g_free(task);
+}
+
+static void queue(verify_t* verify, verify_kind_e kind, const char* path) {
+    // Files can be reported both as they complete and when the leech ends
+    if (!verify || !g_hash_table_add(verify->queued, g_strdup(path))) {
+        return;
+    }
+
+    verify_task_t* task = g_new0(verify_task_t, 1);
+    task->kind = kind;
+    task->path = g_strdup(path);
+    g_thread_pool_push(verify->pool, task, NULL);
+}
+
+extern verify_t* verify_new() {
+    verify_t* verify = g_new0(verify_t, 1);
+    gittor_libgit2_init();
+    verify->workers = MAX(g_get_num_processors(), 1);
+    verify->pool =
+        g_thread_pool_new(run_task, verify, (gint)verify->workers, FALSE, NULL);
+    verify->queued = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           NULL);
+    verify->commits = g_array_new(FALSE, FALSE, sizeof(git_oid));
+    return verify;
+}
+
+extern void verify_queue_pack(verify_t* verify, const char* path) {
+    queue(verify, VERIFY_PACK, path);
+}
+
+extern void verify_queue_loose(verify_t* verify, const char* path) {
+    queue(verify, VERIFY_LOOSE, path);
+}
+
+extern int verify_finish(verify_t* verify, git_repository* repo) {
+    git_revwalk* walk = NULL;
+    git_oid id;
+
+    // Walk every branch and tag, the history of a partial leech stops at
+    // its shallow boundary so a missing parent ends the walk
+    verify->repo_path = repo ? git_repository_path(repo) : NULL;
+    if (repo && !git_revwalk_new(&walk, repo)) {
+        git_revwalk_push_glob(walk, "heads/*");
+        git_revwalk_push_glob(walk, "tags/*");
+        while (!git_revwalk_next(&id, walk)) {
+            g_array_append_val(verify->commits, id);
+        }
+    }
+    git_revwalk_free(walk);
+
+    // Spread the signature checks over the workers
+    guint chunks = MIN(verify->workers, verify->commits->len);
+    for (guint i = 0; i < chunks; i++) {
+        verify_task_t* task = g_new0(verify_task_t, 1);
+        task->kind = VERIFY_COMMITS;
+        task->chunk = i;
+        g_thread_pool_push(verify->pool, task, NULL);
+    }
+    g_thread_pool_free(verify->pool, FALSE, TRUE);
+
+    int failures = g_atomic_int_get(&verify->failures);
+    if (repo) {
+        printf("Verified %d packs, %d loose objects and %d commit "
+               "signatures\n",
+               verify->packs, verify->loose, verify->signed_commits);
+    }
+    if (failures) {
+        git_error_set_str(GIT_ERROR_INVALID,
+                          "the leeched repository failed verification");
+    }
+
+    g_array_free(verify->commits, TRUE);
+    g_hash_table_destroy(verify->queued);
+    g_free(verify);
+    return failures ? -1 : 0;
+}
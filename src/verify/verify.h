@@ -2,6 +2,10 @@
 #define VERIFY_VERIFY_H_
 
 #include <argp.h>
+#include <git2.h>
+
+/// @brief Checks on a leeched repository running on a pool of workers
+typedef struct verify verify_t;
 
 /**
  * @brief Runs the verify subcommand.
@@ -11,4 +15,43 @@
  */
 extern int gittor_verify(struct argp_state* state);
 
+/**
+ * @brief Starts a pool of workers, one per processor, to verify a leeched
+ * repository while it is still downloading.
+ *
+ * @return verify_t* The verification, finish it with verify_finish()
+ */
+extern verify_t* verify_new();
+
+/**
+ * @brief Queues a completed pack file to be indexed from scratch, checking
+ * every object in it and its trailer checksum. Files already queued are
+ * ignored.
+ *
+ * @param verify The verification, may be NULL to do nothing
+ * @param path Path to the .pack file
+ */
+extern void verify_queue_pack(verify_t* verify, const char* path);
+
+/**
+ * @brief Queues a completed loose object to be checked against its name.
+ * Files already queued are ignored.
+ *
+ * @param verify The verification, may be NULL to do nothing
+ * @param path Path to the loose object file
+ */
+extern void verify_queue_loose(verify_t* verify, const char* path);
+
+/**
+ * @brief Checks the signatures of the commits on every branch and tag with
+ * gpg, which must be good and made by a fully trusted key, waits for all the
+ * checks to finish and frees the verification. The empty root commit every
+ * GitTor repository starts with is not signed and is skipped.
+ *
+ * @param verify The verification
+ * @param repo The leeched repository, or NULL to only wait for the files
+ * @return int 0 if everything checked out, negative otherwise
+ */
+extern int verify_finish(verify_t* verify, git_repository* repo);
+
 #endif  // VERIFY_VERIFY_H_
@@ -1,4 +1,5 @@
 #include <glib.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -307,6 +308,548 @@ static void shouldPass_whenFreeingNullDto(void) {
     TEST_PASS();
 }
 
+static void write_test_file(const char* path, const char* contents) {
+    gchar* parent = g_path_get_dirname(path);
+    g_mkdir_with_parents(parent, 0755);
+    g_file_set_contents(path, contents, -1, NULL);
+    g_free(parent);
+}
+
+static void shouldPass_whenParsingWithWebSeeds(void) {
+    // GIVEN: A JSON string with web seeds, one of which isn't a string
+    const char* json =
+        "{"
+        "  \"id\": 69,"
+        "  \"webSeeds\": [\"https://a.example/\", 3, \"https://b.example/\"]"
+        "}";
+
+    // WHEN: Parse the JSON into a torrent_dto_t
+    torrent_dto_t* dto = parse_torrent_json(json);
+
+    // THEN: Only the string URLs should be kept, NULL-terminated
+    TEST_ASSERT_NOT_NULL(dto);
+    TEST_ASSERT_NOT_NULL(dto->web_seeds);
+    TEST_ASSERT_EQUAL_STRING("https://a.example/", dto->web_seeds[0]);
+    TEST_ASSERT_EQUAL_STRING("https://b.example/", dto->web_seeds[1]);
+    TEST_ASSERT_NULL(dto->web_seeds[2]);
+
+    torrent_dto_free(dto);
+}
+
+static void shouldPass_whenParsingLargeTorrentPage(void) {
+    // GIVEN: A page of thousands of torrents, more than the arena first holds
+    const int count = 5000;
+    GString* json = g_string_new("{\"content\": [");
+    for (int i = 0; i < count; i++) {
+        g_string_append_printf(json,
+                               "%s{\"id\": %d, \"name\": \"repo-%d\", "
+                               "\"webSeeds\": [\"https://%d.example/\"]}",
+                               i ? "," : "", i, i, i);
+    }
+    g_string_append(json, "], \"totalElements\": 5000}");
+
+    // WHEN: Parse the JSON into a torrent_list_t
+    torrent_list_t* list = parse_torrent_list_json(json->str);
+
+    // THEN: Every torrent should be parsed in order with its strings
+    TEST_ASSERT_NOT_NULL(list);
+    TEST_ASSERT_EQUAL_UINT(count, list->len);
+    for (int i = 0; i < count; i += 1249) {
+        gchar* name = g_strdup_printf("repo-%d", i);
+        gchar* seed = g_strdup_printf("https://%d.example/", i);
+        TEST_ASSERT_EQUAL_INT64(i, list->torrents[i].id);
+        TEST_ASSERT_EQUAL_STRING(name, list->torrents[i].name);
+        TEST_ASSERT_EQUAL_STRING(seed, list->torrents[i].web_seeds[0]);
+        TEST_ASSERT_NULL(list->torrents[i].web_seeds[1]);
+        g_free(seed);
+        g_free(name);
+    }
+
+    // Torrents of a list are freed with it, not on their own
+    torrent_dto_free(&list->torrents[0]);
+    torrent_list_free(list);
+    g_string_free(json, TRUE);
+}
+
+static void shouldPass_whenParsingListThatIsNotAList(void) {
+    // GIVEN: A single torrent object rather than a list
+    const char* json = "{\"id\": 69, \"name\": \"repo\"}";
+
+    // WHEN: Parse it as a torrent list
+    torrent_list_t* list = parse_torrent_list_json(json);
+
+    // THEN: It should be rejected
+    TEST_ASSERT_NULL(list);
+}
+
+static void shouldPass_whenFetchingTorrentWithWebSeedsFromServer(void) {
+    // GIVEN: A local server standing in for the API and a web seed
+    const char repo_id[] = "0123456789abcdef0123456789abcdef01234567";
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    char* url = http_server_url(server);
+
+    gchar* dto_path =
+        g_build_filename(root, "api", "torrents", "repository", repo_id, NULL);
+    gchar* dto_json = g_strdup_printf(
+        "{\"id\": 7, \"repoId\": \"%s\", \"webSeeds\": [\"%s/seed/\"]}",
+        repo_id, url);
+    write_test_file(dto_path, dto_json);
+
+    gchar* file_path =
+        g_build_filename(root, "api", "torrents", "7", "file", NULL);
+    write_test_file(file_path, "d4:infod4:name40:stubee");
+
+    gchar* head_path = g_build_filename(root, "seed", repo_id, "HEAD", NULL);
+    write_test_file(head_path, "ref: refs/heads/main\n");
+
+    // WHEN: Get the torrent by repository ID and download its file
+    api_result_e result = API_CURL_ERR;
+    torrent_dto_t* dto = api_get_torrent_by_repo_id(repo_id, &result);
+    gchar* torrent_path = g_build_filename(TEST_DIR, "out.torrent", NULL);
+    int err = dto ? api_get_torrent_file(dto->id, torrent_path, &result) : -1;
+
+    // THEN: The web seed should point at the server, which serves the repo
+    TEST_ASSERT_NOT_NULL(dto);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(API_OK, result);
+    TEST_ASSERT_EQUAL_STRING(repo_id, dto->repo_id);
+    TEST_ASSERT_NOT_NULL(dto->web_seeds);
+    gchar* expected_seed = g_strdup_printf("%s/seed/", url);
+    TEST_ASSERT_EQUAL_STRING(expected_seed, dto->web_seeds[0]);
+
+    // Web seeds are read in byte ranges of the repository's files
+    CURL* curl = curl_easy_init();
+    gchar* head_url =
+        g_strdup_printf("%s%s/HEAD", dto->web_seeds[0], repo_id);
+    response_buf_t head = response_buf_init();
+    curl_easy_setopt(curl, CURLOPT_URL, head_url);
+    curl_easy_setopt(curl, CURLOPT_RANGE, "0-2");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &head);
+    TEST_ASSERT_EQUAL(CURLE_OK, curl_easy_perform(curl));
+    TEST_ASSERT_EQUAL_STRING("ref", head.data);
+    TEST_ASSERT_EQUAL(3, http_server_requests(server));
+    curl_easy_cleanup(curl);
+    g_free(head.data);
+    g_free(head_url);
+
+    gchar* contents = NULL;
+    TEST_ASSERT_TRUE(g_file_get_contents(torrent_path, &contents, NULL, NULL));
+    TEST_ASSERT_EQUAL_STRING("d4:infod4:name40:stubee", contents);
+
+    g_free(contents);
+    g_free(expected_seed);
+    torrent_dto_free(dto);
+    http_server_stop(server);
+    remove_tree(root);
+    unlink(torrent_path);
+    unlink(".gittorconfig");
+    g_free(torrent_path);
+    g_free(head_path);
+    g_free(file_path);
+    g_free(dto_json);
+    g_free(dto_path);
+    g_free(url);
+    g_free(root);
+}
+
+static void shouldPass_whenRevalidatingCachedTorrent(void) {
+    // GIVEN: A local server standing in for the API, tagging its responses
+    const char repo_id[] = "5555555555555555555555555555555555555555";
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    gchar* dto_path =
+        g_build_filename(root, "api", "torrents", "repository", repo_id, NULL);
+    write_test_file(dto_path, "{\"id\": 9, \"name\": \"cached\"}");
+    gchar* file_path =
+        g_build_filename(root, "api", "torrents", "9", "file", NULL);
+    write_test_file(file_path, "d4:infod4:name6:cachedee");
+
+    int hits = 0;
+    int misses = 0;
+    api_cache_stats(&hits, &misses);
+
+    // WHEN: Get the torrent and its file twice, then once more with a TTL
+    api_result_e result = API_CURL_ERR;
+    gchar* torrent_path = g_build_filename(TEST_DIR, "cached.torrent", NULL);
+    for (int i = 0; i < 2; i++) {
+        torrent_dto_t* dto = api_get_torrent_by_repo_id(repo_id, &result);
+        TEST_ASSERT_NOT_NULL(dto);
+        TEST_ASSERT_EQUAL_STRING("cached", dto->name);
+        TEST_ASSERT_EQUAL(0, api_get_torrent_file(dto->id, torrent_path,
+                                                  &result));
+        torrent_dto_free(dto);
+    }
+    int revalidated = http_server_requests(server);
+    config_set(CONFIG_SCOPE_LOCAL,
+               &(config_id_t){.group = "network", .key = "cache_ttl"},
+               "3600");
+    torrent_dto_t* dto = api_get_torrent_by_repo_id(repo_id, &result);
+
+    // THEN: The second round should be 304s, the last one not even a request
+    int new_hits = 0;
+    int new_misses = 0;
+    api_cache_stats(&new_hits, &new_misses);
+    TEST_ASSERT_NOT_NULL(dto);
+    TEST_ASSERT_EQUAL_STRING("cached", dto->name);
+    TEST_ASSERT_EQUAL(4, revalidated);
+    TEST_ASSERT_EQUAL(4, http_server_requests(server));
+    TEST_ASSERT_EQUAL(3, new_hits - hits);
+    TEST_ASSERT_EQUAL(2, new_misses - misses);
+    gchar* contents = NULL;
+    TEST_ASSERT_TRUE(g_file_get_contents(torrent_path, &contents, NULL, NULL));
+    TEST_ASSERT_EQUAL_STRING("d4:infod4:name6:cachedee", contents);
+
+    gchar* cache_dir =
+        g_build_filename(g_get_user_config_dir(), "gittor", "cache", NULL);
+    remove_tree(cache_dir);
+    g_free(cache_dir);
+    g_free(contents);
+    torrent_dto_free(dto);
+    http_server_stop(server);
+    remove_tree(root);
+    unlink(torrent_path);
+    unlink(".gittorconfig");
+    g_free(torrent_path);
+    g_free(file_path);
+    g_free(dto_path);
+    g_free(root);
+}
+
+static void shouldPass_whenEvictingLeastRecentlyUsed(void) {
+    // GIVEN: A local server with two .torrent files, and a cache with room
+    // for only one of them
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    gchar* first_path =
+        g_build_filename(root, "api", "torrents", "21", "file", NULL);
+    gchar* second_path =
+        g_build_filename(root, "api", "torrents", "22", "file", NULL);
+    write_test_file(first_path, "d4:infod4:name5:firstee");
+    write_test_file(second_path, "d4:infod4:name6:secondee");
+    config_set(CONFIG_SCOPE_LOCAL,
+               &(config_id_t){.group = "network", .key = "cache_size"}, "30");
+    int hits = 0;
+    int misses = 0;
+    api_cache_stats(&hits, &misses);
+
+    // WHEN: Get the first, then the second twice, then the first again
+    api_result_e result = API_CURL_ERR;
+    gchar* torrent_path = g_build_filename(TEST_DIR, "evicted.torrent", NULL);
+    const int ids[] = {21, 22, 22, 21};
+    for (size_t i = 0; i < sizeof(ids) / sizeof(*ids); i++) {
+        TEST_ASSERT_EQUAL(0, api_get_torrent_file(ids[i], torrent_path,
+                                                  &result));
+        TEST_ASSERT_EQUAL(API_OK, result);
+    }
+
+    // THEN: Storing the second should have evicted the first, so only the
+    // second is revalidated and the cache holds one response
+    int new_hits = 0;
+    int new_misses = 0;
+    api_cache_stats(&new_hits, &new_misses);
+    TEST_ASSERT_EQUAL(1, new_hits - hits);
+    TEST_ASSERT_EQUAL(3, new_misses - misses);
+    TEST_ASSERT_EQUAL(4, http_server_requests(server));
+    gchar* cache_dir =
+        g_build_filename(g_get_user_config_dir(), "gittor", "cache", NULL);
+    GDir* dir = g_dir_open(cache_dir, 0, NULL);
+    TEST_ASSERT_NOT_NULL(dir);
+    int files = 0;
+    while (g_dir_read_name(dir)) {
+        files++;
+    }
+    g_dir_close(dir);
+    TEST_ASSERT_EQUAL(2, files);
+
+    remove_tree(cache_dir);
+    g_free(cache_dir);
+    http_server_stop(server);
+    remove_tree(root);
+    unlink(torrent_path);
+    unlink(".gittorconfig");
+    g_free(torrent_path);
+    g_free(second_path);
+    g_free(first_path);
+    g_free(root);
+}
+
+static void shouldPass_whenResumingInterruptedDownload(void) {
+    // GIVEN: A server with two copies of a .torrent, and downloads of them
+    // that stopped partway, one of this version and one of an older version
+    const char contents[] = "d4:infod4:name7:resumedee";
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    gchar* file_path =
+        g_build_filename(root, "api", "torrents", "11", "file", NULL);
+    gchar* other_path =
+        g_build_filename(root, "api", "torrents", "12", "file", NULL);
+    write_test_file(file_path, contents);
+    write_test_file(other_path, contents);
+    gchar* hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, contents, -1);
+    gchar* etag = g_strdup_printf("\"%s\"", hash);
+
+    // The kept bytes differ from the server's, showing which were reused
+    gchar* resumed_path = g_build_filename(TEST_DIR, "resumed.torrent", NULL);
+    gchar* resumed_part = g_strconcat(resumed_path, ".part", NULL);
+    gchar* resumed_etag = g_strconcat(resumed_path, ".part.etag", NULL);
+    write_test_file(resumed_part, "D4:INFO");
+    write_test_file(resumed_etag, etag);
+    gchar* stale_path = g_build_filename(TEST_DIR, "stale.torrent", NULL);
+    gchar* stale_part = g_strconcat(stale_path, ".part", NULL);
+    gchar* stale_etag = g_strconcat(stale_path, ".part.etag", NULL);
+    write_test_file(stale_part, "D4:INFO");
+    write_test_file(stale_etag, "\"old\"");
+
+    // WHEN: Download the file to both
+    api_result_e resumed_result = API_CURL_ERR;
+    int resumed_err = api_get_torrent_file(11, resumed_path, &resumed_result);
+    api_result_e stale_result = API_CURL_ERR;
+    int stale_err = api_get_torrent_file(12, stale_path, &stale_result);
+
+    // THEN: The first should continue after the kept bytes, the second start
+    // over, and both be renamed into place
+    TEST_ASSERT_EQUAL(0, resumed_err);
+    TEST_ASSERT_EQUAL(API_OK, resumed_result);
+    TEST_ASSERT_EQUAL(0, stale_err);
+    TEST_ASSERT_EQUAL(API_OK, stale_result);
+    gchar* resumed = NULL;
+    gchar* restarted = NULL;
+    TEST_ASSERT_TRUE(g_file_get_contents(resumed_path, &resumed, NULL, NULL));
+    TEST_ASSERT_TRUE(g_file_get_contents(stale_path, &restarted, NULL, NULL));
+    TEST_ASSERT_EQUAL_STRING("D4:INFOd4:name7:resumedee", resumed);
+    TEST_ASSERT_EQUAL_STRING(contents, restarted);
+    TEST_ASSERT_FALSE(g_file_test(resumed_part, G_FILE_TEST_EXISTS));
+    TEST_ASSERT_FALSE(g_file_test(resumed_etag, G_FILE_TEST_EXISTS));
+    TEST_ASSERT_FALSE(g_file_test(stale_part, G_FILE_TEST_EXISTS));
+    TEST_ASSERT_FALSE(g_file_test(stale_etag, G_FILE_TEST_EXISTS));
+
+    gchar* cache_dir =
+        g_build_filename(g_get_user_config_dir(), "gittor", "cache", NULL);
+    remove_tree(cache_dir);
+    g_free(cache_dir);
+    g_free(restarted);
+    g_free(resumed);
+    http_server_stop(server);
+    remove_tree(root);
+    unlink(resumed_path);
+    unlink(stale_path);
+    unlink(".gittorconfig");
+    g_free(stale_etag);
+    g_free(stale_part);
+    g_free(stale_path);
+    g_free(resumed_etag);
+    g_free(resumed_part);
+    g_free(resumed_path);
+    g_free(etag);
+    g_free(hash);
+    g_free(other_path);
+    g_free(file_path);
+    g_free(root);
+}
+
+typedef struct {
+    api_multi_t* multi;
+    int torrents;
+    int files;
+} batch_t;
+
+static void on_batch_file(api_result_e result,
+                          const response_buf_t* response,
+                          void* userdata) {
+    batch_t* batch = userdata;
+    TEST_ASSERT_NULL(response);
+    if (result == API_OK)
+        batch->files++;
+}
+
+static void on_batch_torrent(api_result_e result,
+                             torrent_dto_t* dto,
+                             void* userdata) {
+    batch_t* batch = userdata;
+    if (result != API_OK || !dto) {
+        torrent_dto_free(dto);
+        return;
+    }
+    batch->torrents++;
+
+    // Queue the file download from the callback, as bulk leech would
+    gchar* name = g_strdup_printf("out-%" PRId64 ".torrent", dto->id);
+    gchar* path = g_build_filename(TEST_DIR, name, NULL);
+    api_multi_get_torrent_file(batch->multi, dto->id, path, on_batch_file,
+                               batch);
+    g_free(path);
+    g_free(name);
+    torrent_dto_free(dto);
+}
+
+static void shouldPass_whenFetchingManyTorrentsConcurrently(void) {
+    // GIVEN: A local server standing in for the API with three torrents
+    const char* repo_ids[] = {"1111111111111111111111111111111111111111",
+                              "2222222222222222222222222222222222222222",
+                              "3333333333333333333333333333333333333333"};
+    const int count = sizeof(repo_ids) / sizeof(*repo_ids);
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    for (int i = 0; i < count; i++) {
+        gchar* dto_path = g_build_filename(root, "api", "torrents",
+                                           "repository", repo_ids[i], NULL);
+        gchar* dto_json = g_strdup_printf("{\"id\": %d, \"repoId\": \"%s\"}",
+                                          i + 1, repo_ids[i]);
+        write_test_file(dto_path, dto_json);
+        gchar* id = g_strdup_printf("%d", i + 1);
+        gchar* file_path =
+            g_build_filename(root, "api", "torrents", id, "file", NULL);
+        write_test_file(file_path, "d4:infod4:name4:stubee");
+        g_free(file_path);
+        g_free(id);
+        g_free(dto_json);
+        g_free(dto_path);
+    }
+
+    // WHEN: Look up every repository in one batch, plus a missing one
+    api_result_e result = API_CURL_ERR;
+    batch_t batch = {.multi = api_multi_new(&result)};
+    TEST_ASSERT_NOT_NULL(batch.multi);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL(0, api_multi_get_torrent_by_repo_id(
+                                 batch.multi, repo_ids[i], on_batch_torrent,
+                                 &batch));
+    }
+    TEST_ASSERT_EQUAL(
+        0, api_multi_get_torrent_by_repo_id(
+               batch.multi, "4444444444444444444444444444444444444444",
+               on_batch_torrent, &batch));
+    api_multi_wait(batch.multi);
+    api_multi_free(batch.multi);
+
+    // THEN: Every torrent and file should be fetched
+    TEST_ASSERT_EQUAL(API_OK, result);
+    TEST_ASSERT_EQUAL(count, batch.torrents);
+    TEST_ASSERT_EQUAL(count, batch.files);
+    TEST_ASSERT_EQUAL(2 * count + 1, http_server_requests(server));
+
+    http_server_stop(server);
+    remove_tree(root);
+    for (int i = 0; i < count; i++) {
+        gchar* name = g_strdup_printf("out-%d.torrent", i + 1);
+        gchar* path = g_build_filename(TEST_DIR, name, NULL);
+        unlink(path);
+        g_free(path);
+        g_free(name);
+    }
+    unlink(".gittorconfig");
+    g_free(root);
+}
+
+typedef struct {
+    GHashTable* seen;
+    int found;
+    int missing;
+} lookup_counts_t;
+
+static void on_lookup(const char* repo_id,
+                      api_result_e result,
+                      torrent_dto_t* dto,
+                      void* userdata) {
+    lookup_counts_t* counts = userdata;
+    TEST_ASSERT_TRUE(g_hash_table_add(counts->seen, g_strdup(repo_id)));
+    if (result == API_OK) {
+        TEST_ASSERT_EQUAL_STRING(repo_id, dto->repo_id);
+        counts->found++;
+    } else if (result == API_NOT_FOUND) {
+        TEST_ASSERT_NULL(dto);
+        counts->missing++;
+    }
+    torrent_dto_free(dto);
+}
+
+static void shouldPass_whenLookingUpManyRepositories(void) {
+    // GIVEN: A local server knowing 150 of 200 repositories, more than the
+    // lookups kept in flight at once
+    const int count = 200;
+    const int known = 150;
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    gchar** repo_ids = g_new0(gchar*, count + 1);
+    for (int i = 0; i < count; i++) {
+        repo_ids[i] = g_strdup_printf("%040x", i);
+        if (i < known) {
+            gchar* dto_path = g_build_filename(root, "api", "torrents",
+                                               "repository", repo_ids[i], NULL);
+            gchar* dto_json = g_strdup_printf(
+                "{\"id\": %d, \"repoId\": \"%s\"}", i + 1, repo_ids[i]);
+            write_test_file(dto_path, dto_json);
+            g_free(dto_json);
+            g_free(dto_path);
+        }
+    }
+
+    // WHEN: Look them all up in one call
+    lookup_counts_t counts = {
+        .seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL)};
+    api_result_e result = API_CURL_ERR;
+    api_multi_t* multi = api_multi_new(&result);
+    int err = api_get_torrents_by_repo_ids(
+        multi, (const char* const*)repo_ids, count, on_lookup, &counts);
+    api_multi_free(multi);
+
+    // THEN: Every repository should be reported once, with one request each
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(API_OK, result);
+    TEST_ASSERT_EQUAL(count, g_hash_table_size(counts.seen));
+    TEST_ASSERT_EQUAL(known, counts.found);
+    TEST_ASSERT_EQUAL(count - known, counts.missing);
+    TEST_ASSERT_EQUAL(count, http_server_requests(server));
+
+    g_hash_table_destroy(counts.seen);
+    http_server_stop(server);
+    remove_tree(root);
+    unlink(".gittorconfig");
+    g_strfreev(repo_ids);
+    g_free(root);
+}
+
+static void shouldPass_whenCountingBytesOnTheWire(void) {
+    // GIVEN: A local server standing in for the API with one torrent
+    const char* json = "{\"id\": 7, \"name\": \"counted\"}";
+    gchar* root = g_build_filename(TEST_DIR, "www", NULL);
+    gchar* dto_path = g_build_filename(root, "api", "torrents", "7", NULL);
+    write_test_file(dto_path, json);
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+    uint64_t received = 0;
+    uint64_t sent = 0;
+    api_wire_stats(&received, &sent);
+
+    // WHEN: Get the torrent
+    api_result_e result = API_CURL_ERR;
+    torrent_dto_t* dto = api_get_torrent(7, &result);
+
+    // THEN: The request and the whole response should be counted
+    uint64_t new_received = 0;
+    uint64_t new_sent = 0;
+    api_wire_stats(&new_received, &new_sent);
+    TEST_ASSERT_EQUAL(API_OK, result);
+    TEST_ASSERT_NOT_NULL(dto);
+    TEST_ASSERT_TRUE(new_received - received > strlen(json));
+    TEST_ASSERT_TRUE(new_sent > sent);
+
+    torrent_dto_free(dto);
+    http_server_stop(server);
+    remove_tree(root);
+    unlink(".gittorconfig");
+    g_free(dto_path);
+    g_free(root);
+}
+
 int main() {
     UNITY_BEGIN();
     api_init();
@@ -343,6 +886,26 @@ int main() {
 
     RUN_TEST(shouldPass_whenFreeingNullDto);
 
+    RUN_TEST(shouldPass_whenParsingWithWebSeeds);
+
+    RUN_TEST(shouldPass_whenParsingLargeTorrentPage);
+
+    RUN_TEST(shouldPass_whenParsingListThatIsNotAList);
+
+    RUN_TEST(shouldPass_whenFetchingTorrentWithWebSeedsFromServer);
+
+    RUN_TEST(shouldPass_whenFetchingManyTorrentsConcurrently);
+
+    RUN_TEST(shouldPass_whenRevalidatingCachedTorrent);
+
+    RUN_TEST(shouldPass_whenEvictingLeastRecentlyUsed);
+
+    RUN_TEST(shouldPass_whenResumingInterruptedDownload);
+
+    RUN_TEST(shouldPass_whenLookingUpManyRepositories);
+
+    RUN_TEST(shouldPass_whenCountingBytesOnTheWire);
+
     api_cleanup();
     return UNITY_END();
 }
@@ -6,6 +6,7 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include "cmd/cmd.h"
+#include "config/config.h"
 #include "unity/unity.h"
 #include "utils/utils.h"
 
@@ -245,6 +246,84 @@ static void shouldPass_whenGetCannotFindGlobal() {
                               "Did not return error getting config");
 }
 
+static void shouldPass_whenConfigChangesBetweenLookups() {
+    // GIVEN: A value read once, so the local config is parsed and kept
+    config_id_t id = {.group = "user", .key = "name"};
+    TEST_ASSERT_EQUAL(0, config_set(CONFIG_SCOPE_LOCAL, &id, "Alice"));
+    char* before = config_get(CONFIG_SCOPE_LOCAL, &id, NULL);
+
+    // WHEN: Another process rewrites the file, likely within the same second
+    TEST_ASSERT_TRUE(g_file_set_contents(".gittorconfig",
+                                         "[user]\nname=Bob\n", -1, NULL));
+    char* after = config_get(CONFIG_SCOPE_LOCAL, &id, NULL);
+
+    // THEN: The new value should be read
+    TEST_ASSERT_EQUAL_STRING("Alice", before);
+    TEST_ASSERT_EQUAL_STRING("Bob", after);
+    g_free(after);
+    g_free(before);
+    unlink(".gittorconfig");
+}
+
+static void shouldPass_whenGettingTypedValues() {
+    // GIVEN: Numbers, flags and lists in the local and global configs
+    TEST_ASSERT_TRUE(g_file_set_contents(
+        ".gittorconfig",
+        "[network]\ncache_ttl=60\nport=not a number\nlsd=no\n"
+        "tracker=udp://a;udp://b\ntracker1=udp://c\n",
+        -1, NULL));
+    gchar* global_path = global_config_path();
+    TEST_ASSERT_TRUE(g_file_set_contents(
+        global_path, "[network]\ntracker1=udp://x\ntracker2=udp://y\n", -1,
+        NULL));
+
+    // WHEN: Get them as their types
+    gint64 ttl = config_get_int(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "cache_ttl"}, 0);
+    gint64 port = config_get_int(
+        CONFIG_SCOPE_LOCAL, &(config_id_t){.group = "network", .key = "port"},
+        6881);
+    gboolean lsd = config_get_bool(
+        CONFIG_SCOPE_LOCAL, &(config_id_t){.group = "network", .key = "lsd"},
+        TRUE);
+    gboolean lan_only = config_get_bool(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "lan_only"}, FALSE);
+    gchar** local = config_get_list(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "tracker"});
+    gchar** global = config_get_list(
+        CONFIG_SCOPE_GLOBAL,
+        &(config_id_t){.group = "network", .key = "tracker"});
+    gchar** none = config_get_list(
+        CONFIG_SCOPE_LOCAL,
+        &(config_id_t){.group = "network", .key = "missing"});
+
+    // THEN: Values that don't parse should fall back to the default, and the
+    // most specific list should win
+    TEST_ASSERT_EQUAL_INT64(60, ttl);
+    TEST_ASSERT_EQUAL_INT64(6881, port);
+    TEST_ASSERT_FALSE(lsd);
+    TEST_ASSERT_FALSE(lan_only);
+    TEST_ASSERT_EQUAL_UINT(3, g_strv_length(local));
+    TEST_ASSERT_EQUAL_STRING("udp://a", local[0]);
+    TEST_ASSERT_EQUAL_STRING("udp://b", local[1]);
+    TEST_ASSERT_EQUAL_STRING("udp://c", local[2]);
+    TEST_ASSERT_EQUAL_UINT(2, g_strv_length(global));
+    TEST_ASSERT_EQUAL_STRING("udp://x", global[0]);
+    TEST_ASSERT_EQUAL_STRING("udp://y", global[1]);
+    TEST_ASSERT_NOT_NULL(none);
+    TEST_ASSERT_NULL(none[0]);
+
+    g_strfreev(none);
+    g_strfreev(global);
+    g_strfreev(local);
+    unlink(global_path);
+    g_free(global_path);
+    unlink(".gittorconfig");
+}
+
 int main() {
     UNITY_BEGIN();
 
@@ -284,5 +363,13 @@ int main() {
     RUN_TEST(shouldPass_whenGetCannotFindGlobal);
     tearDown();
 
+    setUp();
+    RUN_TEST(shouldPass_whenConfigChangesBetweenLookups);
+    tearDown();
+
+    setUp();
+    RUN_TEST(shouldPass_whenGettingTypedValues);
+    tearDown();
+
     return UNITY_END();
 }
@@ -1,6 +1,10 @@
 #include <errno.h>
+#include <git2.h>
 #include <glib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <unistd.h>
+#include <glib/gstdio.h>
 #include "cmd/cmd.h"
 #include "unity/unity.h"
 #include "utils/utils.h"
@@ -67,11 +71,448 @@ static void shouldPass_whenDirectoryEmpty() {
     TEST_ASSERT_EQUAL(0, err);
 }
 
+static void shouldPass_whenCheckedOutTreeIsClean() {
+    // Create temporary directory for repo
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+
+    // GIVEN: Init with repository name as directory
+    char* argv[] = {"gittor", "-p", dir, "init", "repoName", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int err = cmd_parse(argc, argv);
+
+    // WHEN: Get the status of the checked out working tree
+    git_repository* repo = NULL;
+    git_status_list* status = NULL;
+    gchar* path = g_build_filename(dir, "repoName", NULL);
+    gchar* index = g_build_filename(path, ".git", "index", NULL);
+    git_libgit2_init();
+    if (!err) {
+        err = git_repository_open(&repo, path);
+    }
+    if (!err) {
+        err = git_status_list_new(&status, repo, NULL);
+    }
+    size_t changes = status ? git_status_list_entrycount(status) : 1;
+    bool indexed = g_file_test(index, G_FILE_TEST_IS_REGULAR);
+    git_status_list_free(status);
+    git_repository_free(repo);
+    git_libgit2_shutdown();
+    g_free(index);
+    g_free(path);
+    tempdir_destroy(dir);
+
+    // THEN: Should have written the index and have no changes
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_TRUE(indexed);
+    TEST_ASSERT_EQUAL(0, changes);
+}
+
+static void shouldPass_whenInitRecordsRepoId() {
+    // Create temporary directory for repo
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+
+    // GIVEN: Init with repository name as directory
+    char* argv[] = {"gittor", "-p", dir, "init", "repoName", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int err = cmd_parse(argc, argv);
+
+    // WHEN: Read the ID recorded in the clone's config
+    git_repository* repo = NULL;
+    git_config* cfg = NULL;
+    git_buf recorded = {0};
+    git_oid head;
+    char expected[GIT_OID_HEXSZ + 1] = {0};
+    gchar* path = g_build_filename(dir, "repoName", NULL);
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+    if (!err) {
+        err = git_repository_open(&repo, path);
+    }
+    if (!err) {
+        err = git_reference_name_to_id(&head, repo, "HEAD");
+    }
+    if (!err) {
+        git_oid_tostr(expected, sizeof(expected), &head);
+        err = git_repository_config_snapshot(&cfg, repo);
+    }
+    if (!err) {
+        err = git_config_get_string_buf(&recorded, cfg, "gittor.repoid");
+    }
+
+    // THEN: Should be the ID of its only commit
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL_STRING(expected, recorded.ptr);
+
+    git_buf_dispose(&recorded);
+    git_config_free(cfg);
+    git_repository_free(repo);
+    g_free(path);
+    tempdir_destroy(dir);
+}
+
+// Commit a chain of empty commits, a second apart, returning the first
+static int commit_history(git_repository* repo, int count, git_oid* root) {
+    git_oid parent;
+    int err = 0;
+    for (int i = 0; i < count && !err; i++) {
+        err = commit_file(repo, "HEAD", NULL, i ? &parent : NULL,
+                          1000000000 + i, &parent, NULL);
+        if (!err && i == 0) {
+            git_oid_cpy(root, &parent);
+        }
+    }
+    return err;
+}
+
+static void shouldPass_whenRepoIdRecorded() {
+    // GIVEN: A repository with a long history and no recorded ID
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    git_libgit2_init();
+    git_repository* repo = NULL;
+    git_oid root;
+    int err = git_repository_init(&repo, dir, false);
+    if (!err) {
+        err = commit_history(repo, 10000, &root);
+    }
+    TEST_ASSERT_EQUAL(0, err);
+    char expected[GIT_OID_HEXSZ + 1] = {0};
+    git_oid_tostr(expected, sizeof(expected), &root);
+
+    // WHEN: Get its ID twice, then once more after recording a bad one
+    char walked[GIT_OID_HEXSZ + 1] = {0};
+    char recorded[GIT_OID_HEXSZ + 1] = {0};
+    char fixed[GIT_OID_HEXSZ + 1] = {0};
+    gint64 start = g_get_monotonic_time();
+    int walked_err = gittor_get_repo_id(walked, sizeof(walked), repo);
+    gint64 walk_time = g_get_monotonic_time() - start;
+    start = g_get_monotonic_time();
+    int recorded_err = gittor_get_repo_id(recorded, sizeof(recorded), repo);
+    gint64 recorded_time = g_get_monotonic_time() - start;
+
+    git_reference* head = NULL;
+    char tip[GIT_OID_HEXSZ + 1] = {0};
+    if (!git_repository_head(&head, repo)) {
+        git_oid_tostr(tip, sizeof(tip), git_reference_target(head));
+    }
+    git_reference_free(head);
+    gittor_set_repo_id(repo, tip);
+    int fixed_err = gittor_get_repo_id(fixed, sizeof(fixed), repo);
+
+    gchar* timing = g_strdup_printf(
+        "Repository ID of 10000 commits: %" G_GINT64_FORMAT
+        " us walked, %" G_GINT64_FORMAT " us recorded",
+        walk_time, recorded_time);
+    TEST_MESSAGE(timing);
+    g_free(timing);
+
+    // THEN: Should always be the first commit, ignoring a non-root ID
+    TEST_ASSERT_EQUAL(0, walked_err);
+    TEST_ASSERT_EQUAL(0, recorded_err);
+    TEST_ASSERT_EQUAL(0, fixed_err);
+    TEST_ASSERT_EQUAL_STRING(expected, walked);
+    TEST_ASSERT_EQUAL_STRING(expected, recorded);
+    TEST_ASSERT_EQUAL_STRING(expected, fixed);
+    TEST_ASSERT_LESS_THAN(walk_time, recorded_time);
+
+    git_repository_free(repo);
+    git_libgit2_shutdown();
+    remove_tree(dir);
+    g_free(dir);
+}
+
+static void shouldPass_whenReopeningRepo() {
+    // GIVEN: A repository that was opened and closed
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+    git_repository* repo = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_init(&repo, dir, false));
+    git_repository_free(repo);
+    git_repository* first = NULL;
+    TEST_ASSERT_EQUAL(0, gittor_repo_open(&first, dir));
+    gittor_repo_close(first);
+
+    // WHEN: Open it again, once by its .git directory while it is in use
+    git_repository* again = NULL;
+    git_repository* other = NULL;
+    gchar* git_dir = g_build_filename(dir, ".git", NULL);
+    int again_err = gittor_repo_open(&again, dir);
+    int other_err = gittor_repo_open(&other, git_dir);
+
+    // THEN: Should reuse the idle handle, but not hand it out twice
+    TEST_ASSERT_EQUAL(0, again_err);
+    TEST_ASSERT_EQUAL(0, other_err);
+    TEST_ASSERT_EQUAL_PTR(first, again);
+    TEST_ASSERT_TRUE(again != other);
+
+    gittor_repo_close(again);
+    gittor_repo_close(other);
+    g_free(git_dir);
+    remove_tree(dir);
+    g_free(dir);
+}
+
+static void shouldPass_whenReopeningReplacedRepo() {
+    // GIVEN: A closed bare repository that was deleted and created again
+    // with a working directory
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+    gchar* path = g_build_filename(dir, "repo", NULL);
+    git_repository* repo = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_init(&repo, path, true));
+    git_repository_free(repo);
+    git_repository* first = NULL;
+    TEST_ASSERT_EQUAL(0, gittor_repo_open(&first, path));
+    gittor_repo_close(first);
+    remove_tree(path);
+    TEST_ASSERT_EQUAL(0, git_repository_init(&repo, path, false));
+    git_repository_free(repo);
+
+    // WHEN: Open it again
+    git_repository* again = NULL;
+    int err = gittor_repo_open(&again, path);
+
+    // THEN: Should open the new repository rather than reuse the old handle
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_FALSE(git_repository_is_bare(again));
+
+    gittor_repo_close(again);
+    remove_tree(dir);
+    g_free(path);
+    g_free(dir);
+}
+
+// Commit a tree with nested directories, an executable and a symlink, and
+// optionally a .gitattributes asking for CRLF line endings
+static int commit_tree(git_repository* repo, bool attributes) {
+    const struct {
+        const char* path;
+        const char* contents;
+        git_filemode_t mode;
+    } files[] = {
+        {"README", "readme\n", GIT_FILEMODE_BLOB},
+        {"bin/run.sh", "#!/bin/sh\necho run\n", GIT_FILEMODE_BLOB_EXECUTABLE},
+        {"src/lib/deep/file.c", "int x;\n", GIT_FILEMODE_BLOB},
+        {"src/notes.txt", "one\ntwo\n", GIT_FILEMODE_BLOB},
+        {"link", "src/lib/deep/file.c", GIT_FILEMODE_LINK},
+        {".gitattributes", "*.txt eol=crlf\n", GIT_FILEMODE_BLOB},
+    };
+    size_t count = sizeof(files) / sizeof(*files) - (attributes ? 0 : 1);
+    git_tree_update updates[sizeof(files) / sizeof(*files)];
+    int err = 0;
+    for (size_t i = 0; i < count && !err; i++) {
+        updates[i] = (git_tree_update){.action = GIT_TREE_UPDATE_UPSERT,
+                                       .filemode = files[i].mode,
+                                       .path = files[i].path};
+        err = git_blob_create_from_buffer(&updates[i].id, repo,
+                                          files[i].contents,
+                                          strlen(files[i].contents));
+    }
+
+    git_treebuilder* builder = NULL;
+    git_tree* empty = NULL;
+    git_tree* tree = NULL;
+    git_signature* sig = NULL;
+    git_oid oid;
+    if (!err) {
+        err = git_treebuilder_new(&builder, repo, NULL);
+    }
+    if (!err) {
+        err = git_treebuilder_write(&oid, builder);
+    }
+    if (!err) {
+        err = git_tree_lookup(&empty, repo, &oid);
+    }
+    if (!err) {
+        err = git_tree_create_updated(&oid, repo, empty, count, updates);
+    }
+    if (!err) {
+        err = git_tree_lookup(&tree, repo, &oid);
+    }
+    if (!err) {
+        err = git_signature_new(&sig, "Alice", "alice@example.com", 1000000000,
+                                0);
+    }
+    if (!err) {
+        err = git_commit_create(&oid, repo, "HEAD", sig, sig, "UTF-8",
+                                "commit", tree, 0, NULL);
+    }
+    git_signature_free(sig);
+    git_tree_free(tree);
+    git_tree_free(empty);
+    git_treebuilder_free(builder);
+    return err;
+}
+
+// Commit the tree into a new repository and check it out, either with our
+// checkout or with libgit2's
+static int check_out(const char* path, bool attributes, bool ours) {
+    git_repository* repo = NULL;
+    int err = git_repository_init(&repo, path, false);
+    if (!err) {
+        err = commit_tree(repo, attributes);
+    }
+    if (!err && ours) {
+        err = gittor_git_checkout(repo);
+    } else if (!err) {
+        git_checkout_options opts;
+        err = git_checkout_options_init(&opts, GIT_CHECKOUT_OPTIONS_VERSION);
+        opts.checkout_strategy = GIT_CHECKOUT_FORCE;
+        if (!err) {
+            err = git_checkout_head(repo, &opts);
+        }
+    }
+    git_repository_free(repo);
+    return err;
+}
+
+// Whether two working trees hold the same files, execute bits and symlinks,
+// leaving out their .git directories
+static bool same_files(const char* a, const char* b) {
+    GDir* dir = g_dir_open(a, 0, NULL);
+    const gchar* name = NULL;
+    bool same = dir != NULL;
+    int entries = 0;
+    while (same && (name = g_dir_read_name(dir))) {
+        if (strcmp(name, ".git") == 0) {
+            continue;
+        }
+        entries++;
+
+        gchar* path_a = g_build_filename(a, name, NULL);
+        gchar* path_b = g_build_filename(b, name, NULL);
+        GStatBuf st_a;
+        GStatBuf st_b;
+        same = !g_lstat(path_a, &st_a) && !g_lstat(path_b, &st_b) &&
+               (st_a.st_mode & S_IFMT) == (st_b.st_mode & S_IFMT);
+        if (same && S_ISDIR(st_a.st_mode)) {
+            same = same_files(path_a, path_b);
+        } else if (same && S_ISLNK(st_a.st_mode)) {
+            gchar* target_a = g_file_read_link(path_a, NULL);
+            gchar* target_b = g_file_read_link(path_b, NULL);
+            same = target_a && target_b && strcmp(target_a, target_b) == 0;
+            g_free(target_b);
+            g_free(target_a);
+        } else if (same) {
+            gchar* contents_a = NULL;
+            gchar* contents_b = NULL;
+            gsize len_a = 0;
+            gsize len_b = 0;
+            same = (st_a.st_mode & S_IXUSR) == (st_b.st_mode & S_IXUSR) &&
+                   g_file_get_contents(path_a, &contents_a, &len_a, NULL) &&
+                   g_file_get_contents(path_b, &contents_b, &len_b, NULL) &&
+                   len_a == len_b && memcmp(contents_a, contents_b, len_a) == 0;
+            g_free(contents_b);
+            g_free(contents_a);
+        }
+        g_free(path_b);
+        g_free(path_a);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+
+    // Nor anything only in the second one
+    dir = same ? g_dir_open(b, 0, NULL) : NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        entries -= strcmp(name, ".git") != 0;
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+    return same && entries == 0;
+}
+
+static void shouldPass_whenCheckingOutLikeLibgit2() {
+    // GIVEN: A tree to check out as is, with a .gitattributes, and with the
+    // user's attributes in $XDG_CONFIG_HOME/git/attributes
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+    gchar* xdg = g_build_filename(dir, "xdg", NULL);
+    gchar* xdg_attributes = g_build_filename(xdg, "attributes", NULL);
+    g_mkdir_with_parents(xdg, 0755);
+    TEST_ASSERT_TRUE(
+        g_file_set_contents(xdg_attributes, "*.txt eol=crlf\n", -1, NULL));
+    const char* names[] = {"plain", "attributes", "xdg"};
+    gchar* ours[3];
+    gchar* theirs[3];
+    for (int i = 0; i < 3; i++) {
+        ours[i] = g_build_filename(dir, names[i], "ours", NULL);
+        theirs[i] = g_build_filename(dir, names[i], "theirs", NULL);
+    }
+
+    // WHEN: Check each out with our checkout and with libgit2's
+    int errors[6];
+    errors[0] = check_out(ours[0], false, true);
+    errors[1] = check_out(theirs[0], false, false);
+    errors[2] = check_out(ours[1], true, true);
+    errors[3] = check_out(theirs[1], true, false);
+    git_libgit2_opts(GIT_OPT_SET_SEARCH_PATH, GIT_CONFIG_LEVEL_XDG, xdg);
+    errors[4] = check_out(ours[2], false, true);
+    errors[5] = check_out(theirs[2], false, false);
+    git_libgit2_opts(GIT_OPT_SET_SEARCH_PATH, GIT_CONFIG_LEVEL_XDG, NULL);
+
+    // THEN: Should write the same files, modes and links as libgit2
+    for (int i = 0; i < 6; i++) {
+        TEST_ASSERT_EQUAL(0, errors[i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_TRUE_MESSAGE(same_files(ours[i], theirs[i]), names[i]);
+    }
+    gchar* script = g_build_filename(ours[0], "bin", "run.sh", NULL);
+    gchar* link = g_build_filename(ours[0], "link", NULL);
+    TEST_ASSERT_TRUE(g_file_test(script, G_FILE_TEST_IS_EXECUTABLE));
+    TEST_ASSERT_TRUE(g_file_test(link, G_FILE_TEST_IS_SYMLINK));
+
+    // THEN: Should apply the attributes, wherever they come from
+    for (int i = 1; i < 3; i++) {
+        gchar* notes = g_build_filename(ours[i], "src", "notes.txt", NULL);
+        gchar* contents = NULL;
+        TEST_ASSERT_TRUE(g_file_get_contents(notes, &contents, NULL, NULL));
+        TEST_ASSERT_EQUAL_STRING("one\r\ntwo\r\n", contents);
+        g_free(contents);
+        g_free(notes);
+    }
+
+    g_free(link);
+    g_free(script);
+    for (int i = 0; i < 3; i++) {
+        g_free(theirs[i]);
+        g_free(ours[i]);
+    }
+    g_free(xdg_attributes);
+    g_free(xdg);
+    remove_tree(dir);
+    g_free(dir);
+}
+
 int main() {
     UNITY_BEGIN();
     RUN_TEST(shouldPass_whenHelpFlag);
     RUN_TEST(shouldPass_whenUsageFlag);
     RUN_TEST(shouldPass_whenDirectoryProvided);
     RUN_TEST(shouldPass_whenDirectoryEmpty);
+    RUN_TEST(shouldPass_whenCheckedOutTreeIsClean);
+    RUN_TEST(shouldPass_whenInitRecordsRepoId);
+    RUN_TEST(shouldPass_whenRepoIdRecorded);
+    RUN_TEST(shouldPass_whenReopeningRepo);
+    RUN_TEST(shouldPass_whenReopeningReplacedRepo);
+    RUN_TEST(shouldPass_whenCheckingOutLikeLibgit2);
     return UNITY_END();
 }
@@ -1,6 +1,156 @@
 #include <errno.h>
+#include <git2.h>
+#include <glib.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include "cmd/cmd.h"
+#include "leech/leech_internal.h"
 #include "unity/unity.h"
+#include "utils/utils.h"
+
+#define HISTORY 20
+
+/// @brief A packed bare repository standing in for a leeched one
+typedef struct {
+    char* dir;
+    char* path;
+    /// @brief Commits of the default branch, oldest first
+    git_oid commits[HISTORY];
+    /// @brief Tip of a branch off the fifth commit
+    git_oid other;
+    /// @brief Blob only the other branch has
+    git_oid other_blob;
+} leeched_t;
+
+static gchar* file_contents(int lines) {
+    GString* text = g_string_new(NULL);
+    for (int i = 0; i < lines; i++) {
+        g_string_append_printf(text, "line %d of the file\n", i);
+    }
+    return g_string_free(text, FALSE);
+}
+
+// Pack every object of the repository and drop the loose copies, as a
+// seeded repository is laid out
+static int pack_all(git_repository* repo) {
+    git_packbuilder* pb = NULL;
+    git_revwalk* walk = NULL;
+    gchar* objects = g_build_filename(git_repository_path(repo), "objects",
+                                      NULL);
+    gchar* packs = g_build_filename(objects, "pack", NULL);
+    int err = git_packbuilder_new(&pb, repo);
+    if (!err) {
+        err = git_revwalk_new(&walk, repo);
+    }
+    if (!err) {
+        err = git_revwalk_push_glob(walk, "refs/heads/*");
+    }
+    if (!err) {
+        err = git_packbuilder_insert_walk(pb, walk);
+    }
+    if (!err) {
+        err = git_packbuilder_write(pb, packs, 0, NULL, NULL);
+    }
+
+    GDir* dir = err ? NULL : g_dir_open(objects, 0, NULL);
+    const gchar* name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        if (strlen(name) == 2) {
+            gchar* loose = g_build_filename(objects, name, NULL);
+            remove_tree(loose);
+            g_free(loose);
+        }
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+
+    git_revwalk_free(walk);
+    git_packbuilder_free(pb);
+    g_free(packs);
+    g_free(objects);
+    return err;
+}
+
+static void leeched_init(leeched_t* leeched) {
+    memset(leeched, 0, sizeof(*leeched));
+    leeched->dir = tempdir_init();
+    if (leeched->dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    leeched->path = g_build_filename(leeched->dir, "leeched.git", NULL);
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+
+    git_repository* repo = NULL;
+    git_oid blob;
+    int err = git_repository_init(&repo, leeched->path, true);
+    for (int i = 0; !err && i < HISTORY; i++) {
+        // Shrinking as history goes on, so that the newest versions are
+        // stored as deltas of older ones
+        gchar* contents = file_contents(400 - i * 10);
+        err = commit_file(repo, "HEAD", contents,
+                          i ? &leeched->commits[i - 1] : NULL, 1000000000,
+                          &leeched->commits[i], &blob);
+        g_free(contents);
+    }
+    if (!err) {
+        err = commit_file(repo, "refs/heads/other", "only on the other branch",
+                          &leeched->commits[4], 1000000000, &leeched->other,
+                          &leeched->other_blob);
+    }
+    if (!err) {
+        err = pack_all(repo);
+    }
+    git_repository_free(repo);
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+static void leeched_clear(leeched_t* leeched) {
+    remove_tree(leeched->dir);
+    g_free(leeched->path);
+    g_free(leeched->dir);
+}
+
+/// @brief Byte ranges asked for by a plan
+typedef struct {
+    /// @brief Every "path@offset" asked for
+    GHashTable* asked;
+    size_t loose;
+    /// @brief Whether the ranges are on disk already
+    bool ready;
+} ranges_t;
+
+static int record_range(const char* path,
+                        uint64_t offset,
+                        __attribute__((__unused__)) uint64_t length,
+                        void* payload) {
+    ranges_t* ranges = payload;
+    if (!g_str_has_prefix(path, "objects/pack/")) {
+        ranges->loose++;
+    }
+    g_hash_table_add(ranges->asked,
+                     g_strdup_printf("%s@%" G_GUINT64_FORMAT, path,
+                                     (guint64)offset));
+    return ranges->ready ? 1 : 0;
+}
+
+// Step a plan of the leeched repository with every range on disk or none
+static int step_plan(const leeched_t* leeched,
+                     const leech_options_t* options,
+                     ranges_t* ranges) {
+    ranges->asked = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          NULL);
+    leech_partial_plan_t* plan =
+        leech_partial_plan_new(leeched->path, options, record_range, ranges);
+    int step = leech_partial_plan_step(plan);
+    leech_partial_plan_free(plan);
+    return step;
+}
 
 static void shouldPass_whenHelpFlag() {
     // GIVEN: Leech with help flag
@@ -14,8 +164,304 @@ static void shouldPass_whenHelpFlag() {
     TEST_ASSERT_EQUAL(0, err);
 }
 
+static void shouldFail_whenDepthNotPositive() {
+    // GIVEN: Leech with a depth of zero commits
+    char* argv[] = {"gittor", "leech", "--depth", "0",
+                    "0123456789abcdef0123456789abcdef01234567", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    // WHEN: Parse arguments
+    int err = cmd_parse(argc, argv);
+
+    // THEN: Should reject the depth
+    TEST_ASSERT_EQUAL(EINVAL, err);
+}
+
+static void shouldPass_whenPlanFindsObjectsInPacks() {
+    // GIVEN: A leeched repository with all of its objects packed
+    leeched_t leeched;
+    leeched_init(&leeched);
+    leech_options_t options = {.depth = 1};
+
+    // WHEN: Step a plan before and after its data arrived
+    ranges_t missing = {.ready = false};
+    ranges_t present = {.ready = true};
+    int missing_step = step_plan(&leeched, &options, &missing);
+    int present_step = step_plan(&leeched, &options, &present);
+
+    // THEN: Should ask for ranges of the pack only, found through its index
+    TEST_ASSERT_EQUAL(1, missing_step);
+    TEST_ASSERT_EQUAL(1, g_hash_table_size(missing.asked));
+    TEST_ASSERT_EQUAL(0, present_step);
+    TEST_ASSERT_EQUAL(0, present.loose);
+    TEST_ASSERT_EQUAL(0, missing.loose);
+
+    g_hash_table_destroy(present.asked);
+    g_hash_table_destroy(missing.asked);
+    leeched_clear(&leeched);
+}
+
+static void shouldPass_whenPlanFollowsDeltaChains() {
+    // GIVEN: A leeched repository whose newest file is a delta of older ones
+    leeched_t leeched;
+    leeched_init(&leeched);
+    leech_options_t shallow = {.depth = 1};
+    leech_options_t full = {0};
+
+    // WHEN: Plan the tip commit alone, and the whole history
+    ranges_t tip = {.ready = true};
+    ranges_t all = {.ready = true};
+    int tip_step = step_plan(&leeched, &shallow, &tip);
+    int all_step = step_plan(&leeched, &full, &all);
+
+    // THEN: Should ask for the bases of the tip's commit, tree and file too,
+    // but never more than every object
+    TEST_ASSERT_EQUAL(0, tip_step);
+    TEST_ASSERT_EQUAL(0, all_step);
+    TEST_ASSERT_GREATER_THAN(3, g_hash_table_size(tip.asked));
+    TEST_ASSERT_LESS_OR_EQUAL(g_hash_table_size(all.asked),
+                              g_hash_table_size(tip.asked));
+
+    g_hash_table_destroy(all.asked);
+    g_hash_table_destroy(tip.asked);
+    leeched_clear(&leeched);
+}
+
+static void shouldPass_whenFetchingLimitedHistory() {
+    // GIVEN: A leeched repository and an empty one to fetch into
+    leeched_t leeched;
+    leeched_init(&leeched);
+    gchar* path = g_build_filename(leeched.dir, "destination", NULL);
+    git_repository* leeched_repo = NULL;
+    git_repository* destination = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_open(&leeched_repo, leeched.path));
+    TEST_ASSERT_EQUAL(0, git_repository_init(&destination, path, false));
+
+    // WHEN: Fetch two commits of the default branch
+    leech_options_t options = {.depth = 2};
+    int err = leech_partial_fetch(destination, leeched_repo, &options);
+
+    // THEN: Should have those two commits only, cut off at the second
+    git_odb* odb = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_odb(&odb, destination));
+    gchar* shallow_path =
+        g_build_filename(git_repository_path(destination), "shallow", NULL);
+    gchar* shallow = NULL;
+    char cut[GIT_OID_HEXSZ + 1] = {0};
+    git_oid_tostr(cut, sizeof(cut), &leeched.commits[HISTORY - 2]);
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_TRUE(git_odb_exists(odb, &leeched.commits[HISTORY - 1]));
+    TEST_ASSERT_TRUE(git_odb_exists(odb, &leeched.commits[HISTORY - 2]));
+    TEST_ASSERT_FALSE(git_odb_exists(odb, &leeched.commits[HISTORY - 3]));
+    TEST_ASSERT_FALSE(git_odb_exists(odb, &leeched.other));
+    TEST_ASSERT_FALSE(git_odb_exists(odb, &leeched.other_blob));
+    TEST_ASSERT_TRUE(g_file_get_contents(shallow_path, &shallow, NULL, NULL));
+    TEST_ASSERT_NOT_NULL(strstr(shallow, cut));
+
+    g_free(shallow);
+    g_free(shallow_path);
+    git_odb_free(odb);
+    git_repository_free(destination);
+    git_repository_free(leeched_repo);
+    g_free(path);
+    leeched_clear(&leeched);
+}
+
+static void shouldPass_whenCloningOneBranch() {
+    // GIVEN: A leeched repository with a second branch
+    leeched_t leeched;
+    leeched_init(&leeched);
+    gchar* path = g_build_filename(leeched.dir, "clone", NULL);
+    git_repository* leeched_repo = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_open(&leeched_repo, leeched.path));
+
+    // WHEN: Clone only the tip of that branch
+    git_repository* clone = NULL;
+    leech_options_t options = {.branch = "other", .depth = 1};
+    int err = leech_partial_clone(&clone, leeched_repo, "file:///leeched",
+                                  path, &options);
+
+    // THEN: Should be a shallow clone of the branch, checked out
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_NOT_NULL(clone);
+    git_reference* head = NULL;
+    git_revwalk* walk = NULL;
+    git_oid oid;
+    int commits = 0;
+    TEST_ASSERT_EQUAL(0, git_repository_head(&head, clone));
+    TEST_ASSERT_EQUAL_STRING("refs/heads/other", git_reference_name(head));
+    TEST_ASSERT_TRUE(git_oid_equal(&leeched.other, git_reference_target(head)));
+    TEST_ASSERT_TRUE(git_repository_is_shallow(clone));
+    TEST_ASSERT_EQUAL(0, git_revwalk_new(&walk, clone));
+    TEST_ASSERT_EQUAL(0, git_revwalk_push_head(walk));
+    while (!git_revwalk_next(&oid, walk)) {
+        commits++;
+    }
+    TEST_ASSERT_EQUAL(1, commits);
+    gchar* file = g_build_filename(path, "file.txt", NULL);
+    gchar* contents = NULL;
+    TEST_ASSERT_TRUE(g_file_get_contents(file, &contents, NULL, NULL));
+    TEST_ASSERT_EQUAL_STRING("only on the other branch", contents);
+
+    g_free(contents);
+    g_free(file);
+    git_revwalk_free(walk);
+    git_reference_free(head);
+    git_repository_free(clone);
+    git_repository_free(leeched_repo);
+    g_free(path);
+    leeched_clear(&leeched);
+}
+
+static void shouldPass_whenLinkingLeechedObjects() {
+    // GIVEN: A leeched repository with a pack and loose objects newer than
+    // it, and an empty clone of it
+    leeched_t leeched;
+    leeched_init(&leeched);
+    git_repository* leeched_repo = NULL;
+    git_oid loose;
+    git_oid loose_blob;
+    TEST_ASSERT_EQUAL(0, git_repository_open(&leeched_repo, leeched.path));
+    TEST_ASSERT_EQUAL(0, commit_file(leeched_repo, "refs/heads/loose",
+                                     "only loose", &leeched.commits[0],
+                                     1000000000, &loose, &loose_blob));
+    gchar* path = g_build_filename(leeched.dir, "clone", NULL);
+    gchar* url = g_strconcat("file://", leeched.path, NULL);
+    git_repository* clone = NULL;
+    git_remote* origin = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_init(&clone, path, false));
+    TEST_ASSERT_EQUAL(0, git_remote_create(&origin, clone, "origin", url));
+
+    // WHEN: Link the objects into the clone, twice, then fetch
+    int linked = gittor_git_link_objects(clone, leeched_repo);
+    int relinked = gittor_git_link_objects(clone, leeched_repo);
+    git_fetch_options opts;
+    git_fetch_options_init(&opts, GIT_FETCH_OPTIONS_VERSION);
+    int fetch_err = git_remote_fetch(origin, NULL, &opts, NULL);
+
+    // THEN: The pack, its index and the three loose objects are shared, once
+    TEST_ASSERT_EQUAL(5, linked);
+    TEST_ASSERT_EQUAL(0, relinked);
+    gchar* packs = g_build_filename(leeched.path, "objects", "pack", NULL);
+    GDir* dir = g_dir_open(packs, 0, NULL);
+    const gchar* name = NULL;
+    int pack_files = 0;
+    while (dir && (name = g_dir_read_name(dir))) {
+        gchar* file = g_build_filename(packs, name, NULL);
+        gchar* linked_file = g_build_filename(git_repository_path(clone),
+                                              "objects", "pack", name, NULL);
+        if (g_str_has_suffix(name, ".pack") ||
+            g_str_has_suffix(name, ".idx")) {
+            TEST_ASSERT_EQUAL(2, link_count(file));
+            TEST_ASSERT_EQUAL(2, link_count(linked_file));
+            pack_files++;
+        }
+        g_free(linked_file);
+        g_free(file);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+    TEST_ASSERT_EQUAL(2, pack_files);
+    char hex[GIT_OID_HEXSZ + 1];
+    git_oid_tostr(hex, sizeof(hex), &loose_blob);
+    gchar prefix[3] = {hex[0], hex[1], '\0'};
+    gchar* object = g_build_filename(git_repository_path(clone), "objects",
+                                     prefix, hex + 2, NULL);
+    TEST_ASSERT_EQUAL(2, link_count(object));
+
+    // THEN: The fetch finds every branch without copying anything
+    git_oid fetched;
+    TEST_ASSERT_EQUAL(0, fetch_err);
+    TEST_ASSERT_EQUAL(0, git_reference_name_to_id(&fetched, clone,
+                                                  "refs/remotes/origin/loose"));
+    TEST_ASSERT_TRUE(git_oid_equal(&loose, &fetched));
+    TEST_ASSERT_EQUAL(0, git_reference_name_to_id(&fetched, clone,
+                                                  "refs/remotes/origin/other"));
+    TEST_ASSERT_TRUE(git_oid_equal(&leeched.other, &fetched));
+
+    // WHEN: Unshare the leeched repository, as before leeching into it
+    int copied = gittor_unshare_files(leeched.path);
+
+    // THEN: Each side has its own copy, and the clone still reads them
+    git_blob* blob = NULL;
+    TEST_ASSERT_EQUAL(linked, copied);
+    TEST_ASSERT_EQUAL(1, link_count(object));
+    TEST_ASSERT_EQUAL(0, gittor_unshare_files(leeched.path));
+    TEST_ASSERT_EQUAL(0, git_blob_lookup(&blob, clone, &leeched.other_blob));
+
+    git_blob_free(blob);
+    g_free(object);
+    g_free(packs);
+    git_remote_free(origin);
+    git_repository_free(clone);
+    git_repository_free(leeched_repo);
+    g_free(url);
+    g_free(path);
+    leeched_clear(&leeched);
+}
+
+static void shouldPass_whenFetchFailsWhileSeeding() {
+    // GIVEN: A seeded repository whose new .torrent the server doesn't have
+    const char* repo_id = "dddddddddddddddddddddddddddddddddddddddd";
+    char* cwd = g_get_current_dir();
+    char* dir = tempdir_init();
+    chdir(dir);
+    gchar* root = g_build_filename(dir, "www", NULL);
+    gchar* lookup = g_build_filename("api/torrents/repository", repo_id, NULL);
+    gchar* name = g_strconcat(repo_id, ".torrent", NULL);
+    gchar* torrent = g_build_filename(gittor_remote_dir(), name, NULL);
+    write_file(root, lookup,
+               "{\"id\": 4, \"updatedAt\": \"2000-01-01T00:00:00Z\"}");
+    write_file(gittor_remote_dir(), name, "d4:infod4:name4:stubee");
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+
+    // WHEN: Leech it, and a repository the server doesn't know
+    char output[PATH_MAX] = "";
+    int err = leech_repository(repo_id, REPO_ID, NULL, output, sizeof(output));
+    int unknown_err =
+        leech_repository("eeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeeee", REPO_ID,
+                         NULL, output, sizeof(output));
+
+    // THEN: Both fail before the seeder is told to stop, which would have
+    // removed its .torrent
+    TEST_ASSERT_NOT_EQUAL(0, err);
+    TEST_ASSERT_NOT_EQUAL(0, unknown_err);
+    TEST_ASSERT_TRUE(g_file_test(torrent, G_FILE_TEST_IS_REGULAR));
+    TEST_ASSERT_EQUAL_STRING("", output);
+
+    http_server_stop(server);
+    chdir(cwd);
+    g_remove(torrent);
+    remove_tree(dir);
+    g_free(torrent);
+    g_free(name);
+    g_free(lookup);
+    g_free(root);
+    g_free(dir);
+    g_free(cwd);
+}
+
 int main() {
     UNITY_BEGIN();
+
+    // Keep the config and remotes the tests write out of the real home
+    // directory
+    char* home = tempdir_init();
+    setenv("HOME", home, 1);
+    unsetenv("XDG_CONFIG_HOME");
+
     RUN_TEST(shouldPass_whenHelpFlag);
+    RUN_TEST(shouldFail_whenDepthNotPositive);
+    RUN_TEST(shouldPass_whenPlanFindsObjectsInPacks);
+    RUN_TEST(shouldPass_whenPlanFollowsDeltaChains);
+    RUN_TEST(shouldPass_whenFetchingLimitedHistory);
+    RUN_TEST(shouldPass_whenCloningOneBranch);
+    RUN_TEST(shouldPass_whenLinkingLeechedObjects);
+    RUN_TEST(shouldPass_whenFetchFailsWhileSeeding);
+
+    remove_tree(home);
+    g_free(home);
     return UNITY_END();
 }
@@ -0,0 +1,276 @@
+#include <glib.h>
+#include <unistd.h>
+#include <utime.h>
+#include <ctime>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <glib/gstdio.h>
+#include <libtorrent/add_torrent_params.hpp>
+#include <libtorrent/download_priority.hpp>
+#include <libtorrent/file_storage.hpp>
+#include <libtorrent/torrent_info.hpp>
+#include <libtorrent/write_resume_data.hpp>
+
+extern "C" {
+#include "service/service_internals.h"
+#include "unity/unity.h"
+#include "utils/utils.h"
+}
+
+#include "leech/leech_torrent.h"
+#include "utils/torrent.h"
+
+static lt::add_torrent_params torrent_params(
+    const std::shared_ptr<const lt::torrent_info>& ti,
+    const std::string& dir) {
+    lt::add_torrent_params atp;
+    atp.ti = ti;
+    atp.info_hashes = ti->info_hashes();
+    atp.save_path = dir;
+    return atp;
+}
+
+static void write_resume(const lt::add_torrent_params& atp,
+                         const std::string& path) {
+    const std::vector<char> b = lt::write_resume_data_buf(atp);
+    std::ofstream of(path, std::ios_base::binary);
+    of.write(b.data(), static_cast<std::streamsize>(b.size()));
+}
+
+static void shouldPass_whenFullLeechFollowsPartialOne() {
+    // GIVEN: A partial leech that only wanted and got the first piece
+    char* dir = tempdir_init();
+    write_sized(std::string(dir) + "/repo/HEAD", 23, 'h');
+    write_sized(std::string(dir) + "/repo/objects/pack/pack-1.pack", 100000,
+                'p');
+    const std::shared_ptr<const lt::torrent_info> ti =
+        make_torrent(dir, "repo");
+    const std::string resume = std::string(dir) + "/repo.resume";
+    const int pieces = ti->num_pieces();
+    lt::add_torrent_params partial = torrent_params(ti, dir);
+    partial.piece_priorities.assign(static_cast<std::size_t>(pieces),
+                                    lt::dont_download);
+    partial.piece_priorities[0] = lt::top_priority;
+    partial.have_pieces.resize(pieces, false);
+    partial.have_pieces.set_bit(lt::piece_index_t(0));
+    write_resume(partial, resume);
+
+    // WHEN: Leech it again, in full and partially
+    lt::add_torrent_params full = torrent_params(ti, dir);
+    lt::add_torrent_params again = torrent_params(ti, dir);
+    const std::shared_ptr<const lt::torrent_info> full_previous =
+        leech_load_resume(full, resume, false);
+    const std::shared_ptr<const lt::torrent_info> again_previous =
+        leech_load_resume(again, resume, true);
+
+    // THEN: The full leech wants every piece, keeping the one it has
+    TEST_ASSERT_NULL(full_previous.get());
+    TEST_ASSERT_TRUE(full.piece_priorities.empty());
+    TEST_ASSERT_EQUAL(pieces, full.have_pieces.size());
+    TEST_ASSERT_TRUE(full.have_pieces.get_bit(lt::piece_index_t(0)));
+
+    // THEN: The partial one carries on with what it skipped
+    TEST_ASSERT_NULL(again_previous.get());
+    TEST_ASSERT_EQUAL(pieces, again.piece_priorities.size());
+    TEST_ASSERT_TRUE(again.piece_priorities[1] == lt::dont_download);
+
+    remove_tree(dir);
+    g_free(dir);
+}
+
+static void shouldPass_whenReusingOlderVersionAndClone() {
+    // GIVEN: An older version in the remotes dir, a clone with a loose
+    // object, and a new version whose pack moved, with a pack nobody has
+    char* dir = tempdir_init();
+    const std::string remotes = std::string(dir) + "/remotes";
+    const std::string staged = std::string(dir) + "/staged";
+    const std::string clone = std::string(dir) + "/clone/.git";
+    write_sized(remotes + "/repo/HEAD", 23, 'h');
+    write_sized(remotes + "/repo/objects/pack/pack-old.pack", 50000, 'a');
+    const std::shared_ptr<const lt::torrent_info> previous =
+        make_torrent(remotes, "repo");
+    write_sized(staged + "/repo/HEAD", 23, 'h');
+    write_sized(staged + "/repo/objects/pack/pack-new.pack", 50000, 'a');
+    write_sized(staged + "/repo/objects/pack/pack-fresh.pack", 30000, 'f');
+    write_sized(staged + "/repo/objects/ab/cdef", 700, 'o');
+    write_sized(clone + "/objects/ab/cdef", 700, 'o');
+    const std::shared_ptr<const lt::torrent_info> ti =
+        make_torrent(staged, "repo");
+
+    // WHEN: Reuse local files for the new version, and for a resumed leech
+    lt::add_torrent_params resumed = torrent_params(ti, remotes);
+    resumed.have_pieces.resize(ti->num_pieces(), false);
+    const std::int64_t resumed_reused =
+        leech_reuse_local_files(resumed, previous, clone.c_str());
+    const std::int64_t reused = leech_reuse_local_files(
+        torrent_params(ti, remotes), previous, clone.c_str());
+
+    // THEN: The moved pack and the loose object are copied, the rest is left
+    // for the download
+    gchar* contents = nullptr;
+    gsize len = 0;
+    TEST_ASSERT_EQUAL(0, resumed_reused);
+    TEST_ASSERT_EQUAL(50000 + 700, reused);
+    TEST_ASSERT_TRUE(g_file_get_contents(
+        (remotes + "/repo/objects/pack/pack-new.pack").c_str(), &contents,
+        &len, nullptr));
+    TEST_ASSERT_EQUAL(50000, len);
+    TEST_ASSERT_EQUAL('a', contents[len - 1]);
+    TEST_ASSERT_TRUE(g_file_test((remotes + "/repo/objects/ab/cdef").c_str(),
+                                 G_FILE_TEST_IS_REGULAR));
+    TEST_ASSERT_FALSE(
+        g_file_test((remotes + "/repo/objects/pack/pack-fresh.pack").c_str(),
+                    G_FILE_TEST_EXISTS));
+
+    g_free(contents);
+    remove_tree(dir);
+    g_free(dir);
+}
+
+// Link a file of the repository into a clone, as cloning it does
+static void link_into(const std::string& repo,
+                      const std::string& clone,
+                      const std::string& path) {
+    gchar* parent = g_path_get_dirname((clone + "/" + path).c_str());
+    g_mkdir_with_parents(parent, 0755);
+    g_free(parent);
+    TEST_ASSERT_EQUAL(0, link((repo + "/" + path).c_str(),
+                              (clone + "/" + path).c_str()));
+}
+
+static void shouldPass_whenUnsharingOnlyFilesStillWritten() {
+    // GIVEN: A repository whose objects are all linked into a clone
+    char* dir = tempdir_init();
+    const std::string remotes = std::string(dir) + "/remotes";
+    const std::string repo = remotes + "/repo";
+    const std::string clone = std::string(dir) + "/clone";
+    const char* objects[] = {"objects/pack/pack-a.pack",
+                             "objects/pack/pack-b.pack", "objects/ab/cdef"};
+    write_sized(repo + "/HEAD", 23, 'h');
+    write_sized(repo + "/" + objects[0], 40000, 'a');
+    write_sized(repo + "/" + objects[1], 30000, 'b');
+    write_sized(repo + "/" + objects[2], 700, 'o');
+    const std::shared_ptr<const lt::torrent_info> ti =
+        make_torrent(remotes, "repo");
+    for (const char* object : objects) {
+        link_into(repo, clone, object);
+    }
+
+    // WHEN: Leech it again with every piece in the resume data, then with
+    // the pieces of one pack missing
+    const lt::file_storage& fs = ti->files();
+    lt::add_torrent_params complete = torrent_params(ti, remotes);
+    complete.have_pieces.resize(ti->num_pieces(), true);
+    const int complete_copied = leech_unshare_written_files(complete, repo);
+    lt::add_torrent_params missing = torrent_params(ti, remotes);
+    missing.have_pieces.resize(ti->num_pieces(), true);
+    for (const lt::file_index_t i : fs.file_range()) {
+        if (g_str_has_suffix(fs.file_path(i).c_str(), "pack-b.pack")) {
+            missing.have_pieces.clear_bit(fs.map_file(i, 0, 1).piece);
+        }
+    }
+    const int missing_copied = leech_unshare_written_files(missing, repo);
+
+    // THEN: Only the pack with pieces missing gets its own copy
+    TEST_ASSERT_EQUAL(0, complete_copied);
+    TEST_ASSERT_EQUAL(1, missing_copied);
+    TEST_ASSERT_EQUAL(2, link_count((repo + "/" + objects[0]).c_str()));
+    TEST_ASSERT_EQUAL(1, link_count((repo + "/" + objects[1]).c_str()));
+    TEST_ASSERT_EQUAL(1, link_count((clone + "/" + objects[1]).c_str()));
+    TEST_ASSERT_EQUAL(2, link_count((repo + "/" + objects[2]).c_str()));
+
+    // WHEN: The loose object is linked to different bytes, and the torrent
+    // is leeched without resume data
+    TEST_ASSERT_EQUAL(0, g_remove((clone + "/" + objects[2]).c_str()));
+    TEST_ASSERT_EQUAL(0, g_remove((repo + "/" + objects[2]).c_str()));
+    write_sized(clone + "/" + objects[2], 700, 'x');
+    link_into(clone, repo, objects[2]);
+    const int fresh_copied =
+        leech_unshare_written_files(torrent_params(ti, remotes), repo);
+
+    // THEN: Only the file that doesn't hash gets its own copy, leaving the
+    // clone's as is
+    gchar* contents = nullptr;
+    gsize len = 0;
+    TEST_ASSERT_EQUAL(1, fresh_copied);
+    TEST_ASSERT_EQUAL(2, link_count((repo + "/" + objects[0]).c_str()));
+    TEST_ASSERT_EQUAL(1, link_count((repo + "/" + objects[2]).c_str()));
+    TEST_ASSERT_TRUE(g_file_get_contents((clone + "/" + objects[2]).c_str(),
+                                         &contents, &len, nullptr));
+    TEST_ASSERT_EQUAL(700, len);
+    TEST_ASSERT_EQUAL('x', contents[0]);
+
+    g_free(contents);
+    remove_tree(dir);
+    g_free(dir);
+}
+
+// Write an object file of a seeded repository, old enough to be deduped
+static void write_object(const std::string& path, std::size_t size, char fill) {
+    write_sized(path, size, fill);
+    struct utimbuf times = {.actime = time(nullptr) - 3600,
+                            .modtime = time(nullptr) - 3600};
+    g_utime(path.c_str(), &times);
+}
+
+static void shouldPass_whenReleechingDedupedFork() {
+    // GIVEN: Two seeded forks sharing a pack and a loose object through the
+    // pool, and a new version of one with the same pack, a new pack and
+    // other bytes for the loose object
+    const std::string fork_a = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    const std::string fork_b = "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb";
+    const std::string pack = "/objects/pack/pack-1.pack";
+    const std::string loose = "/objects/ab/cdef";
+    char* dir = tempdir_init();
+    const std::string repos = std::string(dir) + "/repos";
+    const std::string staged = std::string(dir) + "/staged";
+    for (const std::string& fork : {fork_a, fork_b}) {
+        write_sized(repos + "/" + fork + ".torrent", 10, 't');
+        write_sized(repos + "/" + fork + "/HEAD", 23, 'h');
+        write_object(repos + "/" + fork + pack, 40000, 'p');
+        write_object(repos + "/" + fork + loose, 700, 'o');
+    }
+    dedupe_report_t report;
+    TEST_ASSERT_EQUAL(0, gittor_service_dedupe_dir(repos.c_str(), &report));
+    TEST_ASSERT_EQUAL(2, report.linked);
+    write_sized(staged + "/" + fork_b + "/HEAD", 23, 'h');
+    write_sized(staged + "/" + fork_b + pack, 40000, 'p');
+    write_sized(staged + "/" + fork_b + "/objects/pack/pack-2.pack", 20000,
+                'n');
+    write_sized(staged + "/" + fork_b + loose, 700, 'q');
+    const std::shared_ptr<const lt::torrent_info> ti =
+        make_torrent(staged, fork_b);
+
+    // WHEN: Leech the new version into the fork
+    const int copied = leech_unshare_written_files(torrent_params(ti, repos),
+                                                   repos + "/" + fork_b);
+
+    // THEN: The unchanged pack stays shared, the loose object libtorrent
+    // will write gets a copy of its own
+    gchar* contents = nullptr;
+    gsize len = 0;
+    TEST_ASSERT_EQUAL(1, copied);
+    TEST_ASSERT_EQUAL(3, link_count((repos + "/" + fork_b + pack).c_str()));
+    TEST_ASSERT_EQUAL(1, link_count((repos + "/" + fork_b + loose).c_str()));
+    TEST_ASSERT_EQUAL(2, link_count((repos + "/" + fork_a + loose).c_str()));
+    TEST_ASSERT_TRUE(g_file_get_contents((repos + "/" + fork_a + loose).c_str(),
+                                         &contents, &len, nullptr));
+    TEST_ASSERT_EQUAL('o', contents[0]);
+
+    g_free(contents);
+    remove_tree(dir);
+    g_free(dir);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(shouldPass_whenFullLeechFollowsPartialOne);
+    RUN_TEST(shouldPass_whenReusingOlderVersionAndClone);
+    RUN_TEST(shouldPass_whenUnsharingOnlyFilesStillWritten);
+    RUN_TEST(shouldPass_whenReleechingDedupedFork);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <glib.h>
+#include <unistd.h>
+#include "cmd/cmd.h"
+#include "config/config.h"
+#include "unity/unity.h"
+#include "utils/utils.h"
+
+#define BUFFER_SIZE 1024
+
+static void shouldPass_whenHelpFlag() {
+    // GIVEN: Help flag
+    char* argv[] = {"gittor", "list", "--help", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    // WHEN: Parse arguments
+    int err = cmd_parse(argc, argv);
+
+    // THEN: Should return 0 error
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+static void shouldEinval_whenPageSizeInvalid() {
+    // GIVEN: A page size that isn't a positive number
+    char* argv[] = {"gittor", "list", "--page-size", "none", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+
+    // WHEN: Parse arguments
+    int err = cmd_parse(argc, argv);
+
+    // THEN: Should return invalid argument error
+    TEST_ASSERT_EQUAL(EINVAL, err);
+}
+
+static void shouldPass_whenSearchSpansPages() {
+    // GIVEN: A local server with search results over two pages
+    char* cwd = g_get_current_dir();
+    char* dir = tempdir_init();
+    chdir(dir);
+    gchar* root = g_build_filename(dir, "www", NULL);
+    write_file(root, "api/torrents/search?q=git tor&page=0&size=2",
+               "{\"content\": ["
+               "{\"repoId\": \"1111\", \"name\": \"one\", \"description\": "
+               "\"first \\\"quoted\\\" {brace}\"},"
+               "{\"repoId\": \"2222\", \"name\": \"two\", \"webSeeds\": []}"
+               "], \"last\": false, \"number\": 0}");
+    write_file(root, "api/torrents/search?q=git tor&page=1&size=2",
+               "{\"content\": [{\"repoId\": \"3333\", \"name\": \"three\"}],"
+               " \"last\": true, \"number\": 1}");
+
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+
+    // WHEN: Search two torrents at a time
+    int old_stdout;
+    FILE* temp = redirect_stdout_to_temp(&old_stdout);
+    char* argv[] = {"gittor", "list", "-n", "2", "git tor", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int err = cmd_parse(argc, argv);
+    restore_stdout(old_stdout);
+    char output[BUFFER_SIZE];
+    read_temp_file(temp, output, BUFFER_SIZE);
+
+    // THEN: Every result should be printed in order from two requests
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL_STRING("1111\tone\tfirst \"quoted\" {brace}\n"
+                             "2222\ttwo\t\n"
+                             "3333\tthree\t",
+                             output);
+    TEST_ASSERT_EQUAL(2, http_server_requests(server));
+
+    http_server_stop(server);
+    chdir(cwd);
+    remove_tree(dir);
+    g_free(root);
+    g_free(dir);
+    g_free(cwd);
+}
+
+static void shouldPass_whenServerCapsPageSize() {
+    // GIVEN: A local server sending fewer torrents than asked for per page
+    char* cwd = g_get_current_dir();
+    char* dir = tempdir_init();
+    chdir(dir);
+    gchar* root = g_build_filename(dir, "www", NULL);
+    write_file(root, "api/torrents?page=0&size=3",
+               "{\"content\": [{\"repoId\": \"1111\", \"name\": \"one\"},"
+               "{\"repoId\": \"2222\", \"name\": \"two\"}],"
+               " \"last\": false, \"number\": 0}");
+    write_file(root, "api/torrents?page=1&size=3",
+               "{\"content\": [{\"repoId\": \"3333\", \"name\": \"three\"}],"
+               " \"last\": true, \"number\": 1}");
+
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+
+    // WHEN: List three torrents at a time
+    int old_stdout;
+    FILE* temp = redirect_stdout_to_temp(&old_stdout);
+    char* argv[] = {"gittor", "list", "-n", "3", NULL};
+    int argc = sizeof(argv) / sizeof(*argv) - 1;
+    int err = cmd_parse(argc, argv);
+    restore_stdout(old_stdout);
+    char output[BUFFER_SIZE];
+    read_temp_file(temp, output, BUFFER_SIZE);
+
+    // THEN: Should go on past the short page the server says isn't the last
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL_STRING("1111\tone\t\n"
+                             "2222\ttwo\t\n"
+                             "3333\tthree\t",
+                             output);
+    TEST_ASSERT_EQUAL(2, http_server_requests(server));
+
+    http_server_stop(server);
+    chdir(cwd);
+    remove_tree(dir);
+    g_free(root);
+    g_free(dir);
+    g_free(cwd);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(shouldPass_whenHelpFlag);
+    RUN_TEST(shouldEinval_whenPageSizeInvalid);
+    RUN_TEST(shouldPass_whenSearchSpansPages);
+    RUN_TEST(shouldPass_whenServerCapsPageSize);
+    return UNITY_END();
+}
@@ -1,6 +1,10 @@
 #include <errno.h>
 #include <git2.h>
 #include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
 #include "cmd/cmd.h"
 #include "unity/unity.h"
 #include "utils/utils.h"
@@ -17,6 +21,307 @@ static void shouldPass_whenHelpFlag() {
     TEST_ASSERT_EQUAL(0, err);
 }
 
+// Commit a chain of commits on HEAD, each changing a file
+static int commit_files(git_repository* repo, int count) {
+    git_oid parent;
+    bool has_parent = !git_reference_name_to_id(&parent, repo, "HEAD");
+    int err = 0;
+    for (int i = 0; i < count && !err; i++) {
+        gchar* contents = g_strdup_printf("%d %" G_GINT64_FORMAT "\n", i,
+                                          g_get_monotonic_time());
+        err = commit_file(repo, "HEAD", contents,
+                          has_parent ? &parent : NULL, 1000000000 + i, &parent,
+                          NULL);
+        has_parent = true;
+        g_free(contents);
+    }
+    return err;
+}
+
+// Whether a branch of one repository points at the same commit as in another
+static bool same_tip(git_repository* repo, const char* ref, const char* path) {
+    git_repository* other = NULL;
+    git_oid expected;
+    git_oid actual;
+    bool same = !git_reference_name_to_id(&expected, repo, ref) &&
+                !git_repository_open(&other, path) &&
+                !git_reference_name_to_id(&actual, other, ref) &&
+                git_oid_equal(&expected, &actual);
+    git_repository_free(other);
+    return same;
+}
+
+// Pack the objects reachable from the branches matching a glob, or HEAD
+// without one, and drop every loose object. Gives the pack's file name.
+static int pack_reachable(git_repository* repo,
+                          const char* glob,
+                          gchar** name_out) {
+    git_packbuilder* pb = NULL;
+    git_revwalk* walk = NULL;
+    gchar* objects = g_build_filename(git_repository_path(repo), "objects",
+                                      NULL);
+    gchar* packs = g_build_filename(objects, "pack", NULL);
+    int err = git_packbuilder_new(&pb, repo);
+    if (!err) {
+        err = git_revwalk_new(&walk, repo);
+    }
+    if (!err) {
+        err = glob ? git_revwalk_push_glob(walk, glob)
+                   : git_revwalk_push_head(walk);
+    }
+    if (!err) {
+        err = git_packbuilder_insert_walk(pb, walk);
+    }
+    if (!err) {
+        err = git_packbuilder_write(pb, packs, 0, NULL, NULL);
+    }
+    if (!err) {
+        *name_out = g_strdup_printf("pack-%s.pack", git_packbuilder_name(pb));
+    }
+
+    GDir* dir = err ? NULL : g_dir_open(objects, 0, NULL);
+    const gchar* name = NULL;
+    while (dir && (name = g_dir_read_name(dir))) {
+        if (strlen(name) == 2) {
+            gchar* loose = g_build_filename(objects, name, NULL);
+            remove_tree(loose);
+            g_free(loose);
+        }
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+
+    git_revwalk_free(walk);
+    git_packbuilder_free(pb);
+    g_free(packs);
+    g_free(objects);
+    return err;
+}
+
+// Commit a file on a branch of its own off HEAD
+static int commit_private(git_repository* repo, git_oid* out, git_oid* blob) {
+    git_oid head;
+    int err = git_reference_name_to_id(&head, repo, "HEAD");
+    if (!err) {
+        err = commit_file(repo, "refs/heads/private", "not for the remote",
+                          &head, 1000000000, out, blob);
+    }
+    return err;
+}
+
+// Whether a repository has an object
+static bool has_object(const char* path, const git_oid* id) {
+    git_repository* repo = NULL;
+    git_odb* odb = NULL;
+    bool has = !git_repository_open(&repo, path) &&
+               !git_repository_odb(&odb, repo) && git_odb_exists(odb, id);
+    git_odb_free(odb);
+    git_repository_free(repo);
+    return has;
+}
+
+static void shouldPass_whenPushingLocally() {
+    // GIVEN: A repository with a long history and a bare remote next to it
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+    gchar* local_path = g_build_filename(dir, "local", NULL);
+    gchar* remote_path = g_build_filename(dir, "remote.git", NULL);
+    gchar* url = g_strconcat("file://", remote_path, NULL);
+    git_repository* repo = NULL;
+    git_repository* remote_repo = NULL;
+    git_remote* remote = NULL;
+    int err = git_repository_init(&remote_repo, remote_path, true);
+    if (!err) {
+        err = git_repository_init(&repo, local_path, false);
+    }
+    if (!err) {
+        err = git_remote_create(&remote, repo, "origin", url);
+    }
+    if (!err) {
+        err = commit_files(repo, 5000);
+    }
+    TEST_ASSERT_EQUAL(0, err);
+    git_reference* head = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_head(&head, repo));
+    const char* branch = git_reference_name(head);
+    gchar* tracking = g_strconcat("refs/remotes/origin/",
+                                  git_reference_shorthand(head), NULL);
+
+    // WHEN: Push it, push more commits, then push a rewritten history
+    gint64 start = g_get_monotonic_time();
+    int first_err = gittor_git_push(repo);
+    gint64 push_time = g_get_monotonic_time() - start;
+    bool first_same = same_tip(repo, branch, remote_path);
+
+    int more_err = commit_files(repo, 10);
+    if (!more_err) {
+        more_err = gittor_git_push(repo);
+    }
+    bool more_same = same_tip(repo, branch, remote_path);
+
+    // Rewrite the history into a single commit with the same files
+    git_oid pushed;
+    git_oid tracked;
+    git_oid orphan;
+    git_commit* old = NULL;
+    git_tree* tree = NULL;
+    git_reference* rewritten = NULL;
+    int rewrite_err = git_reference_name_to_id(&pushed, repo, branch);
+    int tracked_err = git_reference_name_to_id(&tracked, repo, tracking);
+    if (!rewrite_err) {
+        rewrite_err = git_commit_lookup(&old, repo, &pushed);
+    }
+    if (!rewrite_err) {
+        rewrite_err = git_commit_tree(&tree, old);
+    }
+    if (!rewrite_err) {
+        rewrite_err = git_commit_create(
+            &orphan, repo, NULL, git_commit_author(old),
+            git_commit_committer(old), "UTF-8", "rewritten", tree, 0, NULL);
+    }
+    if (!rewrite_err) {
+        rewrite_err = git_reference_create(&rewritten, repo, branch, &orphan,
+                                           1, "rewrite");
+    }
+    git_tree_free(tree);
+    git_commit_free(old);
+    int rewritten_err = gittor_git_push(repo);
+    git_oid remote_tip = {{0}};
+    git_repository* check = NULL;
+    git_repository_open(&check, remote_path);
+    git_reference_name_to_id(&remote_tip, check, branch);
+    git_repository_free(check);
+
+    gchar* timing = g_strdup_printf(
+        "Push of 5000 commits to a local remote: %" G_GINT64_FORMAT " us",
+        push_time);
+    TEST_MESSAGE(timing);
+    g_free(timing);
+
+    // THEN: Should fast-forward the remote, but never rewrite it
+    TEST_ASSERT_EQUAL(0, first_err);
+    TEST_ASSERT_TRUE(first_same);
+    TEST_ASSERT_EQUAL(0, more_err);
+    TEST_ASSERT_TRUE(more_same);
+    TEST_ASSERT_EQUAL(0, tracked_err);
+    TEST_ASSERT_TRUE(git_oid_equal(&pushed, &tracked));
+    TEST_ASSERT_EQUAL(0, rewrite_err);
+    TEST_ASSERT_NOT_EQUAL(0, rewritten_err);
+    TEST_ASSERT_TRUE(git_oid_equal(&pushed, &remote_tip));
+
+    git_reference_free(rewritten);
+    git_reference_free(head);
+    git_remote_free(remote);
+    git_repository_free(remote_repo);
+    git_repository_free(repo);
+    remove_tree(dir);
+    g_free(tracking);
+    g_free(url);
+    g_free(remote_path);
+    g_free(local_path);
+    g_free(dir);
+}
+
+static void shouldPass_whenPushingOnlyReachableObjects() {
+    // GIVEN: A repository whose history is packed on its own, with a
+    // private branch and a dangling blob, and a bare remote next to it
+    gchar* dir = tempdir_init();
+    if (dir == NULL) {
+        TEST_FAIL_MESSAGE("Failed to create temporary directory");
+    }
+    TEST_ASSERT_EQUAL(0, gittor_libgit2_init());
+    gchar* local_path = g_build_filename(dir, "local", NULL);
+    gchar* remote_path = g_build_filename(dir, "remote.git", NULL);
+    gchar* remote_packs = g_build_filename(remote_path, "objects", "pack",
+                                           NULL);
+    gchar* url = g_strconcat("file://", remote_path, NULL);
+    git_repository* repo = NULL;
+    git_repository* remote_repo = NULL;
+    git_remote* remote = NULL;
+    gchar* history_pack = NULL;
+    gchar* mixed_pack = NULL;
+    git_oid private_commit;
+    git_oid secret;
+    git_oid dangling;
+    int err = git_repository_init(&remote_repo, remote_path, true);
+    if (!err) {
+        err = git_repository_init(&repo, local_path, false);
+    }
+    if (!err) {
+        err = git_remote_create(&remote, repo, "origin", url);
+    }
+    if (!err) {
+        err = commit_files(repo, 3);
+    }
+    if (!err) {
+        err = pack_reachable(repo, NULL, &history_pack);
+    }
+    if (!err) {
+        err = commit_private(repo, &private_commit, &secret);
+    }
+    if (!err) {
+        err = git_blob_create_from_buffer(&dangling, repo, "dangling", 8);
+    }
+    TEST_ASSERT_EQUAL(0, err);
+    git_reference* head = NULL;
+    TEST_ASSERT_EQUAL(0, git_repository_head(&head, repo));
+    const char* branch = git_reference_name(head);
+    gchar* history_path = g_build_filename(remote_packs, history_pack, NULL);
+
+    // WHEN: Push it
+    int first_err = gittor_git_push(repo);
+    bool first_same = same_tip(repo, branch, remote_path);
+
+    // THEN: The pack of the history is linked, nothing else leaves
+    TEST_ASSERT_EQUAL(0, first_err);
+    TEST_ASSERT_TRUE(first_same);
+    TEST_ASSERT_EQUAL(2, link_count(history_path));
+    TEST_ASSERT_FALSE(has_object(remote_path, &private_commit));
+    TEST_ASSERT_FALSE(has_object(remote_path, &secret));
+    TEST_ASSERT_FALSE(has_object(remote_path, &dangling));
+
+    // WHEN: Push more commits after packing them with the private branch
+    int more_err = commit_files(repo, 2);
+    if (!more_err) {
+        more_err = pack_reachable(repo, "refs/heads/*", &mixed_pack);
+    }
+    gchar* mixed_path = mixed_pack
+                            ? g_build_filename(remote_packs, mixed_pack, NULL)
+                            : NULL;
+    if (!more_err) {
+        more_err = gittor_git_push(repo);
+    }
+    bool more_same = same_tip(repo, branch, remote_path);
+
+    // THEN: The mixed pack is left behind, a pack of the new commits is
+    // written instead
+    TEST_ASSERT_EQUAL(0, more_err);
+    TEST_ASSERT_TRUE(more_same);
+    TEST_ASSERT_NOT_NULL(mixed_path);
+    TEST_ASSERT_FALSE(g_file_test(mixed_path, G_FILE_TEST_EXISTS));
+    TEST_ASSERT_FALSE(has_object(remote_path, &private_commit));
+    TEST_ASSERT_FALSE(has_object(remote_path, &secret));
+
+    git_reference_free(head);
+    git_remote_free(remote);
+    git_repository_free(remote_repo);
+    git_repository_free(repo);
+    remove_tree(dir);
+    g_free(mixed_path);
+    g_free(mixed_pack);
+    g_free(history_path);
+    g_free(history_pack);
+    g_free(url);
+    g_free(remote_packs);
+    g_free(remote_path);
+    g_free(local_path);
+    g_free(dir);
+}
+
 // TODO(isaac): For some reason testing the seeder service is not working,
 //              but at this point we just need to get this feature in and
 //              clean it from there as bugs occur.
@@ -61,5 +366,7 @@ static void shouldPass_whenHelpFlag() {
 int main() {
     UNITY_BEGIN();
     RUN_TEST(shouldPass_whenHelpFlag);
+    RUN_TEST(shouldPass_whenPushingLocally);
+    RUN_TEST(shouldPass_whenPushingOnlyReachableObjects);
     return UNITY_END();
 }
@@ -1,7 +1,13 @@
 #include <errno.h>
 #include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <utime.h>
+#include <glib/gstdio.h>
 #include "cmd/cmd.h"
+#include "config/config.h"
 #include "service/service.h"
 #include "service/service_internals.h"
 #include "unity/unity.h"
@@ -96,9 +102,248 @@ static void waitForServiceStarted() {
     }
 }
 
+static void shouldPass_whenReconcilingSeededRepositories() {
+    // GIVEN: Three seeded repositories, one current but uploaded after it
+    // was seeded, one with a newer version on a server whose clock is behind
+    // and one deleted from the server
+    const char* current = "1111111111111111111111111111111111111111";
+    const char* updated = "2222222222222222222222222222222222222222";
+    const char* deleted = "3333333333333333333333333333333333333333";
+    char* cwd = g_get_current_dir();
+    char* dir = tempdir_init();
+    chdir(dir);
+    gchar* repos = g_build_filename(dir, "repos", NULL);
+    gchar* root = g_build_filename(dir, "www", NULL);
+    const char* seeded[] = {current, updated, deleted};
+    for (size_t i = 0; i < sizeof(seeded) / sizeof(*seeded); i++) {
+        gchar* name = g_strdup_printf("%s.torrent", seeded[i]);
+        write_file(repos, name, "d4:infod4:name4:stubee");
+        g_free(name);
+    }
+    write_file(repos, "not-a-repo.torrent", "");
+    gchar* path = g_build_filename("api/torrents/repository", current, NULL);
+    write_file(root, path,
+               "{\"id\": 1, \"updatedAt\": \"2999-01-01T00:00:00Z\"}");
+    g_free(path);
+    path = g_build_filename("api/torrents/repository", updated, NULL);
+    write_file(root, path,
+               "{\"id\": 2, \"updatedAt\": \"2000-01-01T00:00:00Z\"}");
+    g_free(path);
+    write_file(root, "api/torrents/1/file", "d4:infod4:name4:stubee");
+    write_file(root, "api/torrents/2/file", "d4:infod4:name5:stub2ee");
+
+    http_server_t* server = api_server_start(root);
+    TEST_ASSERT_NOT_NULL(server);
+
+    // WHEN: Reconcile them with the server
+    reconcile_report_t report;
+    int err = gittor_service_reconcile(repos, &report);
+
+    // THEN: Only the updated and the deleted ones should be stale, going by
+    // the .torrent files rather than the upload times
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(3, report.checked);
+    TEST_ASSERT_EQUAL(2, report.stale);
+    TEST_ASSERT_EQUAL(1, report.deleted);
+    TEST_ASSERT_EQUAL(0, report.failed);
+    TEST_ASSERT_EQUAL(5, http_server_requests(server));
+    gchar* theirs = g_strdup_printf("%s/%s.torrent.reconcile", repos, updated);
+    TEST_ASSERT_FALSE(g_file_test(theirs, G_FILE_TEST_EXISTS));
+
+    http_server_stop(server);
+    chdir(cwd);
+    remove_tree(dir);
+    g_free(theirs);
+    g_free(root);
+    g_free(repos);
+    g_free(dir);
+    g_free(cwd);
+}
+
+// Write an object file last modified an hour ago
+static void write_object(const char* dir, const char* path, char fill) {
+    gchar* file = g_build_filename(dir, path, NULL);
+    gchar* parent = g_path_get_dirname(file);
+    gchar* contents = g_malloc(100000);
+    memset(contents, fill, 100000);
+    g_mkdir_with_parents(parent, 0755);
+    g_file_set_contents(file, contents, 100000, NULL);
+    struct utimbuf times = {.actime = time(NULL) - 3600,
+                            .modtime = time(NULL) - 3600};
+    g_utime(file, &times);
+    g_free(contents);
+    g_free(parent);
+    g_free(file);
+}
+
+static void shouldPass_whenDedupingSeededRepositories() {
+    // GIVEN: Two seeded forks sharing a pack and a loose object, one with a
+    // pack of its own, and a repository still being leeched with the pack
+    const char* fork_a = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+    const char* fork_b = "bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb";
+    const char* leeching = "cccccccccccccccccccccccccccccccccccccccc";
+    char* dir = tempdir_init();
+    gchar* repos = g_build_filename(dir, "repos", NULL);
+    const char* forks[] = {fork_a, fork_b};
+    for (size_t i = 0; i < sizeof(forks) / sizeof(*forks); i++) {
+        gchar* name = g_strdup_printf("%s.torrent", forks[i]);
+        write_file(repos, name, "d4:infod4:name4:stubee");
+        g_free(name);
+    }
+    gchar* pack_a = g_build_filename(fork_a, "objects/pack/pack-1.pack", NULL);
+    gchar* pack_b = g_build_filename(fork_b, "objects/pack/pack-1.pack", NULL);
+    gchar* pack_c =
+        g_build_filename(leeching, "objects/pack/pack-1.pack", NULL);
+    gchar* loose_a = g_build_filename(fork_a, "objects/ab/cdef", NULL);
+    gchar* loose_b = g_build_filename(fork_b, "objects/ab/cdef", NULL);
+    write_object(repos, pack_a, 'p');
+    write_object(repos, pack_b, 'p');
+    write_object(repos, pack_c, 'p');
+    write_object(repos, loose_a, 'o');
+    write_object(repos, loose_b, 'o');
+    gchar* other = g_build_filename(fork_a, "objects/pack/pack-2.pack", NULL);
+    write_object(repos, other, 'x');
+
+    // WHEN: Dedupe them, twice
+    dedupe_report_t report;
+    dedupe_report_t again;
+    int err = gittor_service_dedupe_dir(repos, &report);
+    int again_err = gittor_service_dedupe_dir(repos, &again);
+
+    gchar* usage = g_strdup_printf(
+        "Disk usage: %" G_GUINT64_FORMAT " bytes before, %" G_GUINT64_FORMAT
+        " bytes after",
+        report.before, report.after);
+    TEST_MESSAGE(usage);
+    g_free(usage);
+
+    // THEN: Should share the forks' files, leaving their contents as is
+    gchar* path_a = g_build_filename(repos, pack_a, NULL);
+    gchar* path_b = g_build_filename(repos, pack_b, NULL);
+    gchar* path_c = g_build_filename(repos, pack_c, NULL);
+    GStatBuf st_a;
+    GStatBuf st_b;
+    GStatBuf st_c;
+    gchar* contents = NULL;
+    gsize len = 0;
+    TEST_ASSERT_EQUAL(0, g_stat(path_a, &st_a));
+    TEST_ASSERT_EQUAL(0, g_stat(path_b, &st_b));
+    TEST_ASSERT_EQUAL(0, g_stat(path_c, &st_c));
+    TEST_ASSERT_TRUE(g_file_get_contents(path_b, &contents, &len, NULL));
+    TEST_ASSERT_EQUAL(0, err);
+    TEST_ASSERT_EQUAL(5, report.files);
+    TEST_ASSERT_EQUAL(2, report.linked);
+    TEST_ASSERT_LESS_THAN(report.before, report.after);
+    TEST_ASSERT_TRUE(st_a.st_ino == st_b.st_ino);
+    TEST_ASSERT_TRUE(st_a.st_ino != st_c.st_ino);
+    TEST_ASSERT_EQUAL(100000, len);
+    TEST_ASSERT_EQUAL('p', contents[len - 1]);
+    TEST_ASSERT_EQUAL(0, again_err);
+    TEST_ASSERT_EQUAL(0, again.linked);
+    TEST_ASSERT_TRUE(again.after == report.after);
+
+    // WHEN: Unshare the files of one fork, then write into them in place as
+    // libtorrent does
+    gchar* fork_dir = g_build_filename(repos, fork_b, NULL);
+    int unshared = gittor_unshare_files(fork_dir);
+    FILE* fp = g_fopen(path_b, "r+b");
+    TEST_ASSERT_NOT_NULL(fp);
+    fputc('z', fp);
+    fclose(fp);
+
+    // THEN: The other fork and the pool keep their copy as is
+    gchar* other_contents = NULL;
+    TEST_ASSERT_EQUAL(2, unshared);
+    TEST_ASSERT_TRUE(g_file_get_contents(path_a, &other_contents, &len, NULL));
+    TEST_ASSERT_EQUAL('p', other_contents[0]);
+    TEST_ASSERT_EQUAL(0, g_stat(path_b, &st_b));
+    TEST_ASSERT_TRUE(st_a.st_ino != st_b.st_ino);
+
+    remove_tree(dir);
+    g_free(other_contents);
+    g_free(fork_dir);
+    g_free(contents);
+    g_free(path_c);
+    g_free(path_b);
+    g_free(path_a);
+    g_free(other);
+    g_free(loose_b);
+    g_free(loose_a);
+    g_free(pack_c);
+    g_free(pack_b);
+    g_free(pack_a);
+    g_free(repos);
+    g_free(dir);
+}
+
+// Find a port nothing listens on
+static int free_port() {
+    GSocket* sock = g_socket_new(G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+                                 G_SOCKET_PROTOCOL_TCP, NULL);
+    GInetAddress* loopback = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+    GSocketAddress* any = g_inet_socket_address_new(loopback, 0);
+    int port = -1;
+    if (sock && g_socket_bind(sock, any, FALSE, NULL)) {
+        GSocketAddress* bound = g_socket_get_local_address(sock, NULL);
+        port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(bound));
+        g_object_unref(bound);
+    }
+    g_object_unref(any);
+    g_object_unref(loopback);
+    if (sock) {
+        g_socket_close(sock, NULL);
+        g_object_unref(sock);
+    }
+    return port;
+}
+
+static gboolean can_connect(int port) {
+    GSocketClient* client = g_socket_client_new();
+    GSocketConnection* connection = g_socket_client_connect_to_host(
+        client, "127.0.0.1", (guint16)port, NULL, NULL);
+    if (connection) {
+        g_object_unref(connection);
+    }
+    g_object_unref(client);
+    return connection != NULL;
+}
+
+static void shouldPass_whenChangingPortWhileSeeding() {
+    // GIVEN: A running service, and a port nothing listens on
+    GThread* t = g_thread_new("service-handler", handle_service, NULL);
+    waitForServiceStarted();
+    int port = free_port();
+    TEST_ASSERT_GREATER_THAN(0, port);
+    TEST_ASSERT_FALSE(can_connect(port));
+
+    // WHEN: The torrent port is changed in the global config
+    gchar* value = g_strdup_printf("%d", port);
+    config_set(CONFIG_SCOPE_GLOBAL,
+               &(config_id_t){.group = "network", .key = "port"}, value);
+
+    // THEN: Peers should be able to connect on it, without a restart
+    gboolean listening = FALSE;
+    for (int i = 0; i < 100 && !listening; i++) {
+        g_usleep(100UL * 1000UL);  // 100 ms
+        listening = can_connect(port);
+    }
+    shouldPass_whenServiceStop();
+    g_thread_join(t);
+    TEST_ASSERT_TRUE(listening);
+
+    gchar* global_path = global_config_path();
+    unlink(global_path);
+    g_free(global_path);
+    g_free(value);
+}
+
 int main() {
     UNITY_BEGIN();
 
+    // Keep the config the tests write out of the real home directory
+    char* home = tempdir_init();
+    setenv("HOME", home, 1);
+
     // Honestly I'm just doing a bunch of random stuff to up coverage and
     // ensure no memory errors
     GThread* t = g_thread_new("service-handler", handle_service, NULL);
@@ -118,5 +363,13 @@ int main() {
     RUN_TEST(shouldPass_whenServiceRestart);
     RUN_TEST(shouldPass_whenServiceStop);
 
+    RUN_TEST(shouldPass_whenReconcilingSeededRepositories);
+
+    RUN_TEST(shouldPass_whenDedupingSeededRepositories);
+
+    RUN_TEST(shouldPass_whenChangingPortWhileSeeding);
+
+    remove_tree(home);
+    g_free(home);
     return UNITY_END();
 }
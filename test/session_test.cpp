@@ -0,0 +1,195 @@
+#include <glib.h>
+#include <stdlib.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <libtorrent/add_torrent_params.hpp>
+#include <libtorrent/address.hpp>
+#include <libtorrent/ip_filter.hpp>
+#include <libtorrent/peer_info.hpp>
+#include <libtorrent/session.hpp>
+#include <libtorrent/session_params.hpp>
+#include <libtorrent/settings_pack.hpp>
+#include <libtorrent/socket.hpp>
+#include <libtorrent/torrent_flags.hpp>
+#include <libtorrent/torrent_handle.hpp>
+#include <libtorrent/torrent_info.hpp>
+#include <libtorrent/torrent_status.hpp>
+
+extern "C" {
+#include "config/config.h"
+#include "unity/unity.h"
+#include "utils/utils.h"
+}
+
+#include "utils/session.h"
+#include "utils/torrent.h"
+
+static void set_network(const char* key, const char* value) {
+    const config_id_t id = {.group = "network", .key = key};
+    TEST_ASSERT_EQUAL(0, config_set(CONFIG_SCOPE_GLOBAL, &id, value));
+}
+
+static void shouldPass_whenDisablingLocalDiscovery() {
+    // GIVEN: LSD turned off on a fixed port
+    set_network("port", "6881");
+    set_network("lsd", "false");
+    set_network("lan_only", "false");
+
+    // WHEN: Build the settings
+    lt::settings_pack settings;
+    settings.set_bool(lt::settings_pack::enable_dht, true);
+    gittor_network_settings(settings);
+
+    // THEN: LSD is off, the rest is left alone
+    TEST_ASSERT_FALSE(settings.get_bool(lt::settings_pack::enable_lsd));
+    TEST_ASSERT_TRUE(settings.get_bool(lt::settings_pack::enable_dht));
+    TEST_ASSERT_EQUAL_STRING(
+        "0.0.0.0:6881",
+        settings.get_str(lt::settings_pack::listen_interfaces).c_str());
+}
+
+static void shouldPass_whenLanOnly() {
+    // GIVEN: LAN only mode, even with LSD turned off
+    set_network("lsd", "false");
+    set_network("lan_only", "true");
+
+    // WHEN: Build the settings
+    lt::settings_pack settings;
+    settings.set_bool(lt::settings_pack::enable_dht, true);
+    settings.set_bool(lt::settings_pack::enable_upnp, true);
+    settings.set_bool(lt::settings_pack::enable_natpmp, true);
+    gittor_network_settings(settings);
+
+    // THEN: LSD is the only way left to find peers
+    TEST_ASSERT_TRUE(settings.get_bool(lt::settings_pack::enable_lsd));
+    TEST_ASSERT_FALSE(settings.get_bool(lt::settings_pack::enable_dht));
+    TEST_ASSERT_FALSE(settings.get_bool(lt::settings_pack::enable_upnp));
+    TEST_ASSERT_FALSE(settings.get_bool(lt::settings_pack::enable_natpmp));
+    TEST_ASSERT_TRUE(
+        settings.get_bool(lt::settings_pack::apply_ip_filter_to_trackers));
+}
+
+static void shouldPass_whenFilteringLanAddresses() {
+    // GIVEN: The LAN only filter
+    lt::ip_filter filter = gittor_lan_filter();
+
+    // THEN: Loopback, private and link-local addresses get through
+    const char* allowed[] = {"127.0.0.1",      "10.1.2.3",    "172.16.0.1",
+                             "172.31.255.255", "192.168.1.5", "169.254.0.1",
+                             "::1",            "fd00::1",     "fe80::1"};
+    for (const char* address : allowed) {
+        TEST_ASSERT_EQUAL_MESSAGE(0, filter.access(lt::make_address(address)),
+                                  address);
+    }
+
+    // THEN: Everything else is blocked
+    const char* blocked[] = {"8.8.8.8",  "172.32.0.1",  "192.169.0.1",
+                             "11.0.0.1", "2001:db8::1", "fec0::1"};
+    for (const char* address : blocked) {
+        TEST_ASSERT_EQUAL_MESSAGE(lt::ip_filter::blocked,
+                                  filter.access(lt::make_address(address)),
+                                  address);
+    }
+}
+
+// Start a session the way the leecher and the seeder do, with the network
+// config as it is now
+static std::unique_ptr<lt::session> start_session() {
+    lt::session_params params;
+    params.settings.set_int(lt::settings_pack::alert_mask,
+                            lt::alert_category::error |
+                                lt::alert_category::status);
+    // Stay connected once the download is done to look at where it came from
+    params.settings.set_bool(lt::settings_pack::close_redundant_connections,
+                             false);
+    gittor_network_settings(params.settings);
+    auto ses = std::make_unique<lt::session>(std::move(params));
+    gittor_network_session(*ses);
+    return ses;
+}
+
+static void shouldPass_whenLeechingFromLocalPeer() {
+    // GIVEN: A seeding and a leeching peer on localhost in LAN only mode,
+    // each listening on a port of its own
+    char* dir = tempdir_init();
+    const std::string seed_dir = std::string(dir) + "/seeder";
+    const std::string leech_dir = std::string(dir) + "/leecher";
+    write_sized(seed_dir + "/repo/HEAD", 23, 'h');
+    write_sized(seed_dir + "/repo/objects/pack/pack-1.pack", 40000, 'p');
+    const std::shared_ptr<const lt::torrent_info> ti =
+        make_torrent(seed_dir, "repo");
+    set_network("lan_only", "true");
+    set_network("port", "0");
+    const std::unique_ptr<lt::session> seeder = start_session();
+    const std::unique_ptr<lt::session> leecher = start_session();
+
+    lt::add_torrent_params seed;
+    seed.ti = ti;
+    seed.save_path = seed_dir;
+    seed.flags |= lt::torrent_flags::seed_mode;
+    seeder->add_torrent(std::move(seed));
+    lt::add_torrent_params leech;
+    leech.ti = ti;
+    leech.save_path = leech_dir;
+    const lt::torrent_handle h = leecher->add_torrent(std::move(leech));
+
+    // WHEN: Leech the repository
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    bool connected = false;
+    lt::torrent_status status = h.status();
+    while (!status.is_seeding && std::chrono::steady_clock::now() < deadline) {
+        if (!connected && seeder->listen_port() != 0) {
+            h.connect_peer(lt::tcp::endpoint(lt::make_address("127.0.0.1"),
+                                             seeder->listen_port()));
+            connected = true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        status = h.status();
+    }
+
+    // THEN: Every byte came from local peers, found by LSD or connected to
+    const lt::ip_filter lan = gittor_lan_filter();
+    std::vector<lt::peer_info> peers;
+    h.get_peer_info(peers);
+    std::int64_t from_local = 0;
+    for (const lt::peer_info& peer : peers) {
+        TEST_ASSERT_EQUAL(0, lan.access(peer.ip.address()));
+        from_local += peer.total_download;
+    }
+    gchar* contents = nullptr;
+    gsize len = 0;
+    const std::string pack = leech_dir + "/repo/objects/pack/pack-1.pack";
+    TEST_ASSERT_TRUE(status.is_seeding);
+    TEST_ASSERT_GREATER_THAN(0, from_local);
+    TEST_ASSERT_EQUAL(status.total_payload_download, from_local);
+    TEST_ASSERT_TRUE(
+        g_file_get_contents(pack.c_str(), &contents, &len, nullptr));
+    TEST_ASSERT_EQUAL(40000, len);
+    TEST_ASSERT_EQUAL('p', contents[len - 1]);
+
+    g_free(contents);
+    remove_tree(dir);
+    g_free(dir);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    // Keep the config the tests write out of the real home directory
+    char* home = tempdir_init();
+    setenv("HOME", home, 1);
+
+    RUN_TEST(shouldPass_whenDisablingLocalDiscovery);
+    RUN_TEST(shouldPass_whenLanOnly);
+    RUN_TEST(shouldPass_whenFilteringLanAddresses);
+    RUN_TEST(shouldPass_whenLeechingFromLocalPeer);
+
+    remove_tree(home);
+    g_free(home);
+    return UNITY_END();
+}
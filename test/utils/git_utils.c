@@ -0,0 +1,52 @@
+#include <git2.h>
+#include <string.h>
+#include "utils.h"
+
+extern int commit_file(git_repository* repo,
+                       const char* ref,
+                       const char* contents,
+                       const git_oid* parent_id,
+                       git_time_t time,
+                       git_oid* out,
+                       git_oid* blob) {
+    git_treebuilder* builder = NULL;
+    git_tree* tree = NULL;
+    git_commit* parent = NULL;
+    git_signature* sig = NULL;
+    git_oid blob_id;
+    git_oid tree_id;
+    int err = git_treebuilder_new(&builder, repo, NULL);
+    if (!err && contents) {
+        err = git_blob_create_from_buffer(&blob_id, repo, contents,
+                                          strlen(contents));
+        if (!err) {
+            err = git_treebuilder_insert(NULL, builder, "file.txt", &blob_id,
+                                         GIT_FILEMODE_BLOB);
+        }
+        if (!err && blob) {
+            git_oid_cpy(blob, &blob_id);
+        }
+    }
+    if (!err) {
+        err = git_treebuilder_write(&tree_id, builder);
+    }
+    if (!err) {
+        err = git_tree_lookup(&tree, repo, &tree_id);
+    }
+    if (!err && parent_id) {
+        err = git_commit_lookup(&parent, repo, parent_id);
+    }
+    if (!err) {
+        err = git_signature_new(&sig, "Alice", "alice@example.com", time, 0);
+    }
+    if (!err) {
+        const git_commit* parents[] = {parent};
+        err = git_commit_create(out, repo, ref, sig, sig, "UTF-8", "commit",
+                                tree, parent ? 1 : 0, parents);
+    }
+    git_signature_free(sig);
+    git_commit_free(parent);
+    git_tree_free(tree);
+    git_treebuilder_free(builder);
+    return err;
+}
@@ -0,0 +1,250 @@
+#include <gio/gio.h>
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+#include "config/config.h"
+#include "utils.h"
+
+struct http_server {
+    char* root;
+    GThread* thread;
+    GMainContext* context;
+    GMainLoop* loop;
+    GAsyncQueue* ready;
+    guint16 port;
+    gint requests;
+};
+
+// Parse a single "bytes=first-last" range, clamped to the file size
+static gboolean parse_range(const char* value,
+                            gsize size,
+                            gsize* first,
+                            gsize* last) {
+    unsigned long long a = 0;  // NOLINT(runtime/int)
+    unsigned long long b = 0;  // NOLINT(runtime/int)
+    if (size == 0) {
+        return FALSE;
+    }
+    if (sscanf(value, " bytes=%llu-%llu", &a, &b) == 2) {
+        *first = (gsize)a;
+        *last = MIN((gsize)b, size - 1);
+    } else if (sscanf(value, " bytes=%llu-", &a) == 1) {
+        *first = (gsize)a;
+        *last = size - 1;
+    } else {
+        return FALSE;
+    }
+    return *first <= *last;
+}
+
+static gboolean handle_connection(GThreadedSocketService* service,
+                                  GSocketConnection* connection,
+                                  GObject* source,
+                                  gpointer user_data) {
+    (void)service;
+    (void)source;
+    http_server_t* server = user_data;
+    GInputStream* in = g_io_stream_get_input_stream(G_IO_STREAM(connection));
+    GOutputStream* out =
+        g_io_stream_get_output_stream(G_IO_STREAM(connection));
+    GDataInputStream* data = g_data_input_stream_new(in);
+    g_data_input_stream_set_newline_type(data, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+
+    // One request per connection, read the request line and headers
+    char* request = g_data_input_stream_read_line(data, NULL, NULL, NULL);
+    char* range = NULL;
+    char* if_none_match = NULL;
+    char* if_range = NULL;
+    char* line = NULL;
+    while ((line = g_data_input_stream_read_line(data, NULL, NULL, NULL))) {
+        if (line[0] == '\0') {
+            g_free(line);
+            break;
+        }
+        if (g_ascii_strncasecmp(line, "Range:", 6) == 0) {
+            g_free(range);
+            range = g_strdup(line + 6);
+        } else if (g_ascii_strncasecmp(line, "If-None-Match:", 14) == 0) {
+            g_free(if_none_match);
+            if_none_match = g_strstrip(g_strdup(line + 14));
+        } else if (g_ascii_strncasecmp(line, "If-Range:", 9) == 0) {
+            g_free(if_range);
+            if_range = g_strstrip(g_strdup(line + 9));
+        }
+        g_free(line);
+    }
+
+    char method[16] = {0};
+    char target[1024] = {0};
+    gchar* body = NULL;
+    gsize size = 0;
+    if (request && sscanf(request, "%15s %1023s", method, target) == 2) {
+        g_atomic_int_inc(&server->requests);
+
+        // Serve the file under root named after the path and query string,
+        // or else after the path alone
+        for (int attempt = 0; attempt < 2 && !body; attempt++) {
+            char* query = strchr(target, '?');
+            if (attempt == 1 && query) {
+                *query = '\0';
+            } else if (attempt == 1) {
+                break;
+            }
+            gchar* unescaped = g_uri_unescape_string(target, NULL);
+            if (unescaped && !strstr(unescaped, "..")) {
+                gchar* path = g_build_filename(server->root, unescaped, NULL);
+                if (!g_file_test(path, G_FILE_TEST_IS_REGULAR) ||
+                    !g_file_get_contents(path, &body, &size, NULL)) {
+                    body = NULL;
+                }
+                g_free(path);
+            }
+            g_free(unescaped);
+        }
+    }
+
+    // Files are tagged with the hash of their contents
+    gchar* etag = NULL;
+    if (body) {
+        gchar* hash =
+            g_compute_checksum_for_data(G_CHECKSUM_SHA1, (guchar*)body, size);
+        etag = g_strdup_printf("\"%s\"", hash);
+        g_free(hash);
+    }
+
+    GString* response = g_string_new(NULL);
+    gsize first = 0;
+    gsize last = size ? size - 1 : 0;
+    if (!body) {
+        g_string_append(response,
+                        "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n");
+    } else if (if_none_match && strcmp(if_none_match, etag) == 0) {
+        g_string_append_printf(response,
+                               "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n",
+                               etag);
+        size = 0;
+    } else if (range && (!if_range || strcmp(if_range, etag) == 0) &&
+               parse_range(range, size, &first, &last)) {
+        g_string_append_printf(response,
+                               "HTTP/1.1 206 Partial Content\r\n"
+                               "Content-Range: bytes %zu-%zu/%zu\r\n"
+                               "Content-Length: %zu\r\n",
+                               first, last, size, last - first + 1);
+    } else {
+        g_string_append_printf(response,
+                               "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n"
+                               "ETag: %s\r\n",
+                               size, etag);
+    }
+    g_string_append(response, "Connection: close\r\n\r\n");
+
+    g_output_stream_write_all(out, response->str, response->len, NULL, NULL,
+                              NULL);
+    if (body && size > 0 && strcmp(method, "HEAD") != 0) {
+        g_output_stream_write_all(out, body + first, last - first + 1, NULL,
+                                  NULL, NULL);
+    }
+
+    g_string_free(response, TRUE);
+    g_free(body);
+    g_free(etag);
+    g_free(if_range);
+    g_free(if_none_match);
+    g_free(range);
+    g_free(request);
+    g_object_unref(data);
+    return TRUE;
+}
+
+static gpointer serve(gpointer user_data) {
+    http_server_t* server = user_data;
+    GMainContext* context = server->context;
+    g_main_context_push_thread_default(context);
+
+    // The service accepts connections on this thread's context
+    GSocketService* service = g_threaded_socket_service_new(4);
+    guint16 port = g_socket_listener_add_any_inet_port(
+        G_SOCKET_LISTENER(service), NULL, NULL);
+    g_signal_connect(service, "run", G_CALLBACK(handle_connection), server);
+    g_socket_service_start(service);
+
+    server->loop = g_main_loop_new(context, FALSE);
+    server->port = port;
+    g_async_queue_push(server->ready, GUINT_TO_POINTER(1));
+    if (port) {
+        g_main_loop_run(server->loop);
+    }
+
+    g_socket_service_stop(service);
+    g_socket_listener_close(G_SOCKET_LISTENER(service));
+    g_object_unref(service);
+    g_main_context_pop_thread_default(context);
+    return NULL;
+}
+
+static gboolean quit(gpointer user_data) {
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+extern http_server_t* http_server_start(const char* root) {
+    http_server_t* server = g_new0(http_server_t, 1);
+    server->root = g_strdup(root);
+    server->ready = g_async_queue_new();
+    server->context = g_main_context_new();
+    server->thread = g_thread_new("http-server", serve, server);
+    g_async_queue_pop(server->ready);
+
+    if (!server->port) {
+        http_server_stop(server);
+        return NULL;
+    }
+    return server;
+}
+
+extern http_server_t* api_server_start(const char* root) {
+    http_server_t* server = http_server_start(root);
+    if (!server) {
+        return NULL;
+    }
+
+    char* url = http_server_url(server);
+    gchar* api_url = g_strdup_printf("%s/api", url);
+    config_set(CONFIG_SCOPE_LOCAL,
+               &(config_id_t){.group = "network", .key = "api_url"}, api_url);
+    config_set(CONFIG_SCOPE_LOCAL,
+               &(config_id_t){.group = "auth", .key = "access_token"},
+               "token");
+    config_set(CONFIG_SCOPE_LOCAL,
+               &(config_id_t){.group = "auth", .key = "expires"},
+               "2999-01-01T00:00:00Z");
+    g_free(api_url);
+    g_free(url);
+    return server;
+}
+
+extern char* http_server_url(const http_server_t* server) {
+    return g_strdup_printf("http://127.0.0.1:%u", server->port);
+}
+
+extern int http_server_requests(http_server_t* server) {
+    return g_atomic_int_get(&server->requests);
+}
+
+extern void http_server_stop(http_server_t* server) {
+    if (!server) {
+        return;
+    }
+
+    // Quit from the server's own context, in case its loop hasn't run yet
+    GSource* source = g_idle_source_new();
+    g_source_set_callback(source, quit, server->loop, NULL);
+    g_source_attach(source, server->context);
+    g_source_unref(source);
+    g_thread_join(server->thread);
+    g_main_loop_unref(server->loop);
+    g_main_context_unref(server->context);
+    g_async_queue_unref(server->ready);
+    g_free(server->root);
+    g_free(server);
+}
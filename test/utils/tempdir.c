@@ -3,7 +3,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include "utils/utils.h"
+#include "utils.h"
 
 extern char* tempdir_init() {
     return g_dir_make_tmp("gittor-XXXXXX", NULL);
@@ -14,6 +14,36 @@ extern void tempdir_destroy(char* dir) {
     free(dir);
 }
 
+extern void remove_tree(const char* path) {
+    GDir* dir = g_dir_open(path, 0, NULL);
+    if (dir) {
+        const gchar* name = NULL;
+        while ((name = g_dir_read_name(dir))) {
+            gchar* child = g_build_filename(path, name, NULL);
+            remove_tree(child);
+            g_free(child);
+        }
+        g_dir_close(dir);
+        rmdir(path);
+    } else {
+        unlink(path);
+    }
+}
+
+extern void write_file(const char* dir, const char* path, const char* text) {
+    gchar* file = g_build_filename(dir, path, NULL);
+    gchar* parent = g_path_get_dirname(file);
+    g_mkdir_with_parents(parent, 0755);
+    g_file_set_contents(file, text, -1, NULL);
+    g_free(parent);
+    g_free(file);
+}
+
+extern int link_count(const char* path) {
+    struct stat st;
+    return path && !stat(path, &st) ? (int)st.st_nlink : 0;
+}
+
 extern bool tempdir_exists(char* dir) {
     struct stat st;
     if (stat(dir, &st) == 0 && S_ISDIR(st.st_mode)) {
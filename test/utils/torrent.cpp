@@ -0,0 +1,27 @@
+#include <glib.h>
+#include <fstream>
+#include <iterator>
+#include <vector>
+#include <libtorrent/bencode.hpp>
+#include <libtorrent/create_torrent.hpp>
+#include <libtorrent/file_storage.hpp>
+#include "utils/torrent.h"
+
+void write_sized(const std::string& path, std::size_t size, char fill) {
+    gchar* parent = g_path_get_dirname(path.c_str());
+    g_mkdir_with_parents(parent, 0755);
+    g_free(parent);
+    std::ofstream of(path, std::ios_base::binary);
+    of << std::string(size, fill);
+}
+
+std::shared_ptr<const lt::torrent_info> make_torrent(const std::string& dir,
+                                                     const std::string& name) {
+    lt::file_storage fs;
+    lt::add_files(fs, dir + "/" + name);
+    lt::create_torrent ct(fs, 16 * 1024);
+    lt::set_piece_hashes(ct, dir);
+    std::vector<char> buf;
+    lt::bencode(std::back_inserter(buf), ct.generate());
+    return std::make_shared<const lt::torrent_info>(buf, lt::from_span);
+}
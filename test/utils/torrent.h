@@ -0,0 +1,31 @@
+#ifndef TEST_UTILS_TORRENT_H_
+#define TEST_UTILS_TORRENT_H_
+
+// C++ only, torrents of files written by the tests
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <libtorrent/torrent_info.hpp>
+
+/**
+ * @brief Writes a file filled with one byte, creating its parents
+ *
+ * @param path The path of the file
+ * @param size The size of the file
+ * @param fill The byte to fill it with
+ */
+void write_sized(const std::string& path, std::size_t size, char fill);
+
+/**
+ * @brief Makes a torrent of a directory as the seeder does, hashed against
+ * the files on disk
+ *
+ * @param dir The directory holding the torrent's root
+ * @param name The name of the root, a file or directory under dir
+ * @return std::shared_ptr<const lt::torrent_info> The torrent
+ */
+std::shared_ptr<const lt::torrent_info> make_torrent(const std::string& dir,
+                                                     const std::string& name);
+
+#endif  // TEST_UTILS_TORRENT_H_
@@ -1,10 +1,13 @@
-#ifndef UTILS_UTILS_H_
-#define UTILS_UTILS_H_
+#ifndef TEST_UTILS_UTILS_H_
+#define TEST_UTILS_UTILS_H_
 
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 
+// Not found next to this header, so this is the one from src/
+#include "utils/utils.h"
+
 /**
  * @brief Initialize a new temporary directory for testing
  *
@@ -19,6 +22,30 @@ extern char* tempdir_init();
  */
 extern void tempdir_destroy(char* dir);
 
+/**
+ * @brief Deletes a file, or a directory and everything under it
+ *
+ * @param path The path to delete
+ */
+extern void remove_tree(const char* path);
+
+/**
+ * @brief Writes a text file below a directory, creating its parents
+ *
+ * @param dir The directory
+ * @param path The path of the file relative to the directory
+ * @param text The contents of the file
+ */
+extern void write_file(const char* dir, const char* path, const char* text);
+
+/**
+ * @brief Gets the number of links to a file
+ *
+ * @param path The path to the file, may be NULL
+ * @return int The number of links, 0 if the file is missing
+ */
+extern int link_count(const char* path);
+
 /**
  * @brief Checks if the temporary directory exists
  *
@@ -51,4 +78,71 @@ extern void restore_stdout(int old_stdout_fd);
  */
 extern void read_temp_file(FILE* temp, char* buffer, size_t size);
 
-#endif  // UTILS_UTILS_H_
+/**
+ * @brief Commits a tree holding a single file.txt, or an empty tree, on top
+ * of a parent
+ *
+ * @param repo The repository to commit to
+ * @param ref The reference to point at the commit, NULL for none
+ * @param contents The contents of file.txt, NULL for an empty tree
+ * @param parent_id The parent commit, NULL for a root commit
+ * @param time The time of the commit, in seconds since the epoch
+ * @param out The new commit
+ * @param blob The blob of file.txt, may be NULL
+ * @return int 0 on success, a libgit2 error code otherwise
+ */
+extern int commit_file(git_repository* repo,
+                       const char* ref,
+                       const char* contents,
+                       const git_oid* parent_id,
+                       git_time_t time,
+                       git_oid* out,
+                       git_oid* blob);
+
+/// @brief A local HTTP server standing in for the API and web seeds
+typedef struct http_server http_server_t;
+
+/**
+ * @brief Starts an HTTP server on a free localhost port serving the files
+ * under a directory, with support for single byte ranges and If-Range. A file
+ * named after the path and query string is preferred over one named after the
+ * path
+ *
+ * @param root The directory to serve
+ * @return http_server_t* The server, or NULL if it couldn't listen
+ */
+extern http_server_t* http_server_start(const char* root);
+
+/**
+ * @brief Starts an HTTP server standing in for the API under /api, and logs
+ * in to it with a token that never expires
+ *
+ * @param root The directory to serve, with the API responses under api/
+ * @return http_server_t* The server, or NULL if it couldn't listen
+ */
+extern http_server_t* api_server_start(const char* root);
+
+/**
+ * @brief Gets the base URL of the server
+ *
+ * @param server The server
+ * @return char* The URL without a trailing slash, free with g_free()
+ */
+extern char* http_server_url(const http_server_t* server);
+
+/**
+ * @brief Gets the number of requests the server has handled
+ *
+ * @param server The server
+ * @return int The number of requests
+ */
+extern int http_server_requests(http_server_t* server);
+
+/**
+ * @brief Stops the server and frees it
+ *
+ * @param server The server to stop
+ */
+extern void http_server_stop(http_server_t* server);
+
+#endif  // TEST_UTILS_UTILS_H_
@@ -1,6 +1,33 @@
 #include <errno.h>
+#include <git2.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
 #include "cmd/cmd.h"
+#include "init/init.h"
 #include "unity/unity.h"
+#include "utils/utils.h"
+#include "verify/verify.h"
+
+// Write a blob into a new repository and return the path to its loose object
+static gchar* write_loose_object(const char* dir, const char* contents) {
+    git_repository* repo = NULL;
+    git_oid id;
+    char hex[GIT_OID_HEXSZ + 1] = {0};
+    gchar* path = NULL;
+
+    git_libgit2_init();
+    if (!git_repository_init(&repo, dir, true) &&
+        !git_blob_create_from_buffer(&id, repo, contents, strlen(contents))) {
+        git_oid_tostr(hex, sizeof(hex), &id);
+        gchar* prefix = g_strndup(hex, 2);
+        path = g_build_filename(dir, "objects", prefix, hex + 2, NULL);
+        g_free(prefix);
+    }
+    git_repository_free(repo);
+    git_libgit2_shutdown();
+    return path;
+}
 
 static void shouldPass_whenCalledWithNoArgs() {
     // GIVEN: Just calling gittor verify
@@ -26,9 +53,122 @@ static void shouldPass_whenCalledWithBranches() {
     TEST_ASSERT_EQUAL(0, err);
 }
 
+static void shouldPass_whenLooseObjectIntact() {
+    // GIVEN: A loose object as written by git
+    gchar* dir = tempdir_init();
+    gchar* path = write_loose_object(dir, "intact");
+    TEST_ASSERT_NOT_NULL(path);
+
+    // WHEN: Verify it
+    verify_t* verify = verify_new();
+    verify_queue_loose(verify, path);
+    int err = verify_finish(verify, NULL);
+    g_free(path);
+    tempdir_destroy(dir);
+
+    // THEN: Should pass
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+static void shouldFail_whenLooseObjectCorrupt() {
+    // GIVEN: A loose object whose contents were overwritten
+    gchar* dir = tempdir_init();
+    gchar* path = write_loose_object(dir, "corrupt");
+    TEST_ASSERT_NOT_NULL(path);
+    TEST_ASSERT_TRUE(g_file_set_contents(path, "garbage", -1, NULL));
+
+    // WHEN: Verify it
+    verify_t* verify = verify_new();
+    verify_queue_loose(verify, path);
+    int err = verify_finish(verify, NULL);
+    g_free(path);
+    tempdir_destroy(dir);
+
+    // THEN: Should fail
+    TEST_ASSERT_NOT_EQUAL(0, err);
+}
+
+// Create a repository the way gittor init does and open it
+static git_repository* init_repo() {
+    char url[FILE_URL_MAX];
+    char repo_id[REPO_ID_MAX];
+    git_repository* repo = NULL;
+    if (create_bare_repo(url, repo_id) ||
+        git_repository_open_bare(&repo, url + strlen("file://"))) {
+        return NULL;
+    }
+    return repo;
+}
+
+static void shouldPass_whenOnlyInitCommit() {
+    // GIVEN: A new GitTor repository, whose root commit is not signed
+    git_repository* repo = init_repo();
+    TEST_ASSERT_NOT_NULL(repo);
+
+    // WHEN: Verify it
+    verify_t* verify = verify_new();
+    int err = verify_finish(verify, repo);
+    git_repository_free(repo);
+
+    // THEN: Should pass
+    TEST_ASSERT_EQUAL(0, err);
+}
+
+static void shouldFail_whenCommitUnsigned() {
+    // GIVEN: A new GitTor repository with an unsigned commit on top
+    git_repository* repo = init_repo();
+    TEST_ASSERT_NOT_NULL(repo);
+    git_reference* head = NULL;
+    git_commit* parent = NULL;
+    git_tree* tree = NULL;
+    git_signature* sig = NULL;
+    git_oid id;
+    int err = git_repository_head(&head, repo);
+    if (!err) {
+        err = git_commit_lookup(&parent, repo, git_reference_target(head));
+    }
+    if (!err) {
+        err = git_commit_tree(&tree, parent);
+    }
+    if (!err) {
+        err = git_signature_now(&sig, "Mallory", "mallory@example.com");
+    }
+    if (!err) {
+        const git_commit* parents[] = {parent};
+        err = git_commit_create(&id, repo, "HEAD", sig, sig, "UTF-8",
+                                "unsigned", tree, 1, parents);
+    }
+    git_signature_free(sig);
+    git_tree_free(tree);
+    git_commit_free(parent);
+    git_reference_free(head);
+    TEST_ASSERT_EQUAL(0, err);
+
+    // WHEN: Verify it
+    verify_t* verify = verify_new();
+    err = verify_finish(verify, repo);
+    git_repository_free(repo);
+
+    // THEN: Should fail
+    TEST_ASSERT_NOT_EQUAL(0, err);
+}
+
 int main() {
     UNITY_BEGIN();
+
+    // Keep the repositories the tests create out of the real home directory
+    char* home = tempdir_init();
+    setenv("HOME", home, 1);
+    unsetenv("XDG_CONFIG_HOME");
+
     RUN_TEST(shouldPass_whenCalledWithNoArgs);
     RUN_TEST(shouldPass_whenCalledWithBranches);
+    RUN_TEST(shouldPass_whenLooseObjectIntact);
+    RUN_TEST(shouldFail_whenLooseObjectCorrupt);
+    RUN_TEST(shouldPass_whenOnlyInitCommit);
+    RUN_TEST(shouldFail_whenCommitUnsigned);
+
+    remove_tree(home);
+    g_free(home);
     return UNITY_END();
 }